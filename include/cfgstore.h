@@ -0,0 +1,65 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define CFG_MAGIC         0x43464731  // "CFG1"
+#define CFG_SLOT          768         // Bytes per slot, header included.
+#define CFG_FILE          "/cfg.%u"
+
+#define CFG_STORE_EEPROM  0
+#define CFG_STORE_FS      1
+#define CFG_STORE_FRAM    2
+
+/*
+ * Two slots are written in turn, the data before the header, so a save cut
+ * short by a power failure leaves the other one intact.  In FRAM they take
+ * the top 2 * CFG_SLOT bytes, otherwise two LittleFS files mirrored in the
+ * EEPROM sector.
+ */
+struct cfgSlot {
+  uint32_t  magic;
+  uint32_t  seq;              // Higher is newer.
+  uint16_t  len;              // Config bytes following.
+  uint32_t  crc;              // Over seq, len and the config.
+} __attribute__((__packed__));
+
+struct cfgStats {
+  uint32_t  saves;
+  uint32_t  unchanged;        // Saves skipped as nothing had changed.
+  uint32_t  commitLast;       // Microseconds.
+  uint32_t  commitMax;
+  uint32_t  seq;
+  uint8_t   slot;
+  uint8_t   store;
+};
+
+extern struct cfgStats cfgStats;
+extern const char *cfgStores[];
+
+bool cfgLoad(bool fs);
+void saveConfig(void);
@@ -0,0 +1,51 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+// Spare space in the header block, clear of the header and the size probe.
+#define CHECKPOINT_OFFSET     96
+#define CHECKPOINT_HYSTERESIS 5     // Volts above the threshold to re-arm.
+
+/*
+ * Pulse counters written the moment the supply sags so that pulses counted
+ * after the last header save survive the power going away.
+ */
+struct checkpoint {
+  uint16_t  boots;            // nvHeader.boots of the run that wrote it.
+  uint32_t  ovflow;
+  uint16_t  pulses;
+  uint16_t  holdup;           // ms from sag detection to this write.
+  uint16_t  latency;          // us taken by the first write of the sag.
+  uint16_t  crc;
+} __attribute__((__packed__));
+
+extern uint16_t checkpointHoldup;
+extern uint16_t checkpointLatency;
+
+void checkpointSag(double v, uint32_t ovflow, uint16_t pulses);
+bool checkpointRestore(void);
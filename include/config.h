@@ -25,6 +25,7 @@
  * 
  */
 
+#define NAME      "S31"     // Default hostname and access point SSID.
 #define STR32     32
 #define STR64     64
 
@@ -46,8 +47,24 @@ struct schedule {
   uint8_t   m_off;
 } __attribute__((__packed__));
 
+#define TARIFF_BANDS      4
+#define TARIFF_POINTS     4
+
+#define TARIFF_ENABLED    0x80
+#define TARIFF_BAND_MASK  0x03
+
+// A band switch point: the band applies from h:m until the next point.
+struct tariff {
+  uint8_t   flags;
+  uint8_t   h;
+  uint8_t   m;
+} __attribute__((__packed__));
+
 #define CFG_RELAY_ON_BOOT   0x01
 #define CFG_SCHEDULE        0x02
+#define CFG_TARIFF          0x04
+#define CFG_LOG_DEADBAND    0x08
+#define CFG_FSLOG           0x10
 
 struct config {
   uint32_t            signature;
@@ -60,4 +77,26 @@ struct config {
   uint8_t             flags;
   uint8_t             onDelay;
   struct schedule     schedule[7];
+  struct tariff       tariff[7][TARIFF_POINTS];
+  float               logDeadbandW;
+  uint8_t             logDeadbandPct;
+  uint16_t            logHeartbeat;
+  uint8_t             brownoutV;      // Checkpoint below this voltage, 0 disables.
+  float               tripA;          // Trip limits, 0 disables.
+  uint16_t            tripW;
+  uint16_t            inrushMs;       // Grace after the relay closes.
+  uint8_t             trip;           // Latched trip reason without FRAM.
+  uint16_t            tripLatency;
+  uint8_t             demandMin;      // Demand window, 0 disables.
+  uint16_t            demandW;        // Demand budget.
+  uint8_t             demandPct;      // Restore this far below the budget.
+  char                udpKey[STR32];  // UDP control pass phrase, empty disables.
+  char                mqttHost[STR64];  // MQTT broker, empty disables.
+  uint16_t            mqttPort;
+  char                mqttUser[STR32];
+  char                mqttPass[STR32];
+  uint16_t            mqttPeriod;     // Seconds between state messages.
+  char                influxHost[STR64];  // Line protocol collector, empty disables.
+  uint16_t            influxPort;
+  uint8_t             influxBatch;    // Samples per datagram.
 } __attribute__((__packed__));
\ No newline at end of file
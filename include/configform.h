@@ -0,0 +1,157 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * The settings forms and the /api/v1/config document, as formDecode() and
+ * formJson tables.  Used by main.cpp and the host programs in tools/.
+ */
+
+#define CFG(m)    offsetof(struct config, m)
+#define SCHED(m)  (CFG(schedule) + offsetof(struct schedule, m))
+#define TARIFF(m) (CFG(tariff) + offsetof(struct tariff, m))
+
+static const struct formField configForm[] PROGMEM = {
+  { "name",     FORM_STR,   STR32,              CFG(hostname), 0, 0, 0, 0, 0 },
+  { "ssid",     FORM_STR,   STR64,              CFG(ssid), 0, 0, 0, 0, 0 },
+  { "psk",      FORM_STR,   STR64,              CFG(psk), 0, 0, 0, 0, 0 },
+  { "ntp",      FORM_STR,   STR64,              CFG(ntpserver), 0, 0, 0, 0, 0 },
+  { "tz",       FORM_STR,   STR32,              CFG(timezone), 0, 0, 0, 0, 0 },
+  { "relay",    FORM_FLAG,  CFG_RELAY_ON_BOOT,  CFG(flags), 0, 0, 0, 0, 0 },
+  { "sched",    FORM_FLAG,  CFG_SCHEDULE,       CFG(flags), 0, 0, 0, 0, 0 },
+  { "tariff",   FORM_FLAG,  CFG_TARIFF,         CFG(flags), 0, 0, 0, 0, 0 },
+  { "fslog",    FORM_FLAG,  CFG_FSLOG,          CFG(flags), 0, 0, 0, 0, 0 },
+  { "dlog",     FORM_FLAG,  CFG_LOG_DEADBAND,   CFG(flags), 0, 0, 0, 0, 0 },
+  { "dbw",      FORM_FLOAT, 4,  CFG(logDeadbandW),    0, 9999.9, 0, 0, 0 },
+  { "dbp",      FORM_INT,   1,  CFG(logDeadbandPct),  0, 100, 0, 0, 0 },
+  { "dbh",      FORM_INT,   2,  CFG(logHeartbeat),    NV_LOG_PERIOD, 65535, 0, 0, 0 },
+  { "bov",      FORM_INT,   1,  CFG(brownoutV),       0, 255, 0, 0, 0 },
+  { "tripa",    FORM_FLOAT, 4,  CFG(tripA),           0, 99.9, 0, 0, 0 },
+  { "tripw",    FORM_INT,   2,  CFG(tripW),           0, 4000, 0, 0, 0 },
+  { "inrush",   FORM_INT,   2,  CFG(inrushMs),        0, 10000, 0, 0, 0 },
+  { "dmin",     FORM_INT,   1,  CFG(demandMin),       0, 255, 0, 0, 0 },
+  { "dw",       FORM_INT,   2,  CFG(demandW),         0, 4000, 0, 0, 0 },
+  { "dpct",     FORM_INT,   1,  CFG(demandPct),       0, 100, 0, 0, 0 },
+  { "udpkey",   FORM_STR,   STR32,              CFG(udpKey), 0, 0, 0, 0, 0 },
+  { "mqhost",   FORM_STR,   STR64,              CFG(mqttHost), 0, 0, 0, 0, 0 },
+  { "mqport",   FORM_INT,   2,  CFG(mqttPort),        1, 65535, 0, 0, 0 },
+  { "mquser",   FORM_STR,   STR32,              CFG(mqttUser), 0, 0, 0, 0, 0 },
+  { "mqpass",   FORM_STR,   STR32,              CFG(mqttPass), 0, 0, 0, 0, 0 },
+  { "mqper",    FORM_INT,   2,  CFG(mqttPeriod),      1, 65535, 0, 0, 0 },
+  { "ifhost",   FORM_STR,   STR64,              CFG(influxHost), 0, 0, 0, 0, 0 },
+  { "ifport",   FORM_INT,   2,  CFG(influxPort),      1, 65535, 0, 0, 0 },
+  { "ifbatch",  FORM_INT,   1,  CFG(influxBatch),     1, 10, 0, 0, 0 },
+  { "vf",       FORM_FLOAT, 4,  CFG(calibration.V),   0, 1.999, 0, 0, 0 },
+  { "if",       FORM_FLOAT, 4,  CFG(calibration.I),   0, 1.999, 0, 0, 0 },
+  { "pf",       FORM_FLOAT, 4,  CFG(calibration.P),   0, 1.999, 0, 0, 0 },
+};
+
+static const struct formField scheduleForm[] PROGMEM = {
+  { "on",   FORM_HM,    0,                  SCHED(h_on),  0, 0, 7, 0, sizeof(struct schedule) },
+  { "off",  FORM_HM,    0,                  SCHED(h_off), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "eon",  FORM_FLAG,  SCHED_ON_ENABLED,   SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "eof",  FORM_FLAG,  SCHED_OFF_ENABLED,  SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "r",    FORM_FLAG,  SCHED_RANDOM,       SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+};
+
+static const struct formField tariffForm[] PROGMEM = {
+  { "t",    FORM_HM,    0,                TARIFF(h),      0, 0, 7, TARIFF_POINTS, sizeof(struct tariff) },
+  { "tb",   FORM_BITS,  TARIFF_BAND_MASK, TARIFF(flags),  0, TARIFF_BANDS - 1, 7, TARIFF_POINTS, sizeof(struct tariff) },
+  { "te",   FORM_FLAG,  TARIFF_ENABLED,   TARIFF(flags),  0, 0, 7, TARIFF_POINTS, sizeof(struct tariff) },
+};
+
+/*
+ * The document is named after struct config's members, with each flag bit
+ * under "flags".  The network and broker secrets are accepted by PUT but
+ * never returned by GET.
+ */
+static const struct formField configJsonFields[] PROGMEM = {
+  { "hostname",       FORM_STR,     STR32,  CFG(hostname), 0, 0, 0, 0, 0 },
+  { "ssid",           FORM_STR,     STR64,  CFG(ssid), 0, 0, 0, 0, 0 },
+  { "psk",            FORM_SECRET,  STR64,  CFG(psk), 0, 0, 0, 0, 0 },
+  { "ntpserver",      FORM_STR,     STR64,  CFG(ntpserver), 0, 0, 0, 0, 0 },
+  { "timezone",       FORM_STR,     STR32,  CFG(timezone), 0, 0, 0, 0, 0 },
+  { "logDeadbandW",   FORM_FLOAT,   4,  CFG(logDeadbandW),    0, 9999.9, 0, 0, 0 },
+  { "logDeadbandPct", FORM_INT,     1,  CFG(logDeadbandPct),  0, 100, 0, 0, 0 },
+  { "logHeartbeat",   FORM_INT,     2,  CFG(logHeartbeat),    NV_LOG_PERIOD, 65535, 0, 0, 0 },
+  { "brownoutV",      FORM_INT,     1,  CFG(brownoutV),       0, 255, 0, 0, 0 },
+  { "tripA",          FORM_FLOAT,   4,  CFG(tripA),           0, 99.9, 0, 0, 0 },
+  { "tripW",          FORM_INT,     2,  CFG(tripW),           0, 4000, 0, 0, 0 },
+  { "inrushMs",       FORM_INT,     2,  CFG(inrushMs),        0, 10000, 0, 0, 0 },
+  { "demandMin",      FORM_INT,     1,  CFG(demandMin),       0, 255, 0, 0, 0 },
+  { "demandW",        FORM_INT,     2,  CFG(demandW),         0, 4000, 0, 0, 0 },
+  { "demandPct",      FORM_INT,     1,  CFG(demandPct),       0, 100, 0, 0, 0 },
+  { "udpKey",         FORM_SECRET,  STR32,  CFG(udpKey), 0, 0, 0, 0, 0 },
+  { "mqttHost",       FORM_STR,     STR64,  CFG(mqttHost), 0, 0, 0, 0, 0 },
+  { "mqttPort",       FORM_INT,     2,  CFG(mqttPort),        1, 65535, 0, 0, 0 },
+  { "mqttUser",       FORM_STR,     STR32,  CFG(mqttUser), 0, 0, 0, 0, 0 },
+  { "mqttPass",       FORM_SECRET,  STR32,  CFG(mqttPass), 0, 0, 0, 0, 0 },
+  { "mqttPeriod",     FORM_INT,     2,  CFG(mqttPeriod),      1, 65535, 0, 0, 0 },
+  { "influxHost",     FORM_STR,     STR64,  CFG(influxHost), 0, 0, 0, 0, 0 },
+  { "influxPort",     FORM_INT,     2,  CFG(influxPort),      1, 65535, 0, 0, 0 },
+  { "influxBatch",    FORM_INT,     1,  CFG(influxBatch),     1, 10, 0, 0, 0 },
+};
+
+static const struct formField flagsJson[] PROGMEM = {
+  { "relayOnBoot",  FORM_FLAG,  CFG_RELAY_ON_BOOT,  CFG(flags), 0, 0, 0, 0, 0 },
+  { "schedule",     FORM_FLAG,  CFG_SCHEDULE,       CFG(flags), 0, 0, 0, 0, 0 },
+  { "tariff",       FORM_FLAG,  CFG_TARIFF,         CFG(flags), 0, 0, 0, 0, 0 },
+  { "logDeadband",  FORM_FLAG,  CFG_LOG_DEADBAND,   CFG(flags), 0, 0, 0, 0, 0 },
+  { "fslog",        FORM_FLAG,  CFG_FSLOG,          CFG(flags), 0, 0, 0, 0, 0 },
+};
+
+static const struct formField calibrationJson[] PROGMEM = {
+  { "V",  FORM_FLOAT, 4,  CFG(calibration.V), 0, 1.999, 0, 0, 0 },
+  { "I",  FORM_FLOAT, 4,  CFG(calibration.I), 0, 1.999, 0, 0, 0 },
+  { "P",  FORM_FLOAT, 4,  CFG(calibration.P), 0, 1.999, 0, 0, 0 },
+};
+
+static const struct formField scheduleJson[] PROGMEM = {
+  { "on",         FORM_HM,    0,                  SCHED(h_on),  0, 0, 7, 0, sizeof(struct schedule) },
+  { "off",        FORM_HM,    0,                  SCHED(h_off), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "onEnabled",  FORM_FLAG,  SCHED_ON_ENABLED,   SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "offEnabled", FORM_FLAG,  SCHED_OFF_ENABLED,  SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+  { "random",     FORM_FLAG,  SCHED_RANDOM,       SCHED(flags), 0, 0, 7, 0, sizeof(struct schedule) },
+};
+
+static const struct formField tariffJson[] PROGMEM = {
+  { "time",     FORM_HM,    0,                TARIFF(h),      0, 0, 7, TARIFF_POINTS, sizeof(struct tariff) },
+  { "band",     FORM_BITS,  TARIFF_BAND_MASK, TARIFF(flags),  0, TARIFF_BANDS - 1, 7, TARIFF_POINTS, sizeof(struct tariff) },
+  { "enabled",  FORM_FLAG,  TARIFF_ENABLED,   TARIFF(flags),  0, 0, 7, TARIFF_POINTS, sizeof(struct tariff) },
+};
+
+static const struct formSection configJson[] PROGMEM = {
+  { "",             configJsonFields, sizeof(configJsonFields) / sizeof(configJsonFields[0]) },
+  { "flags",        flagsJson,        sizeof(flagsJson) / sizeof(flagsJson[0]) },
+  { "calibration",  calibrationJson,  sizeof(calibrationJson) / sizeof(calibrationJson[0]) },
+  { "schedule",     scheduleJson,     sizeof(scheduleJson) / sizeof(scheduleJson[0]) },
+  { "tariff",       tariffJson,       sizeof(tariffJson) / sizeof(tariffJson[0]) },
+};
+#define CONFIG_JSON (sizeof(configJson) / sizeof(configJson[0]))
@@ -27,10 +27,14 @@
 
 #pragma once
 
+#define CSE_BYTE_US   2084      // 10 bits at 4800 baud.
+
 extern struct config cfg;
 extern double power;
 extern double voltage;
 extern double current;
 extern double energy;
+extern double kWhPerPulse;
 
 void readCse7759b(void);
+uint32_t cseNext(void);
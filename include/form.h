@@ -0,0 +1,121 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define FORM_STR    0       // char[size], truncated and terminated.
+#define FORM_FLOAT  1
+#define FORM_INT    2       // Unsigned integer of size 1, 2 or 4 bytes.
+#define FORM_FLAG   3       // Checkbox: set bits 'size' when present, clear them when absent.
+#define FORM_BITS   4       // Integer stored in bits 'size', others kept.
+#define FORM_HM     5       // "HH:MM" into an hour byte followed by a minute byte.
+#define FORM_SECRET 6       // FORM_STR that formJsonWrite() leaves out.
+
+/*
+ * A form field decoded straight into a struct at 'offset'.  Indexed fields
+ * are named with the index digits appended, one digit for 'count' entries
+ * or two for 'count' x 'inner', each 'stride' bytes apart.  Tables live in
+ * flash.
+ */
+struct formField {
+  char      name[16];
+  uint8_t   type;
+  uint8_t   size;           // Bytes for FORM_STR and FORM_INT, bit mask for FORM_FLAG and FORM_BITS.
+  uint16_t  offset;
+  float     min;
+  float     max;
+  uint8_t   count;
+  uint8_t   inner;
+  uint8_t   stride;
+};
+
+/*
+ * Tables as JSON: a document is an object of the fields in the
+ * first section, with each later section an object under its name.
+ * Indexed fields are arrays, nested for 'inner'.
+ */
+struct formSection {
+  char                      name[12];
+  const struct formField   *fields;
+  uint8_t                   n;
+};
+
+#define FORM_KEY        18      // Longest argument name, a field name and two digits.
+#define FORM_JSON_TOKEN 72      // Longest string kept, more is dropped.
+
+// An urlencoded body decoded as it arrives, so no argument is made a String.
+struct formBody {
+  const struct formField   *fields;
+  uint8_t                   n;
+  uint8_t                  *base;
+  char                      key[FORM_KEY];
+  char                      value[FORM_JSON_TOKEN];
+  uint8_t                   len;
+  bool                      inValue;
+  bool                      skip;             // Key too long for any field.
+  uint8_t                   hex;              // %XX digits left.
+  uint8_t                   code;
+  uint8_t                   bad;              // Values rejected.
+};
+#define FORM_JSON_DEPTH 4
+
+// Parser state, fed the body as it arrives so no document is built.
+struct formJson {
+  const struct formSection *sections;
+  uint8_t                   nsections;
+  uint8_t                  *base;
+  struct formField          field;
+  bool                      hasField;
+  uint8_t                   fieldDepth;
+  uint8_t                   pending;          // Section named by the last key.
+  uint8_t                   depth;
+  struct {
+    bool      array;
+    bool      empty;
+    uint8_t   section;                        // 0xff for objects not in the tables.
+    uint8_t   index;
+  }                         frame[FORM_JSON_DEPTH + 1];
+  uint8_t                   want;
+  uint8_t                   lex;
+  uint8_t                   hex;              // \u digits left.
+  uint16_t                  code;
+  char                      tok[FORM_JSON_TOKEN];
+  uint8_t                   len;
+  bool                      string;
+  bool                      done;
+  bool                      error;
+  uint8_t                   bad;              // Values rejected.
+};
+
+uint8_t formDecode(const struct formField *fields, uint8_t n, void *base);
+void formBodyBegin(struct formBody *b, const struct formField *fields, uint8_t n, void *base);
+void formBodyFeed(struct formBody *b, const char *s, size_t len);
+uint8_t formBodyEnd(struct formBody *b);
+void formJsonBegin(struct formJson *j, const struct formSection *sections, uint8_t n, void *base);
+bool formJsonFeed(struct formJson *j, const char *s, size_t len);
+bool formJsonEnd(struct formJson *j);
+void formJsonWrite(Print &out, const struct formSection *sections, uint8_t n, const void *base);
@@ -0,0 +1,73 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastCRC.h>
+
+#define GZIP_WINDOW     1024    // History matched against, bytes.
+#define GZIP_HASH_BITS  9
+#define GZIP_OUT        1460    // Compressed output goes out in segments.
+
+/*
+ * A streaming gzip encoder: deflate with fixed Huffman codes and greedy
+ * LZ77 over a small window, enough for the repetitive text the pages and
+ * history are made of.  Output is written to the wrapped Print.
+ */
+class Gzip : public Print {
+public:
+  Gzip(Print &to);
+
+  void begin(void);
+  void end(void);
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override;
+  using Print::write;
+
+  uint32_t  in = 0, out = 0;    // Bytes before and after.
+
+private:
+  void deflate(bool last);
+  void bits(uint32_t v, uint8_t n);
+  void code(uint16_t c, uint8_t n);
+  void symbol(uint16_t s);
+  void match(uint16_t len, uint16_t dist);
+  void put(uint8_t b);
+  void flush(void);
+
+  Print    &dest;
+  FastCRC32 CRC32;
+  uint32_t  crc, bitBuf;
+  uint8_t   bitCount;
+  uint16_t  pos, fill, obytes;
+  uint16_t  head[1 << GZIP_HASH_BITS];  // Last position + 1 per hash, 0 for none.
+  uint8_t   win[2 * GZIP_WINDOW];       // History then lookahead.
+  uint8_t   obuf[GZIP_OUT];
+};
+
+bool gzipAccepted(const char *h);
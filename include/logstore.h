@@ -0,0 +1,148 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#include <LittleFS.h>
+#include <time.h>
+
+extern struct nvHeader nvHeader;
+
+/*
+ * History storage.  Records are appended in time order and read back by
+ * index, 0 being the oldest.  add() wraps append() to keep latency figures
+ * for each backend.
+ */
+class LogStore {
+public:
+  virtual ~LogStore() {}
+  virtual const char *name(void) = 0;
+  virtual uint16_t    period(void) = 0;
+  virtual bool        deadband(void) { return true; }
+  virtual uint32_t    count(void) = 0;
+  virtual uint32_t    capacity(void) = 0;
+  virtual bool        read(uint32_t i, struct nvLog *log) = 0;
+  virtual bool        gap(uint32_t) { return false; }
+  virtual uint32_t    since(time_t since);
+  virtual void        etag(char *buf, size_t len);
+  virtual void        flush(void) {}
+
+  bool      add(const struct nvLog *log);
+  uint32_t  scan(void);
+
+  uint32_t  appends = 0;
+  uint32_t  appendMax = 0;
+  uint64_t  appendTotal = 0;    // Microseconds.
+
+protected:
+  virtual bool        append(const struct nvLog *log) = 0;
+};
+
+class FramLog : public LogStore {
+public:
+  const char *name(void) { return "FRAM"; }
+  uint16_t    period(void) { return NV_LOG_PERIOD; }
+  uint32_t    count(void);
+  uint32_t    capacity(void) { return nvHeader.nvLogMax - 1; }
+  bool        read(uint32_t i, struct nvLog *log);
+  void        etag(char *buf, size_t len);
+
+protected:
+  bool        append(const struct nvLog *log);
+};
+
+#define RAMLOG_BYTES    6144    // Heap budget.
+#define RAMLOG_BLOCK    64      // Bytes of samples per block.
+#define RAMLOG_BLOCKS   (RAMLOG_BYTES / (RAMLOG_BLOCK + 1))
+#define RAMLOG_PERIOD   60      // Seconds per sample.
+
+class RamLog : public LogStore {
+public:
+  bool        begin(void);
+  const char *name(void) { return "RAM"; }
+  uint16_t    period(void) { return RAMLOG_PERIOD; }
+  bool        deadband(void) { return false; }
+  uint32_t    count(void) { return used; }
+  uint32_t    capacity(void);
+  bool        read(uint32_t i, struct nvLog *log);
+  bool        gap(uint32_t i);
+  uint32_t    since(time_t since);
+
+protected:
+  bool        append(const struct nvLog *log);
+
+private:
+  void        push(uint16_t v, bool gap);
+  bool        decode(uint32_t i, uint16_t *v);
+
+  uint8_t    *ring = NULL;      // The blocks, then a sample count for each.
+  uint8_t    *counts;
+  uint8_t     oldest = 0;       // Block holding sample 0.
+  uint8_t     blocks = 0;
+  uint8_t     fill = 0;         // Bytes used in the newest block.
+  uint16_t    prev = 0;         // Newest value in the newest block.
+  uint16_t    used = 0;
+  time_t      last;             // Time of the newest sample.
+  struct {
+    bool      valid;
+    uint8_t   block;
+    uint8_t   at;               // Offset of the next sample in the block.
+    uint16_t  prev;
+    uint16_t  first;            // Index of the block's first sample.
+    uint16_t  next;             // Index of the sample at 'at'.
+  }           cursor = {};
+};
+
+#define FSLOG_PAGE      32      // Records per flash write, 256 bytes.
+#define FSLOG_FILE      2048    // Records per file, two files are kept.
+#define FSLOG_CURRENT   "/log.0"
+#define FSLOG_PREVIOUS  "/log.1"
+
+class FsLog : public LogStore {
+public:
+  bool        begin(void);
+  const char *name(void) { return "LittleFS"; }
+  uint16_t    period(void) { return NV_LOG_PERIOD; }
+  uint32_t    count(void) { return previous + current + pending; }
+  uint32_t    capacity(void) { return 2 * FSLOG_FILE; }
+  bool        read(uint32_t i, struct nvLog *log);
+  void        flush(void);
+
+protected:
+  bool        append(const struct nvLog *log);
+
+private:
+  struct nvLog  page[FSLOG_PAGE];
+  File          reader;
+  const char   *readerPath = NULL;
+  uint32_t      previous = 0, current = 0;
+  uint16_t      pending = 0;
+};
+
+extern LogStore *logStore;
+
+void framLogResize(uint32_t max);
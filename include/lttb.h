@@ -0,0 +1,65 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#include <time.h>
+
+#define LTTB_BUCKET_MAX   64      // Points buffered per bucket.
+
+typedef void (*lttbEmit)(void *ctx, time_t t, float p);
+
+struct lttbPoint {
+  time_t  t;
+  float   p;
+};
+
+/*
+ * Largest-Triangle-Three-Buckets downsampling in a single pass.  Input
+ * records are split into equal sized buckets by index, only the current and
+ * next bucket are held in memory.
+ */
+class Lttb {
+public:
+  Lttb(lttbEmit emit, void *ctx);
+  ~Lttb();
+  uint16_t  begin(uint32_t records, uint16_t points);
+  void      add(int32_t record, time_t t, float p);
+  void      end(void);
+
+private:
+  int       bucketOf(int32_t record);
+  void      select(void);
+
+  lttbEmit          emit;
+  void             *ctx;
+  struct lttbPoint *buf, *cur, *next, anchor;
+  uint32_t          records;
+  uint16_t          points, nCur, nNext;
+  int               bCur, bNext;
+  bool              started;
+};
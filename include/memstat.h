@@ -0,0 +1,69 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define MEM_PERIOD    300     // Seconds per history entry.
+#define MEM_HISTORY   16      // Low water marks kept.
+#define MEM_URIS      12      // Endpoints counted, the last collects the rest.
+#define MEM_URI       24
+#define MEM_RTC_BLOCK 32      // RTC user memory offset in words, OTA uses the first 128 bytes.
+#define MEM_MAGIC     0x4d454d31
+
+struct memSample {
+  uint32_t  uptime;           // Seconds.
+  uint16_t  heap;
+  uint16_t  block;            // Largest free block.
+  uint16_t  stack;            // Free loop stack, low water.
+  uint8_t   frag;             // Percent.
+} __attribute__((__packed__));
+
+struct memUri {
+  char      uri[MEM_URI];
+  uint32_t  requests;
+  uint32_t  allocs;
+  uint16_t  allocsMax;        // Most in one request.
+  uint16_t  heapLow;          // Least free heap seen after one.
+};
+
+// Written to RTC memory every sample so it survives a crash.
+struct memRtc {
+  uint32_t          magic;
+  struct memSample  last;
+  struct memSample  low;
+  uint32_t          allocs;
+  char              uri[MEM_URI]; // Last request handled.
+  uint16_t          crc;
+};
+
+extern struct memSample memLow;
+extern volatile uint32_t memAllocs;
+
+void memBegin(void);
+void memRequest(const char *uri, uint32_t allocs);
+void memSample(void);
+void handleMemStats(void);
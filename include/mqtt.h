@@ -0,0 +1,55 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define MQTT_PORT       1883
+#define MQTT_PERIOD     10      // Default seconds between state messages.
+#define MQTT_RETRY      5000    // ms between connection attempts.
+#define MQTT_BATCH      32      // History rows per message.
+#define MQTT_BUFFER     1024
+#define MQTT_DNS        250     // ms, a lookup and a connect never share a pass.
+#define MQTT_CONNECT    250     // ms, the UART buffer holds about 500 ms of frames.
+#define MQTT_SOCKET     2000    // ms, once connected.
+
+struct mqttStats {
+  uint32_t  connects;
+  uint32_t  connectMax;         // Longest time the loop was held by a lookup or connect, ms.
+  uint32_t  messages;
+  uint32_t  bytes;
+  uint32_t  rows;               // History rows replayed.
+  uint64_t  publishTotal;       // Microseconds.
+  uint32_t  publishMax;
+  uint32_t  heap;               // Heap taken by the client and its buffer.
+};
+
+extern struct mqttStats mqttStats;
+
+void mqttBegin(void);
+void mqttHandle(void);
+bool mqttConnected(void);
+uint32_t mqttBacklog(void);
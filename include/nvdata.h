@@ -27,7 +27,10 @@
 
 #define NV_HEADER_OFFSET  0
 #define NV_LOG_OFFSET     128
-#define NV_LOG_MAX        ((32768-128)/sizeof(struct nvLog))
+#define NV_LOG_PERIOD     10      // Seconds between log samples.
+#define NV_LOG_HEARTBEAT  3600    // Default deadband heartbeat in seconds.
+#define NV_SIZE_MIN       8192    // Smallest FRAM probed for.
+#define NV_SIZE_MAX       524288  // Largest FRAM addressable by FRAM32.
 
 struct nvLog {
   time_t    time;
@@ -36,14 +39,22 @@ struct nvLog {
 
 #define NV_FLAG_OFLOW_POLARITY  0x01
 
-// Keep the header under 
+// Keep the header under CHECKPOINT_OFFSET bytes, the CRC must be the last member.
 struct nvHeader {
   uint8_t   version;
   uint8_t   state;
-  uint16_t  nvLogFirst;
-  uint16_t  nvLogLast;
+  uint16_t  generation;       // Incremented each time nvLogLast wraps.
+  uint32_t  nvLogFirst;
+  uint32_t  nvLogLast;
+  uint32_t  nvLogMax;         // Ring size the log was laid out for.
+  uint32_t  size;             // FRAM size in bytes.
   uint32_t  ovflow;
   uint16_t  pulses;
   uint16_t  restoredPulses;
+  uint64_t  tariffPulses[TARIFF_BANDS];
+  uint16_t  boots;            // Incremented at every boot.
+  uint8_t   trip;             // Latched trip reason.
+  uint16_t  tripLatency;
+  uint32_t  mqttSent;         // Newest history row published over MQTT.
   uint16_t  crc;
 } __attribute__((__packed__));
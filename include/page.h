@@ -0,0 +1,92 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#include <WiFiClient.h>
+
+#include "gzip.h"
+#include "timefmt.h"
+
+#define PAGE_MSS    1460    // Flush whole segments.
+
+// Typed slots, rendered without parsing a format string.
+struct pageFixed {
+  double    v;
+  uint8_t   decimals;
+};
+
+struct pageTwo {
+  uint8_t   v;              // Zero padded to two digits.
+};
+
+static inline struct pageFixed fixed(double v, uint8_t decimals) { return { v, decimals }; }
+static inline struct pageTwo two(uint8_t v) { return { v }; }
+const __FlashStringHelper *checked(bool on);
+
+/*
+ * A page assembled from RAM strings, flash strings (F()), integers and the
+ * slots above into a segment sized buffer.  begin() sends the status line
+ * and the chrome shared by every page, end() the tail.  The body is gzipped
+ * for clients that accept it.
+ */
+class Page {
+public:
+  Page(WiFiClient &client) : client(client), sink(&client), p(buf) {}
+  ~Page()                     { delete gz; }
+
+  void begin(uint8_t refresh = 0, const __FlashStringHelper *head = NULL);
+  void end(void);
+
+  template<typename... T> Page &
+  operator()(const T &... parts)
+  {
+    int unused[] = { 0, (put(parts), 0)... };
+
+    (void)unused;
+    return *this;
+  }
+
+  void put(const char *s);
+  void put(const __FlashStringHelper *s);
+  void put(int v)             { room(12); p = fmtFixed(p, v, 0); }
+  void put(unsigned v)        { room(12); p = fmtFixed(p, v, 0); }
+  void put(long v)            { room(12); p = fmtFixed(p, v, 0); }
+  void put(unsigned long v)   { room(12); p = fmtFixed(p, v, 0); }
+  void put(struct pageFixed f);
+  void put(struct pageTwo t);
+
+private:
+  void room(size_t n)         { if ((size_t)(buf + sizeof(buf) - p) < n) flush(); }
+  void flush(void);
+
+  WiFiClient  &client;
+  Print       *sink;
+  Gzip        *gz = NULL;
+  char        *p;
+  char         buf[PAGE_MSS];
+};
@@ -0,0 +1,82 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+/*
+ * What the root page adds to its head and the script that polls the status
+ * and history into it.  Used by main.cpp and tools/pagebench.cpp.
+ */
+
+static const char rootHead[] PROGMEM =
+  "<meta charset='UTF-8'>"
+  "<style>.dygraph-legend {text-align: right;background: none;}</style>"
+  "<script src='dygraph.min.js'></script><link rel='stylesheet' type='text/css' href='dygraph.css'>";
+
+static const char rootScript[] PROGMEM = R"(<script type="text/javascript">
+      var g, rows = [], last = 0, width = 600;
+      function poll() {
+        var fresh = !last;
+        fetch(fresh ? 'data.txt?points=' + width : 'data.txt?since=' + last).then(function (r) {
+          if (r.status != 200)
+            return;
+          last = r.headers.get('X-Last') || last;
+          return r.text().then(function (t) {
+            if (fresh)
+              rows = [];
+            t.split('\n').slice(1).forEach(function (l) {
+              var f = l.split(',');
+              if (f.length == 2)
+                rows.push([new Date(f[0].replace(' ', 'T')), parseFloat(f[1])]);
+            });
+            // A page left open starts again from a fresh downsample rather than growing.
+            if (rows.length > 2 * width)
+              last = 0;
+            if (g)
+              g.updateOptions({ file: rows });
+            else if (rows.length)
+              g = new Dygraph(document.getElementById('history'), rows, {
+                labels: ['Date', 'Power'],
+                title: 'Power history',
+                width: width,
+                height: 300,
+                legend: 'always',
+                showRangeSelector: true,
+              });
+          });
+        });
+        fetch('api/v1/status').then(function (r) { return r.json(); }).then(function (s) {
+          var va = s.voltage * s.current, vars = Math.sqrt(Math.max(va * va - s.power * s.power, 0));
+          document.getElementById('now').innerHTML = s.voltage.toFixed(2) + 'V ' + s.current.toFixed(3) + 'A<br>' +
+            s.power.toFixed(2) + 'W<br>' + va.toFixed(2) + 'VA<br>' + vars.toFixed(2) + 'VAR<br>' +
+            'PF=' + (va > 0 ? s.power / va : 1).toFixed(1) + '<br>' + s.energy.toFixed(6) + 'kWh<br>';
+        });
+      }
+      Dygraph.onDOMready(function onDOMready() {
+        poll();
+        setInterval(poll, 10000);
+      });</script>)";
@@ -0,0 +1,58 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define TIMER_TASKS       12
+#define TIMER_WINDOW      10000   // ms over which the idle fraction is taken.
+
+/*
+ * Periodic tasks with fixed deadlines.  Unlike SimpleTimer it can say how
+ * long until the next one is due, so the loop can sleep until then.
+ */
+class Scheduler {
+public:
+  bool setInterval(uint32_t ms, void (*fn)(void));
+  void run(void);
+  uint32_t next(void) const;
+  void idle(uint32_t ms);
+  uint8_t idlePercent(void) const { return percent; }
+
+  uint32_t  late = 0;           // Deadlines passed by more than a period.
+
+private:
+  struct task {
+    void      (*fn)(void);
+    uint32_t  period;
+    uint32_t  due;
+  };
+
+  struct task tasks[TIMER_TASKS];
+  uint8_t     count = 0;
+  uint8_t     percent = 0;
+  uint32_t    windowStart = 0, windowIdle = 0;  // us
+};
@@ -31,3 +31,4 @@
 #define STATE_GOT_IP_ADDRESS    0x08
 #define STATE_FRAM_PRESENT      0x10
 #define STATE_OTA_OR_REBOOT     0x20
+#define STATE_SHED              0x40
@@ -0,0 +1,159 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+/*
+ * Binary UDP control and telemetry, shared by the firmware and tools/s31udp.
+ * Every datagram ends in a SipHash-2-4 tag over the bytes before it, keyed
+ * from a pass phrase.  Requests carry the sender's time and a nonce that
+ * rises within each second, see udpNewer().  The plug drops requests outside
+ * UDP_SKEW of its clock or not newer than the last one from that address.
+ * Multi-byte fields are little endian, as on both the ESP8266 and x86.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define UDP_PORT          3131
+#define UDP_MAGIC         0x53
+#define UDP_VERSION       1
+#define UDP_SKEW          30      // Seconds of clock difference allowed.
+#define UDP_SUB_TTL       600     // Seconds a subscription lasts unless renewed.
+
+#define UDP_OP_STATUS     1
+#define UDP_OP_SET        2       // arg 0 opens the relay, 1 closes it.
+#define UDP_OP_TOGGLE     3
+#define UDP_OP_SUBSCRIBE  4       // arg is the push period in seconds, 0 cancels.
+#define UDP_OP_PUSH       5
+
+#define UDP_OK            0
+#define UDP_ERR_HELD      1       // A trip or the demand limiter holds the relay open.
+#define UDP_ERR_FULL      2       // No free subscription slot.
+#define UDP_ERR_OP        3
+
+struct udpRequest {
+  uint8_t   magic;
+  uint8_t   version;
+  uint8_t   op;
+  uint8_t   arg;
+  uint32_t  nonce;
+  uint32_t  time;
+  uint8_t   tag[8];
+} __attribute__((__packed__));
+
+// Every request is answered with the plug's state after acting on it.
+struct udpStatus {
+  uint8_t   magic;
+  uint8_t   version;
+  uint8_t   op;
+  uint8_t   result;
+  uint32_t  nonce;            // The request's, or the subscription's for pushes.
+  uint32_t  time;
+  uint8_t   state;            // STATE_* bits.
+  uint8_t   trip;
+  uint16_t  cpu;              // us the plug spent on the previous request.
+  float     voltage;
+  float     current;
+  float     power;
+  double    energy;           // kWh
+  uint8_t   tag[8];
+} __attribute__((__packed__));
+
+#define UDP_ROTL(x, b)  (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define UDP_SIPROUND do { \
+    v0 += v1; v1 = UDP_ROTL(v1, 13); v1 ^= v0; v0 = UDP_ROTL(v0, 32); \
+    v2 += v3; v3 = UDP_ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = UDP_ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = UDP_ROTL(v1, 17); v1 ^= v2; v2 = UDP_ROTL(v2, 32); \
+  } while (0)
+
+static inline uint64_t
+udpSipHash(const uint64_t key[2], const uint8_t *in, size_t len)
+{
+  uint64_t  v0 = key[0] ^ 0x736f6d6570736575ULL;
+  uint64_t  v1 = key[1] ^ 0x646f72616e646f6dULL;
+  uint64_t  v2 = key[0] ^ 0x6c7967656e657261ULL;
+  uint64_t  v3 = key[1] ^ 0x7465646279746573ULL;
+  uint64_t  m, b = (uint64_t)len << 56;
+  size_t    i;
+
+  for (; len >= 8; len -= 8, in += 8) {
+    memcpy(&m, in, 8);
+    v3 ^= m;
+    UDP_SIPROUND;
+    UDP_SIPROUND;
+    v0 ^= m;
+  }
+  for (i = 0; i < len; i++)
+    b |= (uint64_t)in[i] << (8 * i);
+  v3 ^= b;
+  UDP_SIPROUND;
+  UDP_SIPROUND;
+  v0 ^= b;
+  v2 ^= 0xff;
+  UDP_SIPROUND;
+  UDP_SIPROUND;
+  UDP_SIPROUND;
+  UDP_SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static inline void
+udpKey(const char *phrase, uint64_t key[2])
+{
+  const uint64_t zero[2] = { 0, 0 };
+
+  key[0] = udpSipHash(zero, (const uint8_t *)phrase, strlen(phrase));
+  key[1] = udpSipHash(key, (const uint8_t *)phrase, strlen(phrase));
+}
+
+// Tag a datagram of len bytes, the last 8 of which are the tag.
+static inline void
+udpSeal(void *pkt, size_t len, const uint64_t key[2])
+{
+  uint64_t tag = udpSipHash(key, (const uint8_t *)pkt, len - 8);
+
+  memcpy((uint8_t *)pkt + len - 8, &tag, 8);
+}
+
+static inline bool
+udpVerify(const void *pkt, size_t len, const uint64_t key[2])
+{
+  uint64_t tag = udpSipHash(key, (const uint8_t *)pkt, len - 8), got;
+
+  memcpy(&got, (const uint8_t *)pkt + len - 8, 8);
+  return (tag ^ got) == 0;
+}
+
+// Whether a request's (time, nonce) is past the last one seen from its sender.
+static inline bool
+udpNewer(uint32_t time, uint32_t nonce, uint32_t lastTime, uint32_t lastNonce)
+{
+  return time > lastTime || (time == lastTime && nonce > lastNonce);
+}
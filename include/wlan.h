@@ -0,0 +1,61 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#pragma once
+
+#define WLAN_BACKOFF_MIN  500     // ms after the first failure, doubled after each.
+#define WLAN_BACKOFF_MAX  60000
+#define WLAN_ATTEMPT      15000   // ms an attempt may take to get an address.
+#define WLAN_BUDGET       8       // Failed attempts before the access point comes up.
+#define WLAN_REASONS      30      // Reasons 1-24 and 200-204, 0 collects the rest.
+#define WLAN_BUCKETS      8
+
+#define WLAN_CONNECTING   0
+#define WLAN_CONNECTED    1
+#define WLAN_BACKOFF      2
+
+struct wlanStats {
+  uint32_t  attempts;
+  uint32_t  disconnects;        // Of an established link.
+  uint32_t  fallbacks;          // Access point brought up.
+  uint32_t  reconnectLast;      // ms from losing the link to an address.
+  uint32_t  reconnectMax;
+  uint16_t  reasons[WLAN_REASONS];
+  uint16_t  reconnects[WLAN_BUCKETS];
+  uint8_t   reason;             // Of the last disconnect.
+};
+
+extern struct wlanStats wlanStats;
+extern const uint16_t wlanBuckets[WLAN_BUCKETS - 1];
+
+void wlanBegin(void);
+void wlanHandle(void);
+uint8_t wlanState(void);
+uint8_t wlanFailures(void);
+uint32_t wlanBackoff(void);
+const uint8_t *wlanHint(uint8_t *channel);
+uint8_t wlanReason(uint8_t i);
@@ -0,0 +1,98 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266mDNS.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cse7759b.h"
+#include "states.h"
+#include "timefmt.h"
+#include "advert.h"
+
+extern uint8_t          state;
+
+static MDNSResponder::hMDNSService service = NULL;
+static char             txtW[12], txtKWh[20];
+static bool             relay, announcedRelay;
+static float            announced;          // Power at the last announcement.
+static uint32_t         lastAnnounce;
+
+/*
+ * The TXT record is built from a snapshot taken by advertUpdate() so that
+ * queries cost no formatting and the values change at a bounded rate.
+ */
+static void
+txtCallback(const MDNSResponder::hMDNSService s)
+{
+  MDNS.addDynamicServiceTxt(s, "relay", relay ? "on" : "off");
+  MDNS.addDynamicServiceTxt(s, "w", txtW);
+  MDNS.addDynamicServiceTxt(s, "kwh", txtKWh);
+}
+
+static void
+snapshot(void)
+{
+  relay = state & STATE_RELAY;
+  *fmtFixed(txtW, power, 0) = '\0';
+  *fmtFixed(txtKWh, energy, 3) = '\0';
+}
+
+// Called after MDNS.begin(), the service is only added once.
+void
+advertBegin(void)
+{
+  if (service)
+    return;
+  snapshot();
+  service = MDNS.addService(NULL, "s31", "tcp", 80);
+  MDNS.addServiceTxt(service, "fw", AUTO_VERSION);
+  MDNS.addServiceTxt(service, "api", "/api/v1/status");
+  MDNS.setDynamicServiceTxtCallback(txtCallback);
+}
+
+/*
+ * Called once a second.  The snapshot answers queries; an announcement is
+ * sent when the relay changes or power moves by ADVERT_CHANGE percent, but
+ * no more often than every ADVERT_PERIOD seconds.
+ */
+void
+advertUpdate(void)
+{
+  if (!service)
+    return;
+  snapshot();
+  if (millis() - lastAnnounce < ADVERT_PERIOD * 1000UL)
+    return;
+  if (relay == announcedRelay && fabs(power - announced) <= announced * ADVERT_CHANGE / 100 + 1)
+    return;
+  MDNS.announce();
+  announcedRelay = relay;
+  announced = power;
+  lastAnnounce = millis();
+}
@@ -0,0 +1,329 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include <FastCRC.h>
+#include <LittleFS.h>
+#include <stdint.h>
+
+#include "assets.h"
+#include "gzip.h"
+#include "page.h"
+
+extern ESP8266WebServer web;
+
+#define IDENTITY  0
+#define GZIP      1
+
+/*
+ * A file in the filesystem root served as is, with its .gz variant if there
+ * is one.  The headers come from what was indexed at boot and a variant's
+ * file stays open once it has been served, so repeat requests don't look it
+ * up again.  Each open file holds its LittleFS buffers, so at most ASSET_OPEN
+ * are kept and the least recently served one is closed to make room.
+ */
+struct asset {
+  char        path[ASSET_PATH];
+  const char *type;
+  uint8_t     found;            // Bit per variant present.
+  uint32_t    size[2];
+  char        etag[2][11];      // Quoted CRC32 of the content.
+  File        file[2];
+  uint32_t    used[2];          // Serve sequence number while open.
+};
+
+static const struct {
+  const char  *ext;
+  const char  *type;
+} types[] = {
+  { ".css",   "text/css" },
+  { ".html",  "text/html" },
+  { ".ico",   "image/x-icon" },
+  { ".js",    "application/javascript" },
+  { ".json",  "application/json" },
+  { ".png",   "image/png" },
+  { ".svg",   "image/svg+xml" },
+};
+
+static struct asset   assets[ASSETS_MAX];
+static uint8_t        count;
+static uint8_t        held;
+static uint32_t       serial;
+
+static const char *
+assetType(const char *path, size_t len)
+{
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    size_t n = strlen(types[i].ext);
+
+    if (len > n && !strncmp(path + len - n, types[i].ext, n))
+      return types[i].type;
+  }
+  return NULL;
+}
+
+static void
+assetEtag(File &f, char *etag)
+{
+  FastCRC32 CRC32;
+  uint8_t   buf[256];
+  uint32_t  crc = 0;
+  int       n;
+  bool      first = true;
+
+  while ((n = f.read(buf, sizeof(buf))) > 0) {
+    crc = first ? CRC32.crc32(buf, n) : CRC32.crc32_upd(buf, n);
+    first = false;
+  }
+  snprintf(etag, 11, "\"%08x\"", (unsigned)crc);
+}
+
+// If-None-Match holds "*" or a list of possibly weak tags.
+static bool
+etagMatch(const char *h, const char *etag)
+{
+  size_t  n = strlen(etag);
+
+  while (*h) {
+    h += strspn(h, " ,");
+    if (*h == '*')
+      return true;
+    if (!strncmp(h, "W/", 2))
+      h += 2;
+    if (!strncmp(h, etag, n) && (!h[n] || h[n] == ',' || h[n] == ' '))
+      return true;
+    h += strcspn(h, ",");
+  }
+  return false;
+}
+
+/*
+ * A single byte range as [start, end).  Returns 1 for a range, 0 to ignore
+ * the header (malformed or several ranges) and -1 when it is unsatisfiable.
+ */
+static int8_t
+assetRange(const char *h, uint32_t size, uint32_t *start, uint32_t *end)
+{
+  unsigned long a, b;
+  char         *e;
+
+  if (strncmp(h, "bytes=", 6) || strchr(h, ','))
+    return 0;
+  h += 6;
+  if (*h == '-') {
+    b = strtoul(h + 1, &e, 10);
+    if (e == h + 1 || *e)
+      return 0;
+    if (!b || !size)
+      return -1;
+    *start = b < size ? size - b : 0;
+    *end = size;
+    return 1;
+  }
+  a = strtoul(h, &e, 10);
+  if (e == h || *e != '-')
+    return 0;
+  h = e + 1;
+  if (*h) {
+    b = strtoul(h, &e, 10);
+    if (e == h || *e || b < a)
+      return 0;
+    b++;
+  } else
+    b = size;
+  if (a >= size)
+    return -1;
+  *start = a;
+  *end = min((uint32_t)b, size);
+  return 1;
+}
+
+static File *
+assetOpen(struct asset *a, uint8_t v)
+{
+  char  path[ASSET_PATH + 3];
+
+  if (!a->file[v]) {
+    if (held == ASSET_OPEN) {
+      struct asset *lru = NULL;
+      uint8_t       lv = 0;
+
+      for (struct asset *b = assets; b < assets + count; b++)
+        for (uint8_t i = 0; i < 2; i++)
+          if (b->file[i] && (!lru || b->used[i] < lru->used[lv])) {
+            lru = b;
+            lv = i;
+          }
+      lru->file[lv].close();
+      held--;
+    }
+    snprintf(path, sizeof(path), "%s%s", a->path, v == GZIP ? ".gz" : "");
+    if (!(a->file[v] = LittleFS.open(path, "r")))
+      return NULL;
+    held++;
+  }
+  a->used[v] = ++serial;
+  return &a->file[v];
+}
+
+static void
+assetServe(struct asset *a)
+{
+  WiFiClient  client = web.client();
+  char        buf[PAGE_MSS], *p;
+  File       *file = NULL;
+  uint8_t     v;
+  uint32_t    start = 0, end;
+  int8_t      range = 0;
+  bool        both = a->found == (1 << IDENTITY | 1 << GZIP);
+
+  v = a->found & 1 << GZIP && (!both || gzipAccepted(web.header("Accept-Encoding").c_str())) ? GZIP : IDENTITY;
+  if (!(a->found & 1 << v)) {
+    client.print("HTTP/1.1 404 Not Found\r\n\r\n");
+    client.stop();
+    return;
+  }
+  end = a->size[v];
+
+  if (web.hasHeader("If-None-Match") && etagMatch(web.header("If-None-Match").c_str(), a->etag[v])) {
+    client.printf("HTTP/1.1 304 Not Modified\r\nETag: %s\r\n%s\r\n", a->etag[v],
+      both ? "Vary: Accept-Encoding\r\n" : "");
+    client.stop();
+    return;
+  }
+  if (web.hasHeader("Range") && (!web.hasHeader("If-Range") || web.header("If-Range") == a->etag[v]))
+    range = assetRange(web.header("Range").c_str(), a->size[v], &start, &end);
+  if (range < 0) {
+    client.printf("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%u\r\n\r\n", (unsigned)a->size[v]);
+    client.stop();
+    return;
+  }
+  if (web.method() != HTTP_HEAD) {
+    if (!(file = assetOpen(a, v))) {
+      client.print("HTTP/1.1 404 Not Found\r\n\r\n");
+      client.stop();
+      return;
+    }
+  }
+
+  p = buf + snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\n"
+    "Content-Type: %s\r\n"
+    "Content-Length: %u\r\n"
+    "ETag: %s\r\n"
+    "Accept-Ranges: bytes\r\n"
+    "Cache-Control: public, max-age=86400, immutable\r\n"
+    "%s%s",
+    range ? "206 Partial Content" : "200 OK", a->type, (unsigned)(end - start), a->etag[v],
+    v == GZIP ? "Content-Encoding: gzip\r\n" : "",
+    both ? "Vary: Accept-Encoding\r\n" : "");
+  if (range)
+    p += snprintf(p, buf + sizeof(buf) - p, "Content-Range: bytes %u-%u/%u\r\n",
+      (unsigned)start, (unsigned)end - 1, (unsigned)a->size[v]);
+  p += snprintf(p, buf + sizeof(buf) - p, "\r\n");
+
+  // The first segment carries the header and the start of the body.
+  if (file && file->seek(start)) {
+    while (start < end) {
+      int n = file->read((uint8_t *)p, min((uint32_t)(buf + sizeof(buf) - p), end - start));
+
+      if (n <= 0)
+        break;
+      p += n;
+      start += n;
+      if (p == buf + sizeof(buf)) {
+        client.write(buf, p - buf);
+        p = buf;
+      }
+    }
+  }
+  if (p > buf)
+    client.write(buf, p - buf);
+  client.stop();
+}
+
+static struct asset *
+assetFind(const char *path, size_t len)
+{
+  for (struct asset *a = assets; a < assets + count; a++)
+    if (!strncmp(a->path, path, len) && !a->path[len])
+      return a;
+  if (count == ASSETS_MAX || len >= ASSET_PATH)
+    return NULL;
+  memcpy(assets[count].path, path, len);
+  assets[count].path[len] = '\0';
+  return &assets[count++];
+}
+
+/*
+ * Index the files in the root with a known type, and their .gz variants,
+ * then route each one.  Called once LittleFS is mounted.
+ */
+void
+assetBegin(void)
+{
+  Dir   dir = LittleFS.openDir("/");
+  char  path[ASSET_PATH + 3];
+
+  while (dir.next()) {
+    struct asset *a;
+    const char   *type;
+    File          file;
+    size_t        len;
+    uint8_t       v = IDENTITY;
+
+    len = snprintf(path, sizeof(path), "/%s", dir.fileName().c_str());
+    if (len >= sizeof(path))
+      continue;
+    if (len > 3 && !strcmp(path + len - 3, ".gz")) {
+      len -= 3;
+      v = GZIP;
+    }
+    if (!(type = assetType(path, len)) || !(a = assetFind(path, len)))
+      continue;
+    a->type = type;
+    if (!(file = dir.openFile("r")))
+      continue;
+    a->found |= 1 << v;
+    a->size[v] = file.size();
+    assetEtag(file, a->etag[v]);
+    file.close();
+  }
+
+  for (struct asset *a = assets; a < assets + count; a++)
+    web.on(a->path, [a]() { assetServe(a); });
+}
+
+// Close the kept files before the filesystem is unmounted or rewritten.
+void
+assetEnd(void)
+{
+  for (struct asset *a = assets; a < assets + count; a++)
+    for (uint8_t v = 0; v < 2; v++)
+      a->file[v].close();
+  held = 0;
+}
@@ -0,0 +1,196 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <FastCRC.h>
+#include <FRAM.h>
+#include <LittleFS.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "cfgstore.h"
+#include "nvdata.h"
+#include "states.h"
+
+extern struct config    cfg;
+extern struct nvHeader  nvHeader;
+extern FRAM32           fram;
+extern uint8_t          state;
+
+struct cfgStats         cfgStats;
+const char             *cfgStores[] = { "EEPROM", "LittleFS", "FRAM" };
+static uint32_t         saved;          // CRC of the config last loaded or saved.
+static bool             valid;
+
+static_assert(sizeof(struct config) + sizeof(struct cfgSlot) <= CFG_SLOT, "config outgrew CFG_SLOT");
+
+static inline uint32_t
+slotAddress(uint8_t slot)
+{
+  return nvHeader.size - (2 - slot) * CFG_SLOT;
+}
+
+static uint32_t
+slotCrc(const struct cfgSlot *hdr, const uint8_t *data)
+{
+  FastCRC32 CRC32;
+
+  CRC32.crc32((const uint8_t *)&hdr->seq, sizeof(hdr->seq) + sizeof(hdr->len));
+  return CRC32.crc32_upd(data, hdr->len);
+}
+
+// Read a slot into the config, leaving it untouched unless the slot is whole.
+static bool
+slotRead(uint8_t slot, struct cfgSlot *hdr)
+{
+  uint8_t   data[CFG_SLOT - sizeof(struct cfgSlot)];
+  char      path[16];
+  File      f;
+
+  if (cfgStats.store == CFG_STORE_FRAM) {
+    fram.read(slotAddress(slot), (uint8_t *)hdr, sizeof(*hdr));
+    if (hdr->magic != CFG_MAGIC || hdr->len > sizeof(data))
+      return false;
+    fram.read(slotAddress(slot) + sizeof(*hdr), data, hdr->len);
+  }
+  else {
+    snprintf(path, sizeof(path), CFG_FILE, slot);
+    if (!(f = LittleFS.open(path, "r")))
+      return false;
+    if (f.read((uint8_t *)hdr, sizeof(*hdr)) != sizeof(*hdr) || hdr->magic != CFG_MAGIC ||
+        hdr->len > sizeof(data) || f.read(data, hdr->len) != hdr->len) {
+      f.close();
+      return false;
+    }
+    f.close();
+  }
+  if (hdr->crc != slotCrc(hdr, data))
+    return false;
+  memset(&cfg, '\0', sizeof(cfg));
+  memcpy(&cfg, data, min((size_t)hdr->len, sizeof(cfg)));
+  return true;
+}
+
+static void
+slotWrite(uint8_t slot, struct cfgSlot *hdr)
+{
+  char  path[16];
+  File  f;
+
+  if (cfgStats.store == CFG_STORE_FRAM) {
+    fram.write(slotAddress(slot) + sizeof(*hdr), (uint8_t *)&cfg, sizeof(cfg));
+    fram.write(slotAddress(slot), (uint8_t *)hdr, sizeof(*hdr));
+  }
+  else {
+    snprintf(path, sizeof(path), CFG_FILE, slot);
+    if ((f = LittleFS.open(path, "w"))) {
+      f.write((uint8_t *)hdr, sizeof(*hdr));
+      f.write((uint8_t *)&cfg, sizeof(cfg));
+      f.close();
+    }
+  }
+}
+
+/*
+ * Load the newest whole slot from FRAM if fitted, otherwise from LittleFS
+ * if mounted.  Without one the config is read from the EEPROM sector it has
+ * always lived in, and false tells the caller to save it into the slots.
+ * Without FRAM that sector mirrors every save, so a filesystem image
+ * uploaded over the slots costs nothing saved since.
+ */
+bool
+cfgLoad(bool fs)
+{
+  FastCRC32       CRC32;
+  struct cfgSlot  hdr[2];
+  bool            ok[2];
+
+  cfgStats.store = state & STATE_FRAM_PRESENT ? CFG_STORE_FRAM : fs ? CFG_STORE_FS : CFG_STORE_EEPROM;
+  if (cfgStats.store != CFG_STORE_EEPROM) {
+    ok[1] = slotRead(1, &hdr[1]);
+    ok[0] = slotRead(0, &hdr[0]);
+    // The slot read last is the one loaded, so read 1 again if it is newer.
+    if (ok[0] && ok[1] && (int32_t)(hdr[1].seq - hdr[0].seq) > 0)
+      slotRead(1, &hdr[1]);
+    if (ok[0] || ok[1]) {
+      cfgStats.slot = ok[0] && ok[1] ? (int32_t)(hdr[1].seq - hdr[0].seq) > 0 : ok[1];
+      cfgStats.seq = hdr[cfgStats.slot].seq;
+      saved = CRC32.crc32((uint8_t *)&cfg, sizeof(cfg));
+      valid = true;
+      return true;
+    }
+  }
+
+  EEPROM.begin(sizeof(cfg));
+  EEPROM.get(0, cfg);
+  if (cfgStats.store != CFG_STORE_EEPROM) {
+    EEPROM.end();
+    return false;
+  }
+  saved = CRC32.crc32((uint8_t *)&cfg, sizeof(cfg));
+  valid = true;
+  return true;
+}
+
+void
+saveConfig(void)
+{
+  FastCRC32       CRC32;
+  struct cfgSlot  hdr;
+  uint32_t        crc = CRC32.crc32((uint8_t *)&cfg, sizeof(cfg)), start = micros();
+
+  if (valid && crc == saved) {
+    cfgStats.unchanged++;
+    return;
+  }
+
+  if (cfgStats.store == CFG_STORE_EEPROM) {
+    EEPROM.put(0, cfg);
+    EEPROM.commit();
+  }
+  else {
+    if (valid)
+      cfgStats.slot ^= 1;
+    hdr.magic = CFG_MAGIC;
+    hdr.seq = ++cfgStats.seq;
+    hdr.len = sizeof(cfg);
+    hdr.crc = slotCrc(&hdr, (uint8_t *)&cfg);
+    slotWrite(cfgStats.slot, &hdr);
+    if (cfgStats.store == CFG_STORE_FS) {
+      EEPROM.begin(sizeof(cfg));
+      EEPROM.put(0, cfg);
+      EEPROM.end();
+    }
+  }
+  saved = crc;
+  valid = true;
+  cfgStats.saves++;
+  cfgStats.commitLast = micros() - start;
+  cfgStats.commitMax = max(cfgStats.commitMax, cfgStats.commitLast);
+}
@@ -0,0 +1,115 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <FRAM.h>
+#include <FastCRC.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "states.h"
+#include "checkpoint.h"
+
+extern struct config    cfg;
+extern FRAM32           fram;
+extern struct nvHeader  nvHeader;
+extern uint8_t          state;
+
+uint16_t                checkpointHoldup = 0;
+uint16_t                checkpointLatency = 0;
+static struct checkpoint  cp;
+static uint32_t         sagStart = 0;
+static bool             sagged = false;
+
+/*
+ * Called for every frame from the CSE7759B.  While the voltage is below the
+ * brownout threshold the counters are rewritten each frame, so the last
+ * write before the supply collapses gives the hold-up time.  Only the
+ * counters and CRC are filled in here, the rest of the record is ready.
+ */
+void
+checkpointSag(double v, uint32_t ovflow, uint16_t pulses)
+{
+  FastCRC16 CRC16;
+  uint32_t  start;
+  bool      first;
+
+  // A frame without a voltage reading is not a sag.
+  if (!cfg.brownoutV || ~state & STATE_FRAM_PRESENT || v <= 0)
+    return;
+
+  if (v >= cfg.brownoutV) {
+    if (sagged && v >= cfg.brownoutV + CHECKPOINT_HYSTERESIS)
+      sagged = false;
+    return;
+  }
+
+  start = micros();
+  first = !sagged;
+  if (first) {
+    sagged = true;
+    sagStart = millis();
+  }
+  cp.boots = nvHeader.boots;
+  cp.ovflow = ovflow;
+  cp.pulses = pulses;
+  cp.holdup = min((uint32_t)(millis() - sagStart), (uint32_t)UINT16_MAX);
+  cp.crc = CRC16.ccitt((uint8_t *)&cp, sizeof(cp) - 2);
+  fram.write(CHECKPOINT_OFFSET, (uint8_t *)&cp, sizeof(cp));
+  if (!first)
+    return;
+
+  // The counters are safe, now put this sag's latency in place of the last one's.
+  cp.latency = checkpointLatency = min((uint32_t)(micros() - start), (uint32_t)UINT16_MAX);
+  cp.crc = CRC16.ccitt((uint8_t *)&cp, sizeof(cp) - 2);
+  fram.write(CHECKPOINT_OFFSET + offsetof(struct checkpoint, latency), (uint8_t *)&cp.latency,
+    sizeof(cp) - offsetof(struct checkpoint, latency));
+}
+
+/*
+ * After a power loss use the checkpoint if it was written by the last run and
+ * is ahead of the counters in the header.  The hold-up and latency it recorded
+ * are kept for display.
+ */
+bool
+checkpointRestore(void)
+{
+  FastCRC16 CRC16;
+
+  fram.read(CHECKPOINT_OFFSET, (uint8_t *)&cp, sizeof(cp));
+  if (cp.crc != CRC16.ccitt((uint8_t *)&cp, sizeof(cp) - 2) || cp.boots != nvHeader.boots)
+    return false;
+
+  checkpointHoldup = cp.holdup;
+  checkpointLatency = cp.latency;
+  if (cp.ovflow * 65536ULL + cp.pulses <= nvHeader.ovflow * 65536ULL + nvHeader.pulses)
+    return false;
+  nvHeader.ovflow = cp.ovflow;
+  nvHeader.pulses = cp.pulses;
+  return true;
+}
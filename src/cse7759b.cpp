@@ -28,22 +28,29 @@
 #include <Arduino.h>
 #include <stdint.h>
 
+#include "checkpoint.h"
 #include "cse7759b.h"
-#include "nvdata.h"
 #include "config.h"
+#include "nvdata.h"
+#include "protect.h"
 #include "states.h"
+#include "tariff.h"
 
 double          power = 0;
 double          ave_power = 0;
-uint8_t         ave_count = 0;
+uint16_t        ave_count = 0;
 double          voltage = 0;
 double          current = 0;
 double          energy = 0;
+double          kWhPerPulse = 0;
 extern struct nvHeader nvHeader;
 extern uint8_t  state;
 uint32_t        ovflow;
 uint16_t        restoredPulses;
 uint8_t         packet[24];
+static uint8_t  received = 0;
+static uint32_t drained = 0;    // micros() when the UART was last found empty mid frame.
+static uint32_t since = 0;      // Bytes read since.
 int             err;
 
 // CSE77xx error codes.
@@ -85,7 +92,7 @@ checkSum(void) {
 }
 
 static void
-processPacket(void) {
+processPacket(uint32_t frame) {
   if (!checkSum()) {
     err = CSE_ERROR_CRC;
     return;
@@ -121,6 +128,7 @@ processPacket(void) {
       current = cfg.calibration.I * kI / (tI * V1R);
     }
   }
+  protectCheck(current, power, frame);
 
   // I think that kP is constant but calculate it anyway. kP = 5264000 
   uint16_t CFpulses = packet[21] << 8 | packet[22];
@@ -129,48 +137,77 @@ processPacket(void) {
     ovflow++;
     lastAdj = adj;
   }
+  checkpointSag(voltage, ovflow, CFpulses);
   if (state & STATE_FRAM_PRESENT) {
     nvHeader.ovflow = ovflow;
     nvHeader.pulses = CFpulses;
   }
-  energy = (ovflow * 65536.0 + CFpulses + restoredPulses) / (Fcf * 3600);
+  uint64_t pulses = ovflow * 65536ULL + CFpulses + restoredPulses;
+  static uint64_t lastPulses = pulses;
+  if (pulses > lastPulses)
+    tariffAddPulses(pulses - lastPulses);
+  lastPulses = pulses;
+  kWhPerPulse = 1.0 / (Fcf * 3600);
+  energy = pulses * kWhPerPulse;
 }
 
 void
 readCse7759b(void) {
-  static uint8_t index = 0;
+  uint32_t       frame = 0;
 
   err = CSE_ERROR_OTHER;
 
-  while (Serial.available() > 0) {
-    uint8_t input = Serial.read();
+  for (;;) {
+    uint32_t  now = micros();
+    uint8_t   input;
+
+    if (Serial.available() <= 0) {
+      drained = now;
+      since = 0;
+      break;
+    }
+    input = Serial.read();
+    since++;
 
-    if (index == 0) {
+    if (received == 0) {
       if ((input != 0x55) && (input < 0xF0))
         continue;
     }
-    else if (index == 1) {
+    else if (received == 1) {
       if (input != 0x5A) {
-        index = 0;
+        received = 0;
         continue;
       }
     }
 
-    packet[index++] = input;
+    packet[received++] = input;
 
-    if (index > 23) {
+    /*
+     * The earliest the frame can have been whole, however long loop() was
+     * away: every byte read since the UART was last seen empty came after
+     * that, and no faster than the line rate.
+     */
+    if (received > 23) {
+      frame = drained + (since - 1) * CSE_BYTE_US;
       Serial.flush();
       break;
     }
   }
 
-  if (index == 24) {
+  if (received == 24) {
     err = CSE_ERROR_OK;
-    processPacket();
-    index = 0;
-  }
-  if (state & STATE_FRAM_PRESENT) {
+    processPacket(frame);
+    received = 0;
     ave_power += power;
     ave_count++;
   }
-}
\ No newline at end of file
+}
+
+// Milliseconds until the frame being received is complete.
+uint32_t
+cseNext(void)
+{
+  int missing = sizeof(packet) - received - Serial.available();
+
+  return missing > 0 ? missing * CSE_BYTE_US / 1000 : 0;
+}
@@ -0,0 +1,113 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "states.h"
+#include "demand.h"
+
+extern struct config    cfg;
+extern uint8_t          state;
+extern double           power;
+bool setRelay(bool on);
+
+bool                    demandWanted = false;   // Relay state to return to when restored.
+
+/*
+ * The window is a ring of DEMAND_BUCKETS buckets each holding the energy of
+ * width seconds in 0.1W.s.  A second's sample goes into the partial bucket and
+ * the running total is adjusted as buckets complete, so the average costs the
+ * same whatever the window.
+ */
+static uint32_t         ring[DEMAND_BUCKETS];
+static uint32_t         total, partial;
+static uint16_t         width, elapsed;
+static uint8_t          head;
+
+static void
+demandReset(void)
+{
+  memset(ring, '\0', sizeof(ring));
+  total = partial = 0;
+  elapsed = 0;
+  head = 0;
+  width = cfg.demandMin * 60 / DEMAND_BUCKETS;
+}
+
+/*
+ * The oldest bucket is pro-rated by the part of it still inside the window.
+ * Until the window has filled the missing time counts as no load.
+ */
+float
+demandAverage(void)
+{
+  if (!width)
+    return 0;
+  return (total - (uint64_t)ring[head] * elapsed / width + partial) / 10.0 / (width * DEMAND_BUCKETS);
+}
+
+/*
+ * Called once a second.  A trip outranks shedding, which outranks the
+ * schedule and manual switching: while shed those only change the state the
+ * relay is restored to.
+ */
+void
+demandUpdate(void)
+{
+  float avg;
+
+  if (cfg.demandMin * 60 / DEMAND_BUCKETS != width)
+    demandReset();
+  if (!width || !cfg.demandW) {
+    if (state & STATE_SHED) {
+      state &= ~STATE_SHED;
+      setRelay(demandWanted);
+    }
+    return;
+  }
+
+  partial += max(power, 0.0) * 10;
+  if (++elapsed == width) {
+    total += partial - ring[head];
+    ring[head] = partial;
+    head = (head + 1) % DEMAND_BUCKETS;
+    partial = elapsed = 0;
+  }
+
+  avg = demandAverage();
+  if (~state & STATE_SHED && state & STATE_RELAY && avg > cfg.demandW) {
+    demandWanted = true;
+    setRelay(false);
+    state |= STATE_SHED;
+  }
+  else if (state & STATE_SHED && avg < cfg.demandW * (100 - cfg.demandPct) / 100.0) {
+    state &= ~STATE_SHED;
+    setRelay(demandWanted);
+  }
+}
@@ -0,0 +1,572 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "form.h"
+
+extern ESP8266WebServer web;
+
+// The index from the digits following the field name, -1 if they don't fit.
+static int16_t
+formIndex(const struct formField *f, const char *s)
+{
+  if (!f->count)
+    return *s ? -1 : 0;
+  if (!isdigit(s[0]) || s[0] - '0' >= f->count)
+    return -1;
+  if (!f->inner)
+    return s[1] ? -1 : s[0] - '0';
+  if (!isdigit(s[1]) || s[1] - '0' >= f->inner || s[2])
+    return -1;
+  return (s[0] - '0') * f->inner + s[1] - '0';
+}
+
+static bool
+formApply(const struct formField *f, uint8_t *p, const char *v)
+{
+  char     *e;
+  long      l;
+  float     x;
+
+  switch (f->type) {
+    case FORM_STR:
+    case FORM_SECRET:
+      strncpy((char *)p, v, f->size);
+      p[f->size - 1] = '\0';
+      return true;
+    case FORM_FLOAT:
+      x = strtof(v, &e);
+      if (e == v || *e || !isfinite(x))
+        return false;
+      x = constrain(x, f->min, f->max);
+      memcpy(p, &x, sizeof(x));
+      return true;
+    case FORM_INT:
+    case FORM_BITS:
+      l = strtol(v, &e, 10);
+      if (e == v || *e)
+        return false;
+      l = constrain(l, (long)f->min, (long)f->max);
+      if (f->type == FORM_BITS)
+        *p = (*p & ~f->size) | (l & f->size);
+      else
+        memcpy(p, &l, f->size);     // Little endian, the low bytes come first.
+      return true;
+    case FORM_FLAG:
+      *p |= f->size;
+      return true;
+    case FORM_HM:
+      l = strtol(v, &e, 10);
+      if (e == v || *e != ':' || l < 0 || l > 23)
+        return false;
+      p[0] = l;
+      l = strtol(v = e + 1, &e, 10);
+      if (e == v || *e || l < 0 || l > 59)
+        return false;
+      p[1] = l;
+      return true;
+  }
+  return false;
+}
+
+// Checkboxes are cleared first as an unticked box isn't sent.
+static void
+formClear(const struct formField *fields, uint8_t n, uint8_t *b)
+{
+  struct formField  f;
+
+  for (uint8_t i = 0; i < n; i++) {
+    memcpy_P(&f, &fields[i], sizeof(f));
+    if (f.type != FORM_FLAG)
+      continue;
+    for (uint8_t j = 0; j < max(f.count, (uint8_t)1) * max(f.inner, (uint8_t)1); j++)
+      b[f.offset + j * f.stride] &= ~f.size;
+  }
+}
+
+// Apply one argument, false if its field rejected the value.
+static bool
+formArg(const struct formField *fields, uint8_t n, uint8_t *b, const char *key, const char *value)
+{
+  struct formField  f;
+
+  for (uint8_t i = 0; i < n; i++) {
+    size_t  len;
+    int16_t index;
+
+    memcpy_P(&f, &fields[i], sizeof(f));
+    len = strnlen(f.name, sizeof(f.name));
+    if (strncmp(key, f.name, len) || (index = formIndex(&f, key + len)) < 0)
+      continue;
+    return formApply(&f, b + f.offset + index * f.stride, value);
+  }
+  return true;
+}
+
+/*
+ * Decode the request's arguments into 'base' in one pass.  The server's
+ * parsed arguments are walked by index, which hands out references rather
+ * than building a String for every lookup.  Returns the number of values
+ * rejected.  Handlers given the body raw use formBodyFeed() instead.
+ */
+uint8_t
+formDecode(const struct formField *fields, uint8_t n, void *base)
+{
+  uint8_t  *b = (uint8_t *)base, bad = 0;
+
+  formClear(fields, n, b);
+  for (int a = 0; a < web.args(); a++)
+    bad += !formArg(fields, n, b, web.argName(a).c_str(), web.arg(a).c_str());
+  return bad;
+}
+
+void
+formBodyBegin(struct formBody *b, const struct formField *fields, uint8_t n, void *base)
+{
+  memset(b, '\0', sizeof(*b));
+  b->fields = fields;
+  b->n = n;
+  b->base = (uint8_t *)base;
+  formClear(fields, n, b->base);
+}
+
+static void
+bodyPair(struct formBody *b)
+{
+  if (b->inValue)
+    b->value[b->len] = '\0';
+  else
+    b->key[b->len] = '\0';
+  if (*b->key && !b->skip && !formArg(b->fields, b->n, b->base, b->key, b->inValue ? b->value : ""))
+    b->bad++;
+  b->key[0] = '\0';
+  b->len = 0;
+  b->inValue = b->skip = false;
+  b->hex = 0;
+}
+
+static void
+bodyAppend(struct formBody *b, char c)
+{
+  if (b->inValue) {
+    if (b->len < sizeof(b->value) - 1)
+      b->value[b->len++] = c;
+  }
+  else if (b->len < sizeof(b->key) - 1)
+    b->key[b->len++] = c;
+  else
+    b->skip = true;
+}
+
+/*
+ * Take the next piece of the body, which may end anywhere, even inside an
+ * escape.  Each pair is applied as soon as it is complete.
+ */
+void
+formBodyFeed(struct formBody *b, const char *s, size_t len)
+{
+  for (const char *e = s + len; s < e; s++) {
+    char  c = *s;
+
+    if (b->hex) {
+      b->code = b->code << 4 | (isdigit(c) ? c - '0' : isxdigit(c) ? (c | 0x20) - 'a' + 10 : 0);
+      if (!--b->hex)
+        bodyAppend(b, b->code);
+    }
+    else if (c == '&')
+      bodyPair(b);
+    else if (c == '=' && !b->inValue) {
+      b->key[b->len] = '\0';
+      b->len = 0;
+      b->inValue = true;
+    }
+    else if (c == '%') {
+      b->hex = 2;
+      b->code = 0;
+    }
+    else
+      bodyAppend(b, c == '+' ? ' ' : c);
+  }
+}
+
+// Apply the last pair, returns the number of values rejected.
+uint8_t
+formBodyEnd(struct formBody *b)
+{
+  bodyPair(b);
+  return b->bad;
+}
+
+#define WANT_VALUE  0
+#define WANT_KEY    1
+#define WANT_COLON  2
+#define WANT_NEXT   3       // ',' or the closing bracket.
+
+#define LEX_SPACE   0
+#define LEX_STRING  1
+#define LEX_ESCAPE  2
+#define LEX_BARE    3
+
+#define NO_SECTION  0xff
+
+static void
+jsonKey(struct formJson *j, const char *key)
+{
+  struct formSection  s;
+  uint8_t             section = j->frame[j->depth].section;
+
+  j->hasField = false;
+  j->pending = NO_SECTION;
+  if (section == NO_SECTION)
+    return;
+  if (section == 0) {
+    for (uint8_t i = 1; i < j->nsections; i++) {
+      memcpy_P(&s, &j->sections[i], sizeof(s));
+      if (!strcmp(key, s.name)) {
+        j->pending = i;
+        return;
+      }
+    }
+  }
+  memcpy_P(&s, &j->sections[section], sizeof(s));
+  for (uint8_t i = 0; i < s.n; i++) {
+    memcpy_P(&j->field, &s.fields[i], sizeof(j->field));
+    if (!strncmp(key, j->field.name, sizeof(j->field.name))) {
+      j->hasField = true;
+      j->fieldDepth = j->depth;
+      return;
+    }
+  }
+}
+
+// A scalar for the current field, indexed by the arrays it sits in.
+static void
+jsonValue(struct formJson *j, const char *v, bool string)
+{
+  struct formField *f = &j->field;
+  uint8_t           arrays = j->depth - j->fieldDepth, *p;
+  int16_t           index = 0;
+
+  if (!j->hasField)
+    return;
+  if (arrays != (f->count ? 1 : 0) + (f->inner ? 1 : 0)) {
+    j->bad++;
+    return;
+  }
+  if (arrays) {
+    index = j->frame[j->fieldDepth + 1].index;
+    if (index >= f->count || (f->inner && j->frame[j->fieldDepth + 2].index >= f->inner)) {
+      j->bad++;
+      return;
+    }
+    if (f->inner)
+      index = index * f->inner + j->frame[j->fieldDepth + 2].index;
+  }
+  p = j->base + f->offset + index * f->stride;
+  if (f->type == FORM_FLAG) {
+    if (!string && !strcmp(v, "true"))
+      *p |= f->size;
+    else if (!string && !strcmp(v, "false"))
+      *p &= ~f->size;
+    else
+      j->bad++;
+  }
+  else if ((string != (f->type == FORM_STR || f->type == FORM_SECRET || f->type == FORM_HM)) || !formApply(f, p, v))
+    j->bad++;
+}
+
+static void
+jsonToken(struct formJson *j)
+{
+  j->tok[j->len] = '\0';
+  if (j->want == WANT_KEY && j->string) {
+    jsonKey(j, j->tok);
+    j->want = WANT_COLON;
+  }
+  else if (j->want == WANT_VALUE && j->depth) {
+    jsonValue(j, j->tok, j->string);
+    j->want = WANT_NEXT;
+  }
+  else
+    j->error = true;
+  j->frame[j->depth].empty = false;
+}
+
+static void
+jsonPunct(struct formJson *j, char c)
+{
+  uint8_t   section = NO_SECTION;
+
+  switch (c) {
+    case '{':
+    case '[':
+      if (j->want != WANT_VALUE || j->depth == FORM_JSON_DEPTH || (!j->depth && c != '{')) {
+        j->error = true;
+        return;
+      }
+      if (!j->depth)
+        section = 0;
+      else if (c == '{' && j->pending != NO_SECTION && j->depth == 1)
+        section = j->pending;
+      else if (c == '{' && j->hasField) {
+        j->hasField = false;
+        j->bad++;
+      }
+      j->frame[j->depth].empty = false;
+      j->depth++;
+      j->frame[j->depth] = { c == '[', true, section, 0 };
+      j->want = c == '{' ? WANT_KEY : WANT_VALUE;
+      return;
+    case '}':
+    case ']':
+      if (!j->depth || j->frame[j->depth].array != (c == ']') ||
+          !(j->want == WANT_NEXT || (j->frame[j->depth].empty && j->want == (c == '}' ? WANT_KEY : WANT_VALUE)))) {
+        j->error = true;
+        return;
+      }
+      if (--j->depth == 0)
+        j->done = true;
+      j->want = WANT_NEXT;
+      return;
+    case ':':
+      if (j->want != WANT_COLON)
+        j->error = true;
+      j->want = WANT_VALUE;
+      return;
+    case ',':
+      if (j->want != WANT_NEXT || !j->depth)
+        j->error = true;
+      else if (j->frame[j->depth].array) {
+        if (j->frame[j->depth].index < UINT8_MAX)
+          j->frame[j->depth].index++;
+        j->want = WANT_VALUE;
+      }
+      else
+        j->want = WANT_KEY;
+      return;
+  }
+  j->error = true;
+}
+
+static void
+jsonAppend(struct formJson *j, char c)
+{
+  if (j->len < sizeof(j->tok) - 1)
+    j->tok[j->len++] = c;
+}
+
+void
+formJsonBegin(struct formJson *j, const struct formSection *sections, uint8_t n, void *base)
+{
+  memset(j, '\0', sizeof(*j));
+  j->sections = sections;
+  j->nsections = n;
+  j->base = (uint8_t *)base;
+  j->pending = NO_SECTION;
+  j->want = WANT_VALUE;
+}
+
+/*
+ * Take the next piece of the document, which may end anywhere.  Strings are
+ * unescaped into the token buffer, other than \u which only passes ASCII.
+ * Returns false once the document is malformed.
+ */
+bool
+formJsonFeed(struct formJson *j, const char *s, size_t len)
+{
+  for (const char *e = s + len; s < e && !j->error; s++) {
+    char  c = *s;
+
+    switch (j->lex) {
+      case LEX_STRING:
+        if (j->hex) {
+          if (!isxdigit(c))
+            j->error = true;
+          j->code = j->code << 4 | (isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+          if (!--j->hex)
+            jsonAppend(j, j->code >= ' ' && j->code < 0x80 ? j->code : '?');
+        }
+        else if (c == '\\')
+          j->lex = LEX_ESCAPE;
+        else if (c == '"') {
+          jsonToken(j);
+          j->lex = LEX_SPACE;
+        }
+        else if ((uint8_t)c < ' ')
+          j->error = true;
+        else
+          jsonAppend(j, c);
+        break;
+      case LEX_ESCAPE:
+        j->lex = LEX_STRING;
+        if (c == 'u') {
+          j->hex = 4;
+          j->code = 0;
+        }
+        else if (strchr("\"\\/", c))
+          jsonAppend(j, c);
+        else if (c == 'n' || c == 't' || c == 'r' || c == 'b' || c == 'f')
+          jsonAppend(j, ' ');
+        else
+          j->error = true;
+        break;
+      case LEX_BARE:
+        if (isalnum(c) || c == '-' || c == '+' || c == '.') {
+          jsonAppend(j, c);
+          break;
+        }
+        jsonToken(j);
+        j->lex = LEX_SPACE;
+        // Fall through - the character ends the token and may be punctuation.
+      case LEX_SPACE:
+        if (isspace(c) || j->error)
+          break;
+        if (j->done)
+          j->error = true;
+        else if (c == '"' || isalnum(c) || c == '-') {
+          j->lex = c == '"' ? LEX_STRING : LEX_BARE;
+          j->string = c == '"';
+          j->len = 0;
+          if (c != '"')
+            jsonAppend(j, c);
+        }
+        else
+          jsonPunct(j, c);
+        break;
+    }
+  }
+  return !j->error;
+}
+
+// True if the document was complete and well formed.
+bool
+formJsonEnd(struct formJson *j)
+{
+  return !j->error && j->done && j->lex == LEX_SPACE;
+}
+
+static void
+jsonString(Print &out, const char *s, size_t size)
+{
+  out.write('"');
+  for (const char *e = s + strnlen(s, size); s < e; s++) {
+    if (*s == '"' || *s == '\\')
+      out.write('\\');
+    if ((uint8_t)*s < ' ')
+      out.printf("\\u%04x", *s);
+    else
+      out.write(*s);
+  }
+  out.write('"');
+}
+
+static void
+jsonScalar(Print &out, const struct formField *f, const uint8_t *p)
+{
+  uint32_t  l = 0;
+  float     x;
+
+  switch (f->type) {
+    case FORM_STR:
+      jsonString(out, (const char *)p, f->size);
+      break;
+    case FORM_FLOAT:
+      memcpy(&x, p, sizeof(x));
+      if (isfinite(x))
+        out.printf("%g", x);
+      else
+        out.print("null");
+      break;
+    case FORM_INT:
+      memcpy(&l, p, f->size);
+      out.printf("%u", (unsigned)l);
+      break;
+    case FORM_BITS:
+      out.printf("%u", *p & f->size);
+      break;
+    case FORM_FLAG:
+      out.print(*p & f->size ? "true" : "false");
+      break;
+    case FORM_HM:
+      out.printf("\"%02u:%02u\"", p[0], p[1]);
+      break;
+  }
+}
+
+void
+formJsonWrite(Print &out, const struct formSection *sections, uint8_t n, const void *base)
+{
+  struct formSection  s;
+  struct formField    f;
+  const uint8_t      *b = (const uint8_t *)base;
+  bool                first;
+
+  for (uint8_t i = 0; i < n; i++) {
+    memcpy_P(&s, &sections[i], sizeof(s));
+    if (i)
+      out.printf(",\"%s\":{", s.name);
+    else
+      out.write('{');
+    first = true;
+    for (uint8_t k = 0; k < s.n; k++) {
+      memcpy_P(&f, &s.fields[k], sizeof(f));
+      if (f.type == FORM_SECRET)
+        continue;
+      out.printf("%s\"%.*s\":", first ? "" : ",", (int)sizeof(f.name), f.name);
+      first = false;
+      if (!f.count) {
+        jsonScalar(out, &f, b + f.offset);
+        continue;
+      }
+      out.write('[');
+      for (uint8_t x = 0; x < f.count; x++) {
+        if (x)
+          out.write(',');
+        if (!f.inner) {
+          jsonScalar(out, &f, b + f.offset + x * f.stride);
+          continue;
+        }
+        out.write('[');
+        for (uint8_t y = 0; y < f.inner; y++) {
+          if (y)
+            out.write(',');
+          jsonScalar(out, &f, b + f.offset + (x * f.inner + y) * f.stride);
+        }
+        out.write(']');
+      }
+      out.write(']');
+    }
+    if (i)
+      out.write('}');
+  }
+  out.print("}\n");
+}
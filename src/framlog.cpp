@@ -0,0 +1,137 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <FRAM.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+extern FRAM32           fram;
+void saveNvHeader(void);
+
+static inline uint32_t
+address(uint32_t i)
+{
+  return NV_LOG_OFFSET + i * sizeof(struct nvLog);
+}
+
+uint32_t
+FramLog::count(void)
+{
+  return (nvHeader.nvLogLast + nvHeader.nvLogMax - nvHeader.nvLogFirst) % nvHeader.nvLogMax;
+}
+
+bool
+FramLog::read(uint32_t i, struct nvLog *log)
+{
+  fram.read(address((i + nvHeader.nvLogFirst) % nvHeader.nvLogMax), (uint8_t *)log, sizeof(struct nvLog));
+  return true;
+}
+
+bool
+FramLog::append(const struct nvLog *log)
+{
+  fram.write(address(nvHeader.nvLogLast), (uint8_t *)log, sizeof(struct nvLog));
+  nvHeader.nvLogLast++;
+  nvHeader.nvLogLast %= nvHeader.nvLogMax;
+  if (nvHeader.nvLogLast == 0)
+    nvHeader.generation++;
+  if (nvHeader.nvLogLast == nvHeader.nvLogFirst) {
+    nvHeader.nvLogFirst++;
+    nvHeader.nvLogFirst %= nvHeader.nvLogMax;
+  }
+  saveNvHeader();
+  return true;
+}
+
+void
+FramLog::etag(char *buf, size_t len)
+{
+  snprintf(buf, len, "\"%u-%u\"", nvHeader.generation, (unsigned)nvHeader.nvLogLast);
+}
+
+static void
+reverse(uint32_t lo, uint32_t hi)
+{
+  struct nvLog  a, b;
+
+  while (lo + 1 < hi) {
+    hi--;
+    fram.read(address(lo), (uint8_t *)&a, sizeof(struct nvLog));
+    fram.read(address(hi), (uint8_t *)&b, sizeof(struct nvLog));
+    fram.write(address(lo), (uint8_t *)&b, sizeof(struct nvLog));
+    fram.write(address(hi), (uint8_t *)&a, sizeof(struct nvLog));
+    if (++lo % 64 == 0)
+      yield();
+  }
+}
+
+/*
+ * Lay the ring out for a new size: rotate the oldest record to slot 0 and,
+ * when the ring has shrunk, keep only the newest records.  The records move
+ * in place, so the header first goes out with no ring laid out.  Should the
+ * power fail part way, the next boot finds that and starts an empty log
+ * rather than reading a half rotated one.  The caller saves the header.
+ */
+void
+framLogResize(uint32_t max)
+{
+  uint32_t      first = nvHeader.nvLogFirst, old = nvHeader.nvLogMax, n = 0;
+  struct nvLog  chunk[16];
+
+  if (old) {
+    n = (nvHeader.nvLogLast + old - first) % old;
+    nvHeader.nvLogMax = 0;
+    saveNvHeader();
+    if (first) {
+      reverse(0, first);
+      reverse(first, old);
+      reverse(0, old);
+    }
+  }
+
+  if (n > max - 1) {
+    uint32_t drop = n - (max - 1);
+
+    n = max - 1;
+    for (uint32_t i = 0; i < n; i += 16) {
+      uint16_t len = min((uint32_t)16, n - i) * sizeof(struct nvLog);
+
+      fram.read(address(drop + i), (uint8_t *)chunk, len);
+      fram.write(address(i), (uint8_t *)chunk, len);
+      yield();
+    }
+  }
+
+  nvHeader.nvLogFirst = 0;
+  nvHeader.nvLogLast = n;
+  nvHeader.nvLogMax = max;
+  nvHeader.generation++;
+}
@@ -0,0 +1,122 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+/*
+ * History in LittleFS for units without FRAM.  Records are collected in RAM
+ * and appended a page at a time to limit flash wear and the time spent
+ * writing.  When the current file is full it replaces the previous one.
+ */
+
+bool
+FsLog::begin(void)
+{
+  File f;
+
+  if ((f = LittleFS.open(FSLOG_PREVIOUS, "r"))) {
+    previous = f.size() / sizeof(struct nvLog);
+    f.close();
+  }
+  if ((f = LittleFS.open(FSLOG_CURRENT, "r"))) {
+    current = f.size() / sizeof(struct nvLog);
+    f.close();
+  }
+  return true;
+}
+
+bool
+FsLog::append(const struct nvLog *log)
+{
+  page[pending++] = *log;
+  if (pending == FSLOG_PAGE)
+    flush();
+  return true;
+}
+
+void
+FsLog::flush(void)
+{
+  File f;
+
+  if (!pending)
+    return;
+
+  if (reader) {
+    reader.close();
+    readerPath = NULL;
+  }
+  // Overwrite any partial record left by a power loss during a write.
+  if (!(f = LittleFS.open(FSLOG_CURRENT, "r+")))
+    f = LittleFS.open(FSLOG_CURRENT, "w");
+  if (f) {
+    f.seek(current * sizeof(struct nvLog));
+    f.write((uint8_t *)page, pending * sizeof(struct nvLog));
+    f.close();
+  }
+  current += pending;
+  pending = 0;
+
+  if (current >= FSLOG_FILE) {
+    LittleFS.remove(FSLOG_PREVIOUS);
+    LittleFS.rename(FSLOG_CURRENT, FSLOG_PREVIOUS);
+    previous = current;
+    current = 0;
+  }
+}
+
+bool
+FsLog::read(uint32_t i, struct nvLog *log)
+{
+  const char *path = FSLOG_PREVIOUS;
+
+  if (i >= previous + current) {
+    if (i >= count())
+      return false;
+    *log = page[i - previous - current];
+    return true;
+  }
+  if (i >= previous) {
+    i -= previous;
+    path = FSLOG_CURRENT;
+  }
+
+  if (readerPath != path) {
+    if (reader)
+      reader.close();
+    reader = LittleFS.open(path, "r");
+    readerPath = path;
+  }
+  return reader && reader.seek(i * sizeof(struct nvLog)) &&
+    reader.read((uint8_t *)log, sizeof(struct nvLog)) == sizeof(struct nvLog);
+}
@@ -0,0 +1,254 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <FastCRC.h>
+#include <stdint.h>
+
+#include "gzip.h"
+
+#define MIN_MATCH   3
+#define MAX_MATCH   258
+
+static const uint16_t lengthBase[] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distBase[] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073
+};
+static const uint8_t distExtra[] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10
+};
+
+static inline uint16_t
+hash(const uint8_t *p)
+{
+  return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+Gzip::Gzip(Print &to) : dest(to)
+{
+}
+
+void
+Gzip::begin(void)
+{
+  static const uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+
+  memset(head, 0, sizeof(head));
+  in = out = 0;
+  crc = bitBuf = 0;
+  bitCount = 0;
+  pos = fill = obytes = 0;
+  for (uint8_t b : header)
+    put(b);
+}
+
+size_t
+Gzip::write(const uint8_t *data, size_t len)
+{
+  size_t left = len;
+
+  if (!len)
+    return 0;
+  crc = in ? CRC32.crc32_upd(data, len) : CRC32.crc32(data, len);
+  in += len;
+  while (left) {
+    size_t n = min(left, sizeof(win) - fill);
+
+    memcpy(win + fill, data, n);
+    fill += n;
+    data += n;
+    left -= n;
+    if (fill == sizeof(win))
+      deflate(false);
+  }
+  return len;
+}
+
+// The final block, then the CRC and length of the input.
+void
+Gzip::end(void)
+{
+  deflate(true);
+  if (bitCount)
+    put(bitBuf);
+  bitBuf = bitCount = 0;
+  for (uint8_t i = 0; i < 32; i += 8)
+    put(crc >> i);
+  for (uint8_t i = 0; i < 32; i += 8)
+    put(in >> i);
+  flush();
+}
+
+/*
+ * Compress what is buffered as one fixed code block.  Matches are greedy
+ * against the most recent position with the same hash, then the upper half
+ * slides down to become the history for the next block.
+ */
+void
+Gzip::deflate(bool last)
+{
+  bits(last ? 3 : 2, 3);          // BFINAL, then BTYPE 01.
+  while (pos < fill) {
+    uint16_t  len = 0, cand = 0;
+
+    if (fill - pos >= MIN_MATCH) {
+      uint16_t  h = hash(win + pos);
+      uint16_t  limit = min(fill - pos, MAX_MATCH);
+
+      cand = head[h];
+      head[h] = pos + 1;
+      if (cand--)
+        while (len < limit && win[cand + len] == win[pos + len])
+          len++;
+    }
+    if (len >= MIN_MATCH) {
+      match(len, pos - cand);
+      // Index the covered positions too, they are the likeliest matches.
+      for (uint16_t p = pos + 1; p < pos + len && fill - p >= MIN_MATCH; p++)
+        head[hash(win + p)] = p + 1;
+      pos += len;
+    } else
+      symbol(win[pos++]);
+  }
+  symbol(256);
+
+  if (fill > GZIP_WINDOW) {
+    uint16_t shift = fill - GZIP_WINDOW;
+
+    memmove(win, win + shift, GZIP_WINDOW);
+    for (uint16_t &h : head)
+      h = h > shift ? h - shift : 0;
+    pos -= shift;
+    fill -= shift;
+  }
+}
+
+void
+Gzip::bits(uint32_t v, uint8_t n)
+{
+  bitBuf |= v << bitCount;
+  bitCount += n;
+  while (bitCount >= 8) {
+    put(bitBuf);
+    bitBuf >>= 8;
+    bitCount -= 8;
+  }
+}
+
+// Huffman codes go most significant bit first.
+void
+Gzip::code(uint16_t c, uint8_t n)
+{
+  uint16_t r = 0;
+
+  for (uint8_t i = 0; i < n; i++, c >>= 1)
+    r = r << 1 | (c & 1);
+  bits(r, n);
+}
+
+void
+Gzip::symbol(uint16_t s)
+{
+  if (s < 144)
+    code(0x30 + s, 8);
+  else if (s < 256)
+    code(0x190 + s - 144, 9);
+  else if (s < 280)
+    code(s - 256, 7);
+  else
+    code(0xc0 + s - 280, 8);
+}
+
+void
+Gzip::match(uint16_t len, uint16_t dist)
+{
+  uint8_t i;
+
+  for (i = sizeof(lengthBase) / sizeof(lengthBase[0]) - 1; lengthBase[i] > len; i--)
+    ;
+  symbol(257 + i);
+  bits(len - lengthBase[i], lengthExtra[i]);
+  for (i = sizeof(distBase) / sizeof(distBase[0]) - 1; distBase[i] > dist; i--)
+    ;
+  code(i, 5);
+  bits(dist - distBase[i], distExtra[i]);
+}
+
+void
+Gzip::put(uint8_t b)
+{
+  obuf[obytes++] = b;
+  out++;
+  if (obytes == sizeof(obuf))
+    flush();
+}
+
+void
+Gzip::flush(void)
+{
+  if (obytes)
+    dest.write(obuf, obytes);
+  obytes = 0;
+}
+
+// True when gzip is acceptable: listed, or covered by "*", and not q=0.
+bool
+gzipAccepted(const char *h)
+{
+  int8_t  gzip = -1, any = -1;
+
+  while (*h) {
+    const char *t;
+    size_t      n;
+    float       q = 1;
+
+    h += strspn(h, " ,");
+    t = h;
+    n = strcspn(h, " ;,");
+    h += n;
+    while (*h && *h != ',') {
+      h += strspn(h, " ;");
+      if ((*h == 'q' || *h == 'Q') && h[1] == '=')
+        q = strtof(h + 2, NULL);
+      h += strcspn(h, ";,");
+    }
+    if (n == 4 && !strncasecmp(t, "gzip", 4))
+      gzip = q > 0;
+    else if (n == 1 && *t == '*')
+      any = q > 0;
+  }
+  return gzip >= 0 ? gzip : any > 0;
+}
@@ -0,0 +1,141 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cse7759b.h"
+#include "nvdata.h"
+#include "states.h"
+#include "timefmt.h"
+#include "influx.h"
+
+extern uint8_t          state;
+
+struct influxStats      influxStats;
+static WiFiUDP          udp;
+static IPAddress        server;               // Collector, unset until resolved.
+static char             buf[INFLUX_BYTES];
+static char             prefix[STR32 + 16];   // "s31,host=<hostname> power="
+static uint8_t          prefixLen;
+static uint16_t         len;                  // Bytes in buf.
+static uint8_t          lines;                // Samples in buf.
+static uint32_t         seq = 0;              // Runs on across config changes.
+
+/*
+ * Timestamps are whole seconds, the collector's UDP listener needs
+ * precision = "s".  Each datagram opens with a comment line carrying a
+ * sequence number, which line protocol ignores but lets a collector count
+ * lost datagrams.
+ */
+static void
+batchStart(void)
+{
+  char *p = buf;
+
+  memcpy(p, "# seq=", 6);
+  p = fmtFixed(p + 6, seq++, 0);
+  *p++ = '\n';
+  len = p - buf;
+  lines = 0;
+}
+
+// The collector is looked up once, not for every datagram.
+static bool
+resolve(void)
+{
+  if (!server.isSet() && (~state & STATE_GOT_IP_ADDRESS ||
+      WiFi.hostByName(cfg.influxHost, server, INFLUX_DNS) != 1))
+    server = IPAddress();
+  return server.isSet();
+}
+
+static void
+batchSend(void)
+{
+  if (resolve() && udp.beginPacket(server, cfg.influxPort ? cfg.influxPort : INFLUX_PORT) &&
+      udp.write((const uint8_t *)buf, len) == len && udp.endPacket()) {
+    influxStats.datagrams++;
+    influxStats.lines += lines;
+  }
+  else {
+    influxStats.errors++;
+    influxStats.dropped += lines;
+  }
+  batchStart();
+}
+
+void
+influxBegin(void)
+{
+  // Tag values escape spaces, commas and equals signs.
+  prefixLen = snprintf(prefix, sizeof(prefix), "s31,host=");
+  for (const char *s = cfg.hostname; *s && prefixLen < sizeof(prefix) - 8; s++) {
+    if (*s == ' ' || *s == ',' || *s == '=')
+      prefix[prefixLen++] = '\\';
+    prefix[prefixLen++] = *s;
+  }
+  memcpy(prefix + prefixLen, " power=", 7);
+  prefixLen += 7;
+  server = IPAddress();
+  if (cfg.influxHost[0])
+    resolve();
+  // Lines already queued go to the new collector, the sequence carries on.
+  if (!len)
+    batchStart();
+}
+
+/*
+ * Called with each averaged log sample.  Only the power, energy and time
+ * are formatted per line; the rest is copied from the rendered prefix.
+ */
+void
+influxAdd(const struct nvLog *log)
+{
+  char *p;
+
+  if (!cfg.influxHost[0])
+    return;
+  if (len + prefixLen + 48 > INFLUX_BYTES)
+    batchSend();
+
+  p = buf + len;
+  memcpy(p, prefix, prefixLen);
+  p = fmtFixed(p + prefixLen, log->power, 1);
+  memcpy(p, ",energy=", 8);
+  p = fmtFixed(p + 8, energy, 6);
+  *p++ = ' ';
+  p = fmtFixed(p, log->time, 0);
+  *p++ = '\n';
+  len = p - buf;
+
+  if (++lines >= (cfg.influxBatch ? cfg.influxBatch : INFLUX_BATCH))
+    batchSend();
+}
@@ -0,0 +1,94 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+LogStore *logStore = NULL;
+
+bool
+LogStore::add(const struct nvLog *log)
+{
+  uint32_t  start = micros(), elapsed;
+  bool      ok;
+
+  ok = append(log);
+  elapsed = micros() - start;
+  appends++;
+  appendTotal += elapsed;
+  appendMax = max(appendMax, elapsed);
+  return ok;
+}
+
+// Index of the oldest record logged after 'since', records are in time order.
+uint32_t
+LogStore::since(time_t since)
+{
+  struct nvLog  log;
+  uint32_t      lo = 0, hi = count();
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+
+    if (read(mid, &log) && log.time > since)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+// The ETag changes whenever a record is appended.
+void
+LogStore::etag(char *buf, size_t len)
+{
+  struct nvLog  log = { 0, 0 };
+  uint32_t      n = count();
+
+  if (n)
+    read(n - 1, &log);
+  snprintf(buf, len, "\"%c%llx-%x\"", *name(), (long long)log.time, (unsigned)n);
+}
+
+// Read every record, returns the elapsed microseconds.
+uint32_t
+LogStore::scan(void)
+{
+  struct nvLog  log;
+  uint32_t      start = micros(), n = count();
+
+  for (uint32_t i = 0; i < n; i++) {
+    read(i, &log);
+    if (i % 256 == 255)
+      yield();
+  }
+  return micros() - start;
+}
@@ -0,0 +1,163 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "lttb.h"
+
+Lttb::Lttb(lttbEmit emit, void *ctx)
+{
+  this->emit = emit;
+  this->ctx = ctx;
+  buf = NULL;
+}
+
+Lttb::~Lttb()
+{
+  free(buf);
+}
+
+/*
+ * Prepare to reduce 'records' input records to about 'points' output points.
+ * The point count is raised if a bucket would not fit in the buffer; each
+ * record may contribute two points (a deadband hold row and the record).
+ * Requires points < records.  Returns the point count used or 0 on
+ * allocation failure.
+ */
+uint16_t
+Lttb::begin(uint32_t records, uint16_t points)
+{
+  uint16_t  per = LTTB_BUCKET_MAX / 2;
+
+  if (points < 3)
+    points = 3;
+  if ((uint32_t)(points - 2) * per < records - 2)
+    points = min((uint32_t)UINT16_MAX, 2 + (records - 2 + per - 1) / per);
+
+  buf = (struct lttbPoint *)malloc(2 * LTTB_BUCKET_MAX * sizeof(struct lttbPoint));
+  if (!buf)
+    return 0;
+  cur = buf;
+  next = buf + LTTB_BUCKET_MAX;
+
+  this->records = records;
+  this->points = points;
+  nCur = nNext = 0;
+  bCur = bNext = -1;
+  started = false;
+  return points;
+}
+
+int
+Lttb::bucketOf(int32_t record)
+{
+  if (record <= 0)
+    return 0;
+  if ((uint32_t)record >= records - 1)
+    return points - 1;
+  return 1 + (int64_t)(record - 1) * (points - 2) / (records - 2);
+}
+
+// Emit the point of the current bucket with the largest triangle area.
+void
+Lttb::select(void)
+{
+  float     cx = 0, cy = 0, best = -1;
+  uint16_t  pick = 0;
+
+  for (uint16_t i = 0; i < nNext; i++) {
+    cx += next[i].t - anchor.t;
+    cy += next[i].p;
+  }
+  cx /= nNext;
+  cy /= nNext;
+
+  for (uint16_t i = 0; i < nCur; i++) {
+    float bx = cur[i].t - anchor.t;
+    float area = fabsf(-cx * (cur[i].p - anchor.p) + bx * (cy - anchor.p));
+
+    if (area > best) {
+      best = area;
+      pick = i;
+    }
+  }
+  anchor = cur[pick];
+  emit(ctx, anchor.t, anchor.p);
+}
+
+/*
+ * Add a point belonging to input record 'record'.  A deadband hold row
+ * shows the previous record's value so it is added as record - 1.
+ */
+void
+Lttb::add(int32_t record, time_t t, float p)
+{
+  int b = bucketOf(record);
+
+  if (b == 0) {
+    if (!started) {
+      anchor = { t, p };
+      emit(ctx, t, p);
+      started = true;
+    }
+    return;
+  }
+
+  if (bCur < 0)
+    bCur = b;
+  if (b == bCur) {
+    if (nCur < LTTB_BUCKET_MAX)
+      cur[nCur++] = { t, p };
+    return;
+  }
+
+  if (bNext >= 0 && b != bNext) {
+    struct lttbPoint *swap = cur;
+
+    select();
+    cur = next;
+    nCur = nNext;
+    bCur = bNext;
+    next = swap;
+    nNext = 0;
+  }
+  bNext = b;
+  if (nNext < LTTB_BUCKET_MAX)
+    next[nNext++] = { t, p };
+}
+
+void
+Lttb::end(void)
+{
+  if (nCur && nNext)
+    select();
+  else if (nCur)
+    next[nNext++] = cur[nCur - 1];
+  if (nNext)
+    emit(ctx, next[nNext - 1].t, next[nNext - 1].p);
+}
@@ -29,50 +29,131 @@
 #include <Arduino.h>
 #include <ArduinoOTA.h>
 #include <coredecls.h>
-#include <EEPROM.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266WebServer.h>
 #include <ESP8266WiFi.h>
 #include <FastCRC.h>
 #include <FRAM.h>
 #include <LittleFS.h>
-#include <SimpleTimer.h>
+#include <new>
 #include <stdint.h>
 #include <sys/time.h>
 #include <WiFiClient.h>
 
+#include "advert.h"
+#include "assets.h"
+#include "cfgstore.h"
+#include "checkpoint.h"
 #include "cse7759b.h"
 #include "config.h"
+#include "demand.h"
+#include "form.h"
+#include "gzip.h"
+#include "influx.h"
+#include "lttb.h"
+#include "mqtt.h"
 #include "nvdata.h"
+#include "configform.h"
+#include "page.h"
+#include "logstore.h"
+#include "memstat.h"
+#include "protect.h"
+#include "rootpage.h"
+#include "scheduler.h"
 #include "states.h"
+#include "tariff.h"
+#include "timefmt.h"
+#include "udpctl.h"
+#include "wlan.h"
 
-#define NAME      "S31"
 #define VERSION   1.0
-#define SIGNATURE 0x1a2b3b4e
-#define NVVERSION 1
+#define SIGNATURE 0x1a2b3b56
+#define NVVERSION 7
 
 struct config   cfg;
 struct nvHeader nvHeader;
 extern double   ave_power;      //cse7766.cpp
-extern uint8_t  ave_count;      //cse7766.cpp
+extern uint16_t ave_count;      //cse7766.cpp
 extern uint32_t ovflow;         //cse7766.cpp
 extern uint16_t restoredPulses; //cse7766.cpp
 
+/*
+ * Older config layouts are a prefix of the current one.  Members added since
+ * are zeroed on migration which leaves the new features disabled.
+ */
+static const struct {
+  uint32_t  signature;
+  uint16_t  size;
+} cfgLayouts[] = {
+  { 0x1a2b3b4e, offsetof(struct config, tariff) },
+  { 0x1a2b3b4f, offsetof(struct config, logDeadbandW) },
+  { 0x1a2b3b50, offsetof(struct config, brownoutV) },
+  { 0x1a2b3b51, offsetof(struct config, tripA) },
+  { 0x1a2b3b52, offsetof(struct config, demandMin) },
+  { 0x1a2b3b53, offsetof(struct config, udpKey) },
+  { 0x1a2b3b54, offsetof(struct config, mqttHost) },
+  { 0x1a2b3b55, offsetof(struct config, influxHost) },
+};
+
+/*
+ * The version 3 header with 16 bit ring indices for a 32KB part.  Versions 1
+ * and 2 are prefixes of it with the CRC following.
+ */
+struct nvHeaderV3 {
+  uint8_t   version;
+  uint8_t   state;
+  uint16_t  nvLogFirst;
+  uint16_t  nvLogLast;
+  uint32_t  ovflow;
+  uint16_t  pulses;
+  uint16_t  restoredPulses;
+  uint64_t  tariffPulses[TARIFF_BANDS];
+  uint16_t  generation;
+  uint16_t  crc;
+} __attribute__((__packed__));
+
+static const uint8_t nvHeaderV3Size[4] = {
+  0,
+  offsetof(struct nvHeaderV3, tariffPulses) + 2,
+  offsetof(struct nvHeaderV3, generation) + 2,
+  sizeof(struct nvHeaderV3),
+};
+
+// Header size by version from 4, members are only added immediately before the CRC.
+static const uint8_t nvHeaderSize[NVVERSION + 1] = {
+  0, 0, 0, 0,
+  offsetof(struct nvHeader, boots) + 2,
+  offsetof(struct nvHeader, trip) + 2,
+  offsetof(struct nvHeader, mqttSent) + 2,
+  sizeof(struct nvHeader),
+};
+
 #define BUTTON_PERIOD   100
 #define BUTTON_TIMEOUT  10
 void ntpCallBack(void);
 void resetConfig(void);
+bool migrateConfig(void);
+bool setRelay(bool on);
 void checkSchedule(void);
 void APModeLED(void);
 void buttonCheck(void);
 void nvInit(void);
+bool nvUpgradeV3(void);
+uint32_t nvSize(void);
 void saveNvHeader(void);
-void saveNvLog(void);
+void saveLog(void);
+uint16_t logHeartbeat(void);
+bool logDeadband(time_t t, float p);
+void configApply(bool reconnect);
 
 void handleConfig(void);
-void handleDygraphCSS(void);
-void handleDygraphJS(void);
-void handleFavIcon(void);
+void handleConfigBody(void);
+void handleConfigGet(void);
+void handleConfigPut(void);
+void handleInfluxStats(void);
+void handleLogStats(void);
+void handleMqttStats(void);
+void handleWlanStats(void);
 void handleNvData(void);
 void handleOff(void);
 void handleOn(void);
@@ -80,13 +161,20 @@ void handlePowerCycle(void);
 void handleReboot(void);
 void handleRoot(void);
 void handleSave(void);
+void handleSaveBody(void);
 void handleSchedule(void);
 void handleScheduleSave(void);
-
-FRAM                fram;
+void handleScheduleSaveBody(void);
+void handleStatus(void);
+void handleTariff(void);
+void handleTariffReset(void);
+void handleTariffSave(void);
+void handleTariffSaveBody(void);
+void handleTripReset(void);
+
+FRAM32              fram;
 ESP8266WebServer    web(80);
-WiFiEventHandler	  eventConnected, eventDisconnected, eventGotIP;
-static SimpleTimer  timer;
+Scheduler           timer;
 const char         *daysOfWeek[7] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
 
 time_t  bootTime = 0;
@@ -99,19 +187,13 @@ uint8_t state;
 void
 setup(void)
 {
-  const char * headerkeys[] = {"Accept-Encoding"} ;
+  const char * headerkeys[] = {"Accept-Encoding", "If-None-Match", "Range", "If-Range"} ;
+  bool         mounted;
 
   state = 0;
-  EEPROM.begin(sizeof(cfg));
-  EEPROM.get(0, cfg);
-  if (cfg.signature != SIGNATURE)
-    resetConfig();
-  //memset(&cfg.schedule, '\0', sizeof(struct schedule) * 7);
-  //EEPROM.put(0, cfg);
-  //EEPROM.commit();
-  state |= (cfg.flags & CFG_RELAY_ON_BOOT ? STATE_RELAY : 0);
+  memBegin();
   pinMode(RELAY, OUTPUT);
-  digitalWrite(RELAY, state & STATE_RELAY);
+  digitalWrite(RELAY, LOW);
   pinMode(LED, OUTPUT);
   pinMode(BUTTON, INPUT_PULLUP);
 
@@ -122,30 +204,53 @@ setup(void)
   if (fram.begin(0x50) == FRAM_OK) {
 		state |= STATE_FRAM_PRESENT;
     nvInit();
+    // Restore the meter pulses on power-cycle
+    if (ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST)
+      checkpointRestore();
     ovflow = nvHeader.ovflow;
     restoredPulses = nvHeader.restoredPulses;
-    // Restore the meter pulses on power-cycle
     if (ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST) {
       restoredPulses = nvHeader.restoredPulses + nvHeader.pulses;
       if (restoredPulses < nvHeader.restoredPulses)
         nvHeader.ovflow = ++ovflow;
       nvHeader.restoredPulses = restoredPulses;
     }
+    nvHeader.boots++;
+    saveNvHeader();
 	}
 
-  eventGotIP = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP& event) {
-    state |= STATE_GOT_IP_ADDRESS;
-  });
-  eventConnected = WiFi.onStationModeConnected([](const WiFiEventStationModeConnected& event) {
-  });
-  eventDisconnected = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected& event)
-  {
-    state &= ~STATE_GOT_IP_ADDRESS;
-    if (~state & STATE_OTA_OR_REBOOT && *cfg.ssid && *cfg.psk) {
-      WiFi.begin(cfg.ssid, cfg.psk);
+  // The config lives in FRAM if fitted, so it is read once the part is sized.
+  mounted = LittleFS.begin();
+  if (!cfgLoad(mounted) && cfg.signature == SIGNATURE)
+    saveConfig();
+  if (cfg.signature != SIGNATURE && !migrateConfig())
+    resetConfig();
+  protectBegin();
+  setRelay(cfg.flags & CFG_RELAY_ON_BOOT);
+
+  // History goes to FRAM if fitted, otherwise LittleFS if enabled or RAM.
+  if (state & STATE_FRAM_PRESENT)
+    logStore = new FramLog;
+  else {
+    FSInfo  info;
+
+    if (cfg.flags & CFG_FSLOG && LittleFS.info(info) &&
+        info.totalBytes - info.usedBytes > 3 * FSLOG_FILE * sizeof(struct nvLog)) {
+      FsLog *fs = new FsLog;
+
+      if (fs->begin())
+        logStore = fs;
     }
-  });
-  LittleFS.begin();
+    if (!logStore) {
+      RamLog *ram = new RamLog;
+
+      if (ram->begin())
+        logStore = ram;
+      else
+        delete ram;
+    }
+  }
+
   // Serial  - TX = GPIO1, RX = GPIO3 [CSE7766 and RX/TX]
   // Serial1 - TX = GPIO2, RX = GPIO8 Unused
   Serial.flush();
@@ -160,14 +265,17 @@ setup(void)
   // ArduinoOTA.setPassword(F("admin"))
   ArduinoOTA.onStart([]() {
     state |= STATE_OTA_OR_REBOOT;
+    if (logStore)
+      logStore->flush();
+    if (state & STATE_FRAM_PRESENT)
+      saveNvHeader();
     switch (ArduinoOTA.getCommand()) {
       case U_FLASH:
     	break;
       case U_FS:
+        assetEnd();
         LittleFS.end();
     	break;
-      if (state & STATE_FRAM_PRESENT)
-        saveNvHeader();
     }
   });
   ArduinoOTA.onEnd([]() {
@@ -211,23 +319,36 @@ setup(void)
   });
   web.on("/config", handleConfig);
   web.on("/data.txt", handleNvData);
-  web.on("/dygraph.css", handleDygraphCSS);
-  web.on("/dygraph.min.js", handleDygraphJS);
-  web.on("/favicon.ico", handleFavIcon);
+  web.on("/debug/influx", handleInfluxStats);
+  web.on("/debug/log", handleLogStats);
+  web.on("/debug/mem", handleMemStats);
+  web.on("/debug/mqtt", handleMqttStats);
+  web.on("/debug/wifi", handleWlanStats);
   web.on("/", handleRoot);
   web.on("/off", handleOff);
   web.on("/on", handleOn);
   web.on("/powercycle", handlePowerCycle);
   web.on("/reboot", handleReboot);
-  web.on("/save", handleSave);
+  web.on("/save", HTTP_POST, handleSave, handleSaveBody);
   web.on("/schedule", handleSchedule);
-  web.on("/schedulesave", handleScheduleSave);
-  web.collectHeaders(headerkeys, (size_t)1);
-
+  web.on("/schedulesave", HTTP_POST, handleScheduleSave, handleScheduleSaveBody);
+  web.on("/tariff", handleTariff);
+  web.on("/tariffreset", handleTariffReset);
+  web.on("/tariffsave", HTTP_POST, handleTariffSave, handleTariffSaveBody);
+  web.on("/tripreset", handleTripReset);
+  web.on("/api/v1/status", handleStatus);
+  web.on("/api/v1/config", HTTP_GET, handleConfigGet);
+  web.on("/api/v1/config", HTTP_PUT, handleConfigPut, handleConfigBody);
+  assetBegin();
+  web.collectHeaders(headerkeys, sizeof(headerkeys) / sizeof(headerkeys[0]));
+
+  // The config holds the credentials, the SDK's copy in flash isn't needed.
+  WiFi.persistent(false);
   WiFi.mode(WIFI_STA);
-  WiFi.hostname(cfg.hostname);
-  WiFi.begin(cfg.ssid, cfg.psk);
+  WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+  wlanBegin();
   MDNS.begin(cfg.hostname);
+  advertBegin();
 
   if (cfg.ntpserver[0])
     configTzTime(cfg.timezone, cfg.ntpserver);
@@ -242,35 +363,74 @@ setup(void)
     delay(300);
   }
 
-  if (WiFi.status() != WL_CONNECTED) {
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP(NAME, "");
-  }
-
   // Start a timer for checking button presses @ 100ms intervals.
   timer.setInterval(BUTTON_PERIOD, buttonCheck);
-  timer.setInterval(1000, readCse7759b);
   timer.setInterval(1000, APModeLED);
   timer.setInterval(1000, checkSchedule);
+  timer.setInterval(1000, demandUpdate);
+  timer.setInterval(1000, advertUpdate);
+  timer.setInterval(1000, memSample);
   if (state & STATE_FRAM_PRESENT) {
     timer.setInterval(5000, saveNvHeader);
-    timer.setInterval(10000, saveNvLog);
   }
+  else
+    timer.setInterval(1000, protectSave);
+  if (logStore)
+    timer.setInterval(logStore->period() * 1000, saveLog);
 
   // Switch LED on to signal initialization complete.
   digitalWrite(LED, LOW);
 
   ArduinoOTA.begin();
   web.begin();
+  udpBegin();
+  mqttBegin();
+  influxBegin();
 }
 
 void
 loop(void)
 {
+  uint32_t allocs;
+
+  // Frames every 50ms, read first so a sag is checkpointed without delay.
+  readCse7759b();
+  udpHandle();
+  wlanHandle();
   timer.run();
+  mqttHandle();
   ArduinoOTA.handle();
+  MDNS.update();
+  allocs = memAllocs;
   web.handleClient();
+  if (memAllocs != allocs)
+    memRequest(web.uri().c_str(), memAllocs - allocs);
   state &= ~STATE_OTA_OR_REBOOT;
+
+  // Sleep until the next deadline or frame, unless a request is under way.
+  timer.idle(web.client().connected() ? 0 : min(timer.next(), cseNext()));
+}
+
+/*
+ * All relay changes go through here so that a latched trip holds it open and
+ * the inrush grace starts whenever it closes.  While the demand limiter has
+ * shed the load a change only sets the state it is restored to.
+ */
+bool
+setRelay(bool on)
+{
+  if (on && protectReason)
+    return false;
+  if (state & STATE_SHED) {
+    demandWanted = on;
+    if (on)
+      return false;
+  }
+  if (on && ~state & STATE_RELAY)
+    protectArm();
+  digitalWrite(RELAY, on ? HIGH : LOW);
+  state = on ? state | STATE_RELAY : state & ~STATE_RELAY;
+  return true;
 }
 
 void
@@ -287,8 +447,7 @@ buttonCheck(void)
     count = 0;
 
   if (!button && state & STATE_DEBOUNCE_TIMEOUT) {
-    state = (state & ~STATE_RELAY) | (~state & STATE_RELAY);
-    digitalWrite(RELAY, state & STATE_RELAY);
+    setRelay(~state & STATE_RELAY);
     state &= ~STATE_DEBOUNCE_TIMEOUT;
     delay(50);
   }
@@ -325,19 +484,17 @@ checkSchedule(void)
   }
 
   if (~state & STATE_RELAY && cfg.schedule[wday].flags & SCHED_ON_ENABLED && tm_on.tm_hour == cfg.schedule[wday].h_on && tm_on.tm_min == cfg.schedule[wday].m_on) {
-    digitalWrite(RELAY, HIGH);
-    state |= STATE_RELAY;
+    setRelay(true);
   }
   else if (state & STATE_RELAY && cfg.schedule[wday].flags & SCHED_OFF_ENABLED && tm_off->tm_hour == cfg.schedule[wday].h_off && tm_off->tm_min == cfg.schedule[wday].m_off) {
-    digitalWrite(RELAY, LOW);
-    state &= ~STATE_RELAY;
+    setRelay(false);
   }
 }
 
 void
 APModeLED(void)
 {
-  if (WiFi.getMode() == WIFI_AP)
+  if (WiFi.getMode() & WIFI_AP)
     digitalWrite(LED, !digitalRead(LED));
 }
 
@@ -350,6 +507,7 @@ ntpCallBack(void)
   }
 
   state |= STATE_NTP_GOT_TIME;
+  tariffUpdate();
 }
 
 void
@@ -365,25 +523,116 @@ resetConfig(void)
   strcpy(cfg.timezone, "EST5EDT,M3.2.0,M11.1.0");
   cfg.calibration = {1.01, 0.995, 1.00};
   cfg.signature = SIGNATURE;
-  EEPROM.put(0, cfg);
-  EEPROM.commit();
+  saveConfig();
   ESP.restart();
 }
 
+bool
+migrateConfig(void)
+{
+  for (uint8_t i = 0; i < sizeof(cfgLayouts) / sizeof(cfgLayouts[0]); i++) {
+    if (cfg.signature != cfgLayouts[i].signature)
+      continue;
+    memset((uint8_t *)&cfg + cfgLayouts[i].size, '\0', sizeof(struct config) - cfgLayouts[i].size);
+    cfg.signature = SIGNATURE;
+    saveConfig();
+    return true;
+  }
+  return false;
+}
+
 void
 nvInit(void)
 {
   FastCRC16	  CRC16;
   uint16_t    crc;
-
-  fram.read(0, (uint8_t *)&nvHeader, sizeof(nvHeader));
+  uint32_t    size = nvSize(), max;
+  bool        upgraded = false;
+
+  fram.read(NV_HEADER_OFFSET, (uint8_t *)&nvHeader, sizeof(nvHeader));
+  if (nvHeader.version > 0 && nvHeader.version < 4)
+    upgraded = nvUpgradeV3();
+  else if (nvHeader.version >= 4 && nvHeader.version < NVVERSION) {
+    uint8_t len = nvHeaderSize[nvHeader.version];
+
+    memcpy(&crc, (uint8_t *)&nvHeader + len - 2, 2);
+    if (crc == CRC16.ccitt((uint8_t *)&nvHeader, len - 2)) {
+      memset((uint8_t *)&nvHeader + len - 2, '\0', sizeof(struct nvHeader) - len + 2);
+      nvHeader.version = NVVERSION;
+      upgraded = true;
+    }
+  }
   crc = CRC16.ccitt((uint8_t *)&nvHeader, sizeof(struct nvHeader) - 2);
-  if (nvHeader.version != NVVERSION || nvHeader.crc != crc) {
+  if (!upgraded && (nvHeader.version != NVVERSION || nvHeader.crc != crc)) {
     memset(&nvHeader, '\0', sizeof(struct nvHeader));
     nvHeader.version = NVVERSION;
-    nvHeader.crc = crc;
-    saveNvHeader();
   }
+
+  // Lay the log out again if a different size part has been fitted.
+  max = (size - NV_LOG_OFFSET - 2 * CFG_SLOT) / sizeof(struct nvLog);
+  if (nvHeader.nvLogMax != max)
+    framLogResize(max);
+  nvHeader.size = size;
+  saveNvHeader();
+}
+
+bool
+nvUpgradeV3(void)
+{
+  FastCRC16	        CRC16;
+  struct nvHeaderV3 old;
+  uint8_t           len;
+  uint16_t          crc;
+
+  fram.read(NV_HEADER_OFFSET, (uint8_t *)&old, sizeof(old));
+  len = nvHeaderV3Size[old.version];
+  memcpy(&crc, (uint8_t *)&old + len - 2, 2);
+  if (crc != CRC16.ccitt((uint8_t *)&old, len - 2))
+    return false;
+  memset((uint8_t *)&old + len - 2, '\0', sizeof(old) - len + 2);
+
+  memset(&nvHeader, '\0', sizeof(struct nvHeader));
+  nvHeader.version = NVVERSION;
+  nvHeader.state = old.state;
+  nvHeader.generation = old.generation;
+  nvHeader.nvLogFirst = old.nvLogFirst;
+  nvHeader.nvLogLast = old.nvLogLast;
+  nvHeader.nvLogMax = (32768 - NV_LOG_OFFSET) / sizeof(struct nvLog);
+  nvHeader.size = 32768;
+  nvHeader.ovflow = old.ovflow;
+  nvHeader.pulses = old.pulses;
+  nvHeader.restoredPulses = old.restoredPulses;
+  memcpy(nvHeader.tariffPulses, old.tariffPulses, sizeof(nvHeader.tariffPulses));
+  return true;
+}
+
+/*
+ * Find the FRAM size by writing past the end of each candidate size: a
+ * smaller part wraps the write around onto the probe byte below it, and a
+ * missing part doesn't hold the value.  The probe byte is spare space at the
+ * end of the header block.
+ */
+uint32_t
+nvSize(void)
+{
+  const uint32_t  probe = NV_LOG_OFFSET - 1;
+  uint32_t        size;
+  uint8_t         save = fram.read8(probe);
+
+  for (size = NV_SIZE_MIN; size < NV_SIZE_MAX; size <<= 1) {
+    uint8_t saved = fram.read8(probe + size);
+    uint8_t mark = save ^ 0xa5;
+
+    fram.write8(probe + size, mark);
+    if (fram.read8(probe) == mark) {
+      fram.write8(probe, save);
+      break;
+    }
+    if (fram.read8(probe + size) != mark)
+      break;
+    fram.write8(probe + size, saved);
+  }
+  return size;
 }
 
 void
@@ -395,8 +644,38 @@ saveNvHeader(void)
   fram.write(NV_HEADER_OFFSET, (uint8_t *)&nvHeader, sizeof(nvHeader));
 }
 
+uint16_t
+logHeartbeat(void)
+{
+  return cfg.logHeartbeat ? cfg.logHeartbeat : NV_LOG_HEARTBEAT;
+}
+
+/*
+ * In deadband mode a sample is only logged when it leaves the band around the
+ * last logged value, or when the heartbeat interval has elapsed.  Readers hold
+ * the previous value across the gap.
+ */
+bool
+logDeadband(time_t t, float p)
+{
+  static time_t lastTime = 0;
+  static float  lastPower;
+  float         band;
+
+  if (~cfg.flags & CFG_LOG_DEADBAND)
+    return false;
+
+  band = max(cfg.logDeadbandW, fabsf(lastPower) * cfg.logDeadbandPct / 100);
+  if (lastTime && t - lastTime < logHeartbeat() && fabsf(p - lastPower) <= band)
+    return true;
+
+  lastTime = t;
+  lastPower = p;
+  return false;
+}
+
 void
-saveNvLog(void)
+saveLog(void)
 {
   struct nvLog    nvLog;
 
@@ -408,14 +687,10 @@ saveNvLog(void)
       nvLog.power = power;
     ave_power = power;
     ave_count = 1;
-    fram.write(NV_LOG_OFFSET + nvHeader.nvLogLast * sizeof(struct nvLog), (uint8_t *)&nvLog, sizeof(struct nvLog));
-    nvHeader.nvLogLast++;
-    nvHeader.nvLogLast %= NV_LOG_MAX;
-    if (nvHeader.nvLogLast == nvHeader.nvLogFirst) {
-      nvHeader.nvLogFirst++;
-      nvHeader.nvLogFirst %= NV_LOG_MAX;
-    }
-    saveNvHeader();
+    influxAdd(&nvLog);
+    if (logStore->deadband() && logDeadband(nvLog.time, nvLog.power))
+      return;
+    logStore->add(&nvLog);
   }
 }
 
@@ -427,108 +702,81 @@ void
 handleRoot(void)
 {
   WiFiClient client = web.client();
-  struct tm	*tm;
-  char		   timestr[20];
-  double	   va, vars;
-  time_t	   t = time(NULL), uptime = 0;
-  int		     sec, min, hr, day;
+  Page       page(client);
+  struct tm *tm;
+  char       timestr[20];
+  double     va, vars;
+  time_t     t = time(NULL), uptime = 0;
 
   va = voltage * current;
-  vars = va * va- power * power;
+  vars = va * va - power * power;
   vars = vars > 0 ? sqrt(vars) : 0;
 
   tm = localtime(&t);
   strftime(timestr, 20, "%F %T", tm);
 
   if (state & STATE_NTP_GOT_TIME)
-      uptime = t - bootTime;
-  
-  sec = uptime % 60;
-  min = (uptime / 60) % 60;
-  hr = (uptime / 3600) % 24;
-  day = uptime / 86400;
-
-  client.print("HTTP/1.1 200 OK\nContent-Type: text/html\n\n");
-  client.printf("<html lang='en'>"
-    "<head>"
-    "<meta http-equiv='Refresh' content='60; url=/'>"
-    "<meta charset='UTF-8'>"
-    "<title>%s</title>"
-    "%s"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<style>"
-      "body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }"
-      ".dygraph-legend {text-align: right;background: none;}"
-    "</style>"
-    "</head>"
-    "<body>"
-    "<h1>Switch %s</h1>"
-    "%s<p>"
-    "%.2fV %.3fA<br>"
-    "%.2fW<br>"
-    "%.2fVA<br>"
-    "%.2fVAR<br>"
-    "PF=%.1f<br>"
-    "%.6lfkWh<br>"
-    "<p>Plug is %s, turn %s"
-    "%s"
-    "%s"
-    "<p><a href='/config'>Configuration</a>"
-    "%s"
-    "<p><font size=1>"
-    "Uptime: %d days %02d:%02d:%02d"
-    "<br>Firmware: %s"
-    "<br>Boot reason: %s"
-    "</font>"
-    "%s"
-    "</body>"
-    "</html>",
-    cfg.hostname, 
-    state & STATE_FRAM_PRESENT ? "<script src='dygraph.min.js'></script><link rel='stylesheet' type='text/css' href='dygraph.css'>" : "",
-    cfg.hostname, timestr, voltage, current, power, va, vars,
-    voltage > 0 && current > 0 ? power / voltage / current : 1,
-    energy,
-    state & STATE_RELAY ? "on" : "off", state & STATE_RELAY ? "<a href='/off'>Off</a>" : "<a href='/on'>On</a>",
-    state & STATE_RELAY ? "<p><a href='/powercycle'>Load Power Cycle</a>" : "",
-    state & STATE_FRAM_PRESENT ? "<div id='history'></div>" : "",
-    cfg.flags & CFG_SCHEDULE ? "<p><a href='/schedule'>Schedule</a>" : "",
-    day, hr, min, sec, AUTO_VERSION, ESP.getResetReason().c_str(),
-    state & STATE_FRAM_PRESENT ? R"(<script type="text/javascript">
-      Dygraph.onDOMready(function onDOMready() {
-        new Dygraph(document.getElementById('history'), 'data.txt', {
-          title: 'Power history',
-          width: 600,
-          height: 300,
-          legend: 'always',
-          showRangeSelector: true,
-        });
-      });</script>)" : "");
-  client.stop();
-} 
+    uptime = t - bootTime;
+
+  // Without the history script the page reloads itself.
+  page.begin(logStore ? 0 : 60, logStore ? FPSTR(rootHead) : NULL);
+  page(timestr, F("<p><span id='now'>"),
+    fixed(voltage, 2), F("V "), fixed(current, 3), F("A<br>"),
+    fixed(power, 2), F("W<br>"),
+    fixed(va, 2), F("VA<br>"),
+    fixed(vars, 2), F("VAR<br>PF="),
+    fixed(voltage > 0 && current > 0 ? power / voltage / current : 1, 1), F("<br>"),
+    fixed(energy, 6), F("kWh<br></span>"));
+  if (cfg.flags & CFG_TARIFF) {
+    for (uint8_t b = 0; b < TARIFF_BANDS; b++)
+      page(b == tariffBand ? F("&#9656;T") : F("T"), b + 1, F(": "),
+        fixed(nvHeader.tariffPulses[b] * kWhPerPulse, 3), F("kWh<br>"));
+    if (tariffUnknown)
+      page(F("Before NTP: "), fixed(tariffUnknown * kWhPerPulse, 3), F("kWh<br>"));
+  }
+  page(F("<p>Plug is "), state & STATE_RELAY ? F("on, turn <a href='/off'>Off</a>") : F("off, turn <a href='/on'>On</a>"));
+  if (protectReason)
+    page(F("<p>Tripped on "), protectReasons[protectReason], F(" in "), protectLatency == UINT16_MAX ? F("over ") : F(""),
+      protectLatency, F("us, <a href='/tripreset'>Reset</a>"));
+  if (cfg.demandMin && cfg.demandW)
+    page(F("<p>Demand "), fixed(demandAverage(), 0), F("W of "), cfg.demandW, F("W over "), cfg.demandMin, F(" min"),
+      state & STATE_SHED ? F(", load shed") : F(""));
+  if (state & STATE_RELAY)
+    page(F("<p><a href='/powercycle'>Load Power Cycle</a>"));
+  if (logStore)
+    page(F("<div id='history'></div>"));
+  page(F("<p><a href='/config'>Configuration</a>"));
+  if (cfg.flags & CFG_SCHEDULE)
+    page(F("<p><a href='/schedule'>Schedule</a>"));
+  if (cfg.flags & CFG_TARIFF)
+    page(F("<p><a href='/tariff'>Tariffs</a>"));
+  page(F("<p><font size=1>Uptime: "), (long)(uptime / 86400), F(" days "),
+    two(uptime / 3600 % 24), F(":"), two(uptime / 60 % 60), F(":"), two(uptime % 60),
+    F("<br>Firmware: "), AUTO_VERSION,
+    F("<br>Boot reason: "), ESP.getResetReason().c_str(),
+    F("<br>Heap: "), (unsigned)ESP.getFreeHeap(), F(" free, "), (unsigned)ESP.getMaxFreeBlockSize(), F(" max block, "),
+    (unsigned)ESP.getHeapFragmentation(), F("% fragmented, "), (unsigned)memLow.heap, F(" low water"));
+  if (cfg.brownoutV && state & STATE_FRAM_PRESENT)
+    page(F("<br>Brownout: "), (unsigned)checkpointHoldup, F("ms hold-up, "), (unsigned)checkpointLatency, F("us checkpoint"));
+  page(F("</font>"));
+  if (logStore)
+    page(FPSTR(rootScript));
+  page.end();
+}
 
 void
 handlePowerCycle(void)
 {
   WiFiClient client = web.client();
+  Page       page(client);
 
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='1; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "%s<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname, state & STATE_RELAY ? "Power cycling" : "Not powercycling");
-  client.stop();
+  page.begin(1);
+  page(state & STATE_RELAY ? F("Power cycling") : F("Not powercycling"), F("<br>"));
+  page.end();
   if (state & STATE_RELAY) {
-    digitalWrite(RELAY, LOW);
+    setRelay(false);
     delay(1000);
-    digitalWrite(RELAY, HIGH);
+    setRelay(true);
   }
 }
 
@@ -536,171 +784,174 @@ void
 handleOn(void)
 {
   WiFiClient client = web.client();
+  bool       on = setRelay(true);
+  Page       page(client);
 
-  digitalWrite(RELAY, HIGH);
-  state |= STATE_RELAY;
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='1; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "Relay is on<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname);
-  client.stop();
+  page.begin(1);
+  page(on ? F("Relay is on") : protectReason ? F("Relay is held off by a trip") : F("Relay is held off by the demand limit"), F("<br>"));
+  page.end();
 }
 
 void
 handleOff(void)
 {
   WiFiClient client = web.client();
+  Page       page(client);
 
-  digitalWrite(RELAY, LOW);
-  state &= ~STATE_RELAY;
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='1; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "Relay is off<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname);
-  client.stop();
+  setRelay(false);
+  page.begin(1);
+  page(F("Relay is off<br>"));
+  page.end();
 }
 
 void
 handleConfig()
 {
   WiFiClient client = web.client();
+  Page       page(client);
 
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>\n"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "<form method='post' action='/save' name='Configuration'/>\n"
+  page.begin();
+  page(F("<form method='post' action='/save' name='Configuration'/>\n"
     "<table border=0 width='520' cellspacing=4 cellpadding=0>\n"
-    "<tr><td width='40%%'>Name:</td><td><input name='name' type='text' value='%s' size='31' maxlength='31'></td></tr>\n"
-    "<tr><td width='40%%'>SSID:</td><td><input name='ssid' type='text' value='%s' size='31' maxlength='63'></td></tr>\n"
-    "<tr><td width='40%%'>WPA Pass Phrase:</td><td><input name='psk' type='text' value='%s' size='31' maxlength='63'></td></tr>\n"
-    "<tr><td width='40%%'>NTP Server:</td><td><input name='ntp' type='text' value='%s' size='31' maxlength='63' "
+    "<tr><td width='40%'>Name:</td><td><input name='name' type='text' value='"), cfg.hostname, F("' size='31' maxlength='31'></td></tr>\n"
+    "<tr><td width='40%'>SSID:</td><td><input name='ssid' type='text' value='"), cfg.ssid, F("' size='31' maxlength='63'></td></tr>\n"
+    "<tr><td width='40%'>WPA Pass Phrase:</td><td><input name='psk' type='text' value='"), cfg.psk, F("' size='31' maxlength='63'></td></tr>\n"
+    "<tr><td width='40%'>NTP Server:</td><td><input name='ntp' type='text' value='"), cfg.ntpserver, F("' size='31' maxlength='63' "
     	"pattern='^(([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\\-]*[a-zA-Z0-9])\\.)*([A-Za-z0-9]|[A-Za-z0-9][A-Za-z0-9\\-]*[A-Za-z0-9])$' title='A valid hostname'></td></tr>\n"
-    "<tr><td width='40%%'>Timezone:</td><td><input name='tz' type='text' value='%s' size='31' maxlength='31'></td></tr>\n"
-    "<tr><td width='40%%'>On at boot:</td><td><input name='relay' type='checkbox' value='true' %s></td></tr>\n"
-    "<tr><td width='40%%'>Schedule:</td><td><input name='sched' type='checkbox' value='true' %s></td></tr>\n"
-    "<tr><td width='40%%'>Correction factor V:</td><td><input name='vf' type='text' value='%5.3f' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
-    "<tr><td width='40%%'>Correction factor I:</td><td><input name='if' type='text' value='%5.3f' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
-    "<tr><td width='40%%'>Correction factor P:</td><td><input name='pf' type='text' value='%5.3f' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
+    "<tr><td width='40%'>Timezone:</td><td><input name='tz' type='text' value='"), cfg.timezone, F("' size='31' maxlength='31'></td></tr>\n"
+    "<tr><td width='40%'>On at boot:</td><td><input name='relay' type='checkbox' value='true' "), checked(cfg.flags & CFG_RELAY_ON_BOOT), F("></td></tr>\n"
+    "<tr><td width='40%'>Schedule:</td><td><input name='sched' type='checkbox' value='true' "), checked(cfg.flags & CFG_SCHEDULE), F("></td></tr>\n"
+    "<tr><td width='40%'>Tariffs:</td><td><input name='tariff' type='checkbox' value='true' "), checked(cfg.flags & CFG_TARIFF), F("></td></tr>\n"
+    "<tr><td width='40%'>Flash history:</td><td><input name='fslog' type='checkbox' value='true' "), checked(cfg.flags & CFG_FSLOG), F("></td></tr>\n"
+    "<tr><td width='40%'>Deadband logging:</td><td><input name='dlog' type='checkbox' value='true' "), checked(cfg.flags & CFG_LOG_DEADBAND), F("></td></tr>\n"
+    "<tr><td width='40%'>Deadband W:</td><td><input name='dbw' type='text' value='"), fixed(cfg.logDeadbandW, 1), F("' size='31' pattern='^[0-9]{1,4}(\\.[0-9])?$' title='watts'></td></tr>\n"
+    "<tr><td width='40%'>Deadband %:</td><td><input name='dbp' type='number' value='"), cfg.logDeadbandPct, F("' min='0' max='100'></td></tr>\n"
+    "<tr><td width='40%'>Heartbeat s:</td><td><input name='dbh' type='number' value='"), logHeartbeat(), F("' min='"), NV_LOG_PERIOD, F("' max='65535'></td></tr>\n"
+    "<tr><td width='40%'>Brownout V:</td><td><input name='bov' type='number' value='"), cfg.brownoutV, F("' min='0' max='255'></td></tr>\n"
+    "<tr><td width='40%'>Trip A:</td><td><input name='tripa' type='text' value='"), fixed(cfg.tripA, 1), F("' size='31' pattern='^[0-9]{1,2}(\\.[0-9])?$' title='amps, 0 disables'></td></tr>\n"
+    "<tr><td width='40%'>Trip W:</td><td><input name='tripw' type='number' value='"), cfg.tripW, F("' min='0' max='4000'></td></tr>\n"
+    "<tr><td width='40%'>Inrush ms:</td><td><input name='inrush' type='number' value='"), cfg.inrushMs, F("' min='0' max='10000'></td></tr>\n"
+    "<tr><td width='40%'>Demand window min:</td><td><input name='dmin' type='number' value='"), cfg.demandMin, F("' min='0' max='255'></td></tr>\n"
+    "<tr><td width='40%'>Demand budget W:</td><td><input name='dw' type='number' value='"), cfg.demandW, F("' min='0' max='4000'></td></tr>\n"
+    "<tr><td width='40%'>Demand restore %:</td><td><input name='dpct' type='number' value='"), cfg.demandPct, F("' min='0' max='100'></td></tr>\n"
+    "<tr><td width='40%'>UDP key:</td><td><input name='udpkey' type='text' value='"), cfg.udpKey, F("' size='31' maxlength='31'></td></tr>\n"
+    "<tr><td width='40%'>MQTT broker:</td><td><input name='mqhost' type='text' value='"), cfg.mqttHost, F("' size='31' maxlength='63'></td></tr>\n"
+    "<tr><td width='40%'>MQTT port:</td><td><input name='mqport' type='number' value='"), cfg.mqttPort ? cfg.mqttPort : MQTT_PORT, F("' min='1' max='65535'></td></tr>\n"
+    "<tr><td width='40%'>MQTT user:</td><td><input name='mquser' type='text' value='"), cfg.mqttUser, F("' size='31' maxlength='31'></td></tr>\n"
+    "<tr><td width='40%'>MQTT password:</td><td><input name='mqpass' type='text' value='"), cfg.mqttPass, F("' size='31' maxlength='31'></td></tr>\n"
+    "<tr><td width='40%'>MQTT interval s:</td><td><input name='mqper' type='number' value='"), cfg.mqttPeriod ? cfg.mqttPeriod : MQTT_PERIOD, F("' min='1' max='65535'></td></tr>\n"
+    "<tr><td width='40%'>InfluxDB UDP host:</td><td><input name='ifhost' type='text' value='"), cfg.influxHost, F("' size='31' maxlength='63'></td></tr>\n"
+    "<tr><td width='40%'>InfluxDB UDP port:</td><td><input name='ifport' type='number' value='"), cfg.influxPort ? cfg.influxPort : INFLUX_PORT, F("' min='1' max='65535'></td></tr>\n"
+    "<tr><td width='40%'>InfluxDB batch:</td><td><input name='ifbatch' type='number' value='"), cfg.influxBatch ? cfg.influxBatch : INFLUX_BATCH, F("' min='1' max='10'></td></tr>\n"
+    "<tr><td width='40%'>Correction factor V:</td><td><input name='vf' type='text' value='"), fixed(cfg.calibration.V, 3), F("' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
+    "<tr><td width='40%'>Correction factor I:</td><td><input name='if' type='text' value='"), fixed(cfg.calibration.I, 3), F("' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
+    "<tr><td width='40%'>Correction factor P:</td><td><input name='pf' type='text' value='"), fixed(cfg.calibration.P, 3), F("' size='31' pattern='^[0-1]\\.[0-9]{1,3}$' title='float with up to 3 decimals'></td></tr>\n"
     "</table><p>"
     "<input name='Save' type='submit' value='Save'/>\n"
     "<br></form>"
     "<form method='post' action='/reboot' name='Reboot'/>\n"
     "<input name='Reboot' type='submit' value='Reboot'/>\n"
-    "<br></form>\n"
-    "</body>\n"
-    "</html>",
-    cfg.hostname, cfg.hostname, cfg.hostname, cfg.ssid, cfg.psk, cfg.ntpserver, cfg.timezone,
-    cfg.flags & CFG_RELAY_ON_BOOT ? "checked" : "",
-    cfg.flags & CFG_SCHEDULE ? "checked" : "",
-    cfg.calibration.V, cfg.calibration.I, cfg.calibration.P);
-  client.stop();
+    "<br></form>\n"));
+  page.end();
 }
 
-void
-handleSave(void)
+// A PUT to /api/v1/config while its body is parsed into a copy of the config.
+struct configPut {
+  struct config   cfg;
+  struct formJson json;
+};
+static struct configPut *configPending = NULL;
+
+// A form posted to a save handler, decoded into the config as it arrives.
+static struct formBody formPending;
+
+static void
+formBodyHandle(const struct formField *fields, uint8_t n)
 {
-  WiFiClient client = web.client();
+  HTTPRaw &raw = web.raw();
+
+  if (raw.status == RAW_START)
+    formBodyBegin(&formPending, fields, n, &cfg);
+  else if (raw.status == RAW_WRITE && formPending.fields == fields)
+    formBodyFeed(&formPending, (const char *)raw.buf, raw.currentSize);
+  else if (raw.status == RAW_ABORTED && formPending.fields == fields) {
+    // Drop what was decoded of it.
+    formPending.fields = NULL;
+    cfgLoad(cfgStats.store == CFG_STORE_FS);
+  }
+}
 
-  if (web.hasArg("vf"))
-    cfg.calibration.V = web.arg("vf").toFloat();
-  if (web.hasArg("if"))
-    cfg.calibration.I = web.arg("if").toFloat();
-  if (web.hasArg("ef"))
-    cfg.calibration.P = web.arg("pf").toFloat();
-  if (web.hasArg("name")) {
-    strncpy(cfg.hostname, web.arg("name").c_str(), STR32);
-    cfg.ssid[STR32 - 1] = '\0';
-  }
-  if (web.hasArg("ssid")) {
-    strncpy(cfg.ssid, web.arg("ssid").c_str(), STR64);
-    cfg.ssid[STR64 - 1] = '\0';
-  }
-  if (web.hasArg("psk")) {
-    strncpy(cfg.psk, web.arg("psk").c_str(), STR64);
-    cfg.psk[STR64 - 1] = '\0';
-  }
-  if (web.hasArg("relay"))
-			cfg.flags |= CFG_RELAY_ON_BOOT;
-		else
-			cfg.flags &= ~CFG_RELAY_ON_BOOT;
-  if (web.hasArg("sched"))
-			cfg.flags |= CFG_SCHEDULE;
-		else
-			cfg.flags &= ~CFG_SCHEDULE;
-
-  EEPROM.put(0, cfg);
-  EEPROM.commit();
+// The posted form, or the arguments should the server have kept the body itself.
+static uint8_t
+formSaved(const struct formField *fields, uint8_t n)
+{
+  uint8_t bad;
 
+  if (formPending.fields != fields)
+    return formDecode(fields, n, &cfg);
+  bad = formBodyEnd(&formPending);
+  formPending.fields = NULL;
+  return bad;
+}
+
+/*
+ * Restart what depends on the config once it has changed.  The network is
+ * left alone unless the name or the access point changed.
+ */
+void
+configApply(bool reconnect)
+{
   if (cfg.ntpserver[0])
     configTzTime(cfg.timezone, cfg.ntpserver);
   else
     setTZ(cfg.timezone);
+  fmtReset();
+  tariffUpdate();
+  if (reconnect) {
+    wlanBegin();
+    MDNS.begin(cfg.hostname);
+    advertBegin();
+  }
+  udpBegin();
+  mqttBegin();
+  influxBegin();
+}
 
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='1; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "Saved<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname);
-  client.stop();
+void
+handleSaveBody(void)
+{
+  formBodyHandle(configForm, sizeof(configForm) / sizeof(configForm[0]));
+}
+
+void
+handleSave(void)
+{
+  WiFiClient client = web.client();
+  Page       page(client);
+
+  formSaved(configForm, sizeof(configForm) / sizeof(configForm[0]));
+  saveConfig();
+
+  page.begin(1);
+  page(F("Saved<br>"));
+  page.end();
   delay(100);
-  WiFi.hostname(cfg.hostname);
-  WiFi.begin(cfg.ssid, cfg.psk);
-  MDNS.begin(cfg.hostname);
+  configApply(true);
 };
 
 void
 handleReboot(void)
 {
   WiFiClient client = web.client();
+  Page       page(client);
 
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='10; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "Rebooting<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname);
-  client.stop();
+  page.begin(10);
+  page(F("Rebooting<br>"));
+  page.end();
   delay(100);
   state |= STATE_OTA_OR_REBOOT;
+  if (logStore)
+    logStore->flush();
   if (state & STATE_FRAM_PRESENT)
     saveNvHeader();
   ESP.restart();
@@ -710,207 +961,476 @@ void
 handleSchedule(void)
 {
   WiFiClient client = web.client();
+  Page       page(client);
 
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "</body>\n"
-    "<html>"
-    "<form method='post' action='/schedulesave' name='Schedule'>\n"
-    "<table border=0 width='520' cellspacing=4 cellpadding=0>\n",
-    cfg.hostname, cfg.hostname);
+  page.begin();
+  page(F("<form method='post' action='/schedulesave' name='Schedule'>\n"
+    "<table border=0 width='520' cellspacing=4 cellpadding=0>\n"));
 
   for (int i = 0; i < 7; i++) {
-    client.printf("<tr><td><b>%s:</b></td></tr>\n"
-		"<tr><td>on:<input name='eon%d' type='checkbox' value='true' %s>"
-    "<input name='on%d' type='time' value='%02d:%02d'></td>"
-		"<td>off:<input name='eof%d' type='checkbox' value='true' %s>"
-    "<input name='off%d' type='time' value='%02d:%02d'></td>"
-    "<td>Randomize:<input name='r%d' type='checkbox' value='true' %s></td></tr>\n"
-    "<tr><td>&nbsp</td></tr>",
-    daysOfWeek[i], 
-    i, cfg.schedule[i].flags & SCHED_ON_ENABLED ? "checked" : "",
-    i, cfg.schedule[i].h_on, cfg.schedule[i].m_on,
-    i, cfg.schedule[i].flags & SCHED_OFF_ENABLED ? "checked" : "",
-    i, cfg.schedule[i].h_off, cfg.schedule[i].m_off,
-    i, cfg.schedule[i].flags & SCHED_RANDOM ? "checked" : "");
-  }
-
-  client.printf("</table><p>"
+    struct schedule *s = &cfg.schedule[i];
+
+    page(F("<tr><td><b>"), daysOfWeek[i], F(":</b></td></tr>\n"
+      "<tr><td>on:<input name='eon"), i, F("' type='checkbox' value='true' "), checked(s->flags & SCHED_ON_ENABLED),
+      F("><input name='on"), i, F("' type='time' value='"), two(s->h_on), F(":"), two(s->m_on), F("'></td>"
+      "<td>off:<input name='eof"), i, F("' type='checkbox' value='true' "), checked(s->flags & SCHED_OFF_ENABLED),
+      F("><input name='off"), i, F("' type='time' value='"), two(s->h_off), F(":"), two(s->m_off), F("'></td>"
+      "<td>Randomize:<input name='r"), i, F("' type='checkbox' value='true' "), checked(s->flags & SCHED_RANDOM),
+      F("></td></tr>\n"
+      "<tr><td>&nbsp</td></tr>"));
+  }
+
+  page(F("</table><p>"
     "<input name='Save' type='submit' value='Save'>\n"
-    "</form>"
-    "</body>"
-    "</html>");
-  client.stop();
+    "</form>"));
+  page.end();
+}
+
+void
+handleScheduleSaveBody(void)
+{
+  formBodyHandle(scheduleForm, sizeof(scheduleForm) / sizeof(scheduleForm[0]));
 }
 
 void
 handleScheduleSave(void)
 {
   WiFiClient client = web.client();
-  String  value;
-  char    arg[5];
+  Page       page(client);
+
+  formSaved(scheduleForm, sizeof(scheduleForm) / sizeof(scheduleForm[0]));
+  saveConfig();
+
+  page.begin(1);
+  page(F("Saved<br>"));
+  page.end();
+}
+
+void
+handleTariff(void)
+{
+  WiFiClient client = web.client();
+  Page       page(client);
+
+  page.begin();
+  page(F("<form method='post' action='/tariffsave' name='Tariff'>\n"
+    "<table border=0 width='720' cellspacing=4 cellpadding=0>\n"));
 
   for (int i = 0; i < 7; i++) {
-    snprintf(arg, 5, "on%d", i);
-    arg[4] = '\0';
-    value = web.arg(arg);
-    if (value.length()) {
-      int h, m;
-      if (sscanf(value.c_str(), "%d:%d", &h, &m) == 2 ) {
-        if (h >= 0 && h <= 23)
-          cfg.schedule[i].h_on = h;
-        if (m >= 0 && m <= 59)
-          cfg.schedule[i].m_on = m;
-      }
+    page(F("<tr><td><b>"), daysOfWeek[i], F(":</b></td></tr>\n<tr>"));
+    for (int j = 0; j < TARIFF_POINTS; j++) {
+      struct tariff *t = &cfg.tariff[i][j];
+      uint8_t        band = t->flags & TARIFF_BAND_MASK;
+
+      page(F("<td><input name='te"), i, j, F("' type='checkbox' value='true' "), checked(t->flags & TARIFF_ENABLED),
+        F("><input name='t"), i, j, F("' type='time' value='"), two(t->h), F(":"), two(t->m), F("'>"
+        "<select name='tb"), i, j, F("'>"
+        "<option value='0'"), band == 0 ? F(" selected") : F(""), F(">T1</option>"
+        "<option value='1'"), band == 1 ? F(" selected") : F(""), F(">T2</option>"
+        "<option value='2'"), band == 2 ? F(" selected") : F(""), F(">T3</option>"
+        "<option value='3'"), band == 3 ? F(" selected") : F(""), F(">T4</option>"
+        "</select></td>"));
     }
+    page(F("</tr>\n"));
+  }
 
-    snprintf(arg, 5, "off%d", i);
-    arg[4] = '\0';
-    value = web.arg(arg);
-    if (value.length()) {
-      int h, m;
-      if (sscanf(value.c_str(), "%d:%d", &h, &m) == 2 ) {
-        if (h >= 0 && h <= 23)
-          cfg.schedule[i].h_off = h;
-        if (m >= 0 && m <= 59)
-          cfg.schedule[i].m_off = m;
-      }
-    }
+  page(F("</table><p>"
+    "<input name='Save' type='submit' value='Save'>\n"
+    "</form>"
+    "<form method='post' action='/tariffreset' name='Reset'>\n"
+    "<input name='Reset' type='submit' value='Reset totals'>\n"
+    "</form>"));
+  page.end();
+}
 
-    snprintf(arg, 5, "eon%d", i);
-    if (web.hasArg(arg))
-      cfg.schedule[i].flags |= SCHED_ON_ENABLED;
-    else
-      cfg.schedule[i].flags &= ~SCHED_ON_ENABLED;
+void
+handleTariffSaveBody(void)
+{
+  formBodyHandle(tariffForm, sizeof(tariffForm) / sizeof(tariffForm[0]));
+}
 
-    snprintf(arg, 5, "eof%d", i);
-    if (web.hasArg(arg))
-      cfg.schedule[i].flags |= SCHED_OFF_ENABLED;
-    else
-      cfg.schedule[i].flags &= ~SCHED_OFF_ENABLED;
+void
+handleTariffSave(void)
+{
+  WiFiClient client = web.client();
+  Page       page(client);
 
-    snprintf(arg, 5, "r%d", i);
-    if (web.hasArg(arg))
-      cfg.schedule[i].flags |= SCHED_RANDOM;
-    else
-      cfg.schedule[i].flags &= ~SCHED_RANDOM;
-  }
-  EEPROM.put(0, cfg);
-  EEPROM.commit();
-
-  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n");
-  client.printf("<html>"
-    "<head>"
-    "<title>%s</title>\n"
-    "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
-    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
-    "<meta http-equiv='Refresh' content='1; url=/'>"
-    "</head>\n"
-    "<body>\n"
-    "<h1>Switch %s</h1>"
-    "Saved<br>"
-    "</body>\n"
-    "</html>", cfg.hostname, cfg.hostname);
+  formSaved(tariffForm, sizeof(tariffForm) / sizeof(tariffForm[0]));
+  saveConfig();
+  tariffUpdate();
+
+  page.begin(1);
+  page(F("Saved<br>"));
+  page.end();
+}
+
+void
+handleTariffReset(void)
+{
+  WiFiClient client = web.client();
+  Page       page(client);
+
+  tariffReset();
+  if (state & STATE_FRAM_PRESENT)
+    saveNvHeader();
+
+  page.begin(1);
+  page(F("Tariff totals reset<br>"));
+  page.end();
+}
+
+void
+handleTripReset(void)
+{
+  WiFiClient client = web.client();
+  Page       page(client);
+
+  protectReset();
+
+  page.begin(1);
+  page(F("Trip reset<br>"));
+  page.end();
+}
+
+void
+handleStatus(void)
+{
+  WiFiClient client = web.client();
+
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nCache-Control: no-store\r\n\r\n");
+  client.printf("{\"hostname\":\"%s\",\"time\":%lld,\"relay\":%s,"
+    "\"voltage\":%.2f,\"current\":%.3f,\"power\":%.2f,\"energy\":%.6lf",
+    cfg.hostname, (long long)time(NULL), state & STATE_RELAY ? "true" : "false",
+    voltage, current, power, energy);
+  if (cfg.flags & CFG_TARIFF) {
+    client.printf(",\"tariff\":{\"band\":%d,\"energy\":[", tariffBand + 1);
+    for (uint8_t b = 0; b < TARIFF_BANDS; b++)
+      client.printf("%s%.6lf", b ? "," : "", nvHeader.tariffPulses[b] * kWhPerPulse);
+    client.printf("],\"unknown\":%.6lf}", tariffUnknown * kWhPerPulse);
+  }
+  if (cfg.demandMin && cfg.demandW)
+    client.printf(",\"demand\":{\"average\":%.1f,\"budget\":%d,\"window\":%d,\"shed\":%s}",
+      demandAverage(), cfg.demandW, cfg.demandMin, state & STATE_SHED ? "true" : "false");
+  if (protectReason)
+    client.printf(",\"trip\":{\"reason\":\"%s\",\"latency\":%u}",
+      protectReasons[protectReason], protectLatency);
+  client.print("}\n");
   client.stop();
 }
 
 void
-handleDygraphJS(void)
+handleConfigGet(void)
 {
-  String encoding;
-  File file;
+  WiFiClient client = web.client();
 
-  if (web.hasHeader("accept-encoding"))
-    encoding = web.header("Accept-Encoding");
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nCache-Control: no-store\r\n\r\n");
+  formJsonWrite(client, configJson, CONFIG_JSON, &cfg);
+  client.stop();
+}
 
-  if (encoding.startsWith("gzip"))
-    file = LittleFS.open("/dygraph.min.js.gz", "r");
-  else
-    file = LittleFS.open("/dygraph.min.js", "r");
+// The body arrives in segments ahead of handleConfigPut().
+void
+handleConfigBody(void)
+{
+  HTTPRaw &raw = web.raw();
 
-  web.sendHeader("X-Recieved", encoding, false);
-  web.sendHeader("Cache-Control", "public, max-age=86400, immutable", false);
-  web.streamFile(file, "application/javascript");
-  file.close();
+  if (raw.status == RAW_START) {
+    delete configPending;
+    if ((configPending = new (std::nothrow) struct configPut)) {
+      configPending->cfg = cfg;
+      formJsonBegin(&configPending->json, configJson, CONFIG_JSON, &configPending->cfg);
+    }
+  }
+  else if (raw.status == RAW_WRITE && configPending)
+    formJsonFeed(&configPending->json, (const char *)raw.buf, raw.currentSize);
+  else if (raw.status == RAW_ABORTED) {
+    delete configPending;
+    configPending = NULL;
+  }
 }
 
+/*
+ * Members left out of the document are kept, so a template need only carry
+ * what a fleet shares.  Nothing is saved unless the whole document parses.
+ */
 void
-handleDygraphCSS(void)
+handleConfigPut(void)
 {
-  String encoding;
-  File file;
+  WiFiClient  client = web.client();
+  uint8_t     rejected;
+  bool        reconnect;
+
+  // Should the server keep the body whole rather than hand it over raw.
+  if (!configPending && web.hasArg("plain")) {
+    const String &body = web.arg("plain");
+
+    if ((configPending = new (std::nothrow) struct configPut)) {
+      configPending->cfg = cfg;
+      formJsonBegin(&configPending->json, configJson, CONFIG_JSON, &configPending->cfg);
+      formJsonFeed(&configPending->json, body.c_str(), body.length());
+    }
+  }
+  if (!configPending) {
+    client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Type: application/json\r\n\r\n{\"error\":\"no memory\"}\n");
+    client.stop();
+    return;
+  }
+  if (!formJsonEnd(&configPending->json)) {
+    client.print("HTTP/1.1 400 Bad Request\r\nContent-Type: application/json\r\n\r\n{\"error\":\"malformed\"}\n");
+    client.stop();
+    delete configPending;
+    configPending = NULL;
+    return;
+  }
 
-  if (web.hasHeader("accept-encoding"))
-    encoding = web.header("Accept-Encoding");
+  reconnect = strcmp(cfg.hostname, configPending->cfg.hostname) || strcmp(cfg.ssid, configPending->cfg.ssid) ||
+    strcmp(cfg.psk, configPending->cfg.psk);
+  rejected = configPending->json.bad;
+  cfg = configPending->cfg;
+  delete configPending;
+  configPending = NULL;
+  saveConfig();
 
-  if (encoding.startsWith("gzip"))
-    file = LittleFS.open("/dygraph.css.gz", "r");
-  else
-    file = LittleFS.open("/dygraph.css", "r");
-  
-  web.sendHeader("Cache-Control", "public, max-age=86400, immutable", false);
-  web.streamFile(file, "text/css");
-  file.close();
+  client.printf("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nCache-Control: no-store\r\n\r\n"
+    "{\"saved\":true,\"rejected\":%u}\n", rejected);
+  client.stop();
+  delay(100);
+  configApply(reconnect);
 }
 
 void
-handleFavIcon(void)
+handleLogStats(void)
+{
+  WiFiClient  client = web.client();
+  uint32_t    n, scan;
+
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-store\r\n\r\n");
+  if (!logStore) {
+    client.print("No history store\n");
+    client.stop();
+    return;
+  }
+  n = logStore->count();
+  scan = logStore->scan();
+  client.printf("Backend: %s\n"
+    "Records: %u of %u\n"
+    "Appends: %u\n"
+    "Append average: %u us\n"
+    "Append max: %u us\n"
+    "Scan: %u records in %u us, %u records/s\n",
+    logStore->name(), (unsigned)n, (unsigned)logStore->capacity(), (unsigned)logStore->appends,
+    logStore->appends ? (unsigned)(logStore->appendTotal / logStore->appends) : 0,
+    (unsigned)logStore->appendMax, (unsigned)n, (unsigned)scan,
+    scan ? (unsigned)((uint64_t)n * 1000000 / scan) : 0);
+  if (state & STATE_FRAM_PRESENT)
+    client.printf("FRAM: %u bytes\n", (unsigned)nvHeader.size);
+  client.printf("Config: %s slot %u, sequence %u\n"
+    "Config saves: %u, %u unchanged\n"
+    "Config commit: %u us last, %u us max\n",
+    cfgStores[cfgStats.store], cfgStats.slot, (unsigned)cfgStats.seq,
+    (unsigned)cfgStats.saves, (unsigned)cfgStats.unchanged,
+    (unsigned)cfgStats.commitLast, (unsigned)cfgStats.commitMax);
+  client.stop();
+}
+
+struct csvOut {
+  Print       *client;        // The client, or an encoder in front of it.
+  bool         epoch;         // Unix times rather than local date strings.
+  char        *p;
+  char         data[1460];
+};
+
+// Append a history row, flushing full segments to the client.
+static void
+csvRow(void *ctx, time_t t, float power)
 {
-  String encoding;
-  File file;
+  struct csvOut *out = (struct csvOut *)ctx;
 
-  if (web.hasHeader("accept-encoding"))
-    encoding = web.header("Accept-Encoding");
+  if (out->p - out->data > (int)sizeof(out->data) - 40) {
+    out->client->write(out->data, out->p - out->data);
+    out->p = out->data;
+  }
+  out->p = out->epoch ? fmtFixed(out->p, t, 0) : fmtTime(out->p, t);
+  *out->p++ = ',';
+  out->p = fmtFixed(out->p, power, 2);
+  *out->p++ = '\n';
+}
 
-  if (encoding.startsWith("gzip"))
-    file = LittleFS.open("/favicon.ico.gz", "r");
-  else
-    file = LittleFS.open("/favicon.ico", "r");
-  
-  web.sendHeader("Cache-Control", "public, max-age=86400, immutable", false);
-  web.streamFile(file, "image/x-icon");
-  file.close();
+void
+handleInfluxStats(void)
+{
+  WiFiClient  client = web.client();
+
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-store\r\n\r\n");
+  if (!cfg.influxHost[0]) {
+    client.print("InfluxDB export disabled\n");
+    client.stop();
+    return;
+  }
+  client.printf("Collector: %s:%u\n"
+    "Datagrams: %u, %u lines\n"
+    "Send errors: %u, %u lines dropped\n",
+    cfg.influxHost, cfg.influxPort ? cfg.influxPort : INFLUX_PORT,
+    (unsigned)influxStats.datagrams, (unsigned)influxStats.lines,
+    (unsigned)influxStats.errors, (unsigned)influxStats.dropped);
+  client.stop();
+}
+
+void
+handleMqttStats(void)
+{
+  WiFiClient  client = web.client();
+
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-store\r\n\r\n");
+  if (!cfg.mqttHost[0]) {
+    client.print("MQTT disabled\n");
+    client.stop();
+    return;
+  }
+  client.printf("Broker: %s:%u, %s\n"
+    "Connects: %u, longest attempt %u ms\n"
+    "Messages: %u, %u bytes\n"
+    "Publish average: %u us\n"
+    "Publish max: %u us\n"
+    "History: %u rows sent, %u queued\n"
+    "Heap: %u bytes\n",
+    cfg.mqttHost, cfg.mqttPort ? cfg.mqttPort : MQTT_PORT, mqttConnected() ? "connected" : "disconnected",
+    (unsigned)mqttStats.connects, (unsigned)mqttStats.connectMax, (unsigned)mqttStats.messages, (unsigned)mqttStats.bytes,
+    mqttStats.messages ? (unsigned)(mqttStats.publishTotal / mqttStats.messages) : 0,
+    (unsigned)mqttStats.publishMax, (unsigned)mqttStats.rows, (unsigned)mqttBacklog(),
+    (unsigned)mqttStats.heap);
+  client.stop();
+}
+
+void
+handleWlanStats(void)
+{
+  WiFiClient      client = web.client();
+  const uint8_t  *bssid;
+  uint8_t         channel;
+  static const char *phases[] = { "connecting", "connected", "backing off" };
+
+  bssid = wlanHint(&channel);
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-store\r\n\r\n");
+  client.printf("State: %s%s, %u failures, %u ms backoff left\n"
+    "Signal: %d dBm\n",
+    phases[wlanState()], WiFi.getMode() & WIFI_AP ? ", access point up" : "",
+    wlanFailures(), (unsigned)wlanBackoff(), (int)WiFi.RSSI());
+  if (bssid)
+    client.printf("Hint: %02x:%02x:%02x:%02x:%02x:%02x channel %u\n",
+      bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], channel);
+  client.printf("Attempts: %u\n"
+    "Disconnects: %u, last reason %u\n"
+    "Access point fallbacks: %u\n"
+    "Reconnect: %u ms last, %u ms max\n"
+    "\nreason  count\n",
+    (unsigned)wlanStats.attempts, (unsigned)wlanStats.disconnects, wlanStats.reason,
+    (unsigned)wlanStats.fallbacks, (unsigned)wlanStats.reconnectLast, (unsigned)wlanStats.reconnectMax);
+  for (uint8_t i = 0; i < WLAN_REASONS; i++)
+    if (wlanStats.reasons[i])
+      client.printf("%6u %6u\n", i ? wlanReason(i) : 0, wlanStats.reasons[i]);
+  client.print("\nreconnect  count\n");
+  for (uint8_t i = 0; i < WLAN_BUCKETS; i++)
+    client.printf(i < WLAN_BUCKETS - 1 ? "<%5us %9u\n" : ">=%4us %9u\n",
+      wlanBuckets[min(i, (uint8_t)(WLAN_BUCKETS - 2))], wlanStats.reconnects[i]);
+  client.stop();
 }
 
 void
 handleNvData(void)
 {
   WiFiClient    client = web.client();
-  struct nvLog  log;
-  struct tm     *tm;
-  char          timestr[20], data[1460], *p;
-  uint16_t      len;
-  time_t        t;
-
-  p = data;
-  len = snprintf(p, 1460, "HTTP/1.1 200 OK\n"
+  struct csvOut out;
+  Gzip         *gz = NULL;
+  struct nvLog  log, prev = { 0, 0 };
+  Lttb          lttb(csvRow, &out);
+  char          etag[24];
+  uint32_t      first = 0, count = 0;
+  uint16_t      points = 0, period;
+
+  if (!logStore) {
+    client.print("HTTP/1.1 404 Not Found\r\n\r\n");
+    client.stop();
+    return;
+  }
+  count = logStore->count();
+  period = logStore->period();
+
+  /*
+   * The ETag identifies the ring position, it only changes when a record is
+   * appended.  With ?since=<epoch> only newer records are returned and the
+   * X-Last header carries the epoch to ask for next time.  ?epoch gives the
+   * row times as Unix times for collectors.
+   */
+  logStore->etag(etag, sizeof(etag));
+  if (web.hasArg("since"))
+    first = logStore->since(strtoll(web.arg("since").c_str(), NULL, 10));
+  if (count)
+    logStore->read(count - 1, &log);
+
+  if ((web.hasHeader("If-None-Match") && web.header("If-None-Match") == etag) ||
+      (web.hasArg("since") && first == count)) {
+    client.printf("HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", etag);
+    client.stop();
+    return;
+  }
+
+  // With ?points=N the records are reduced to about N points for graphing.
+  if (web.hasArg("points")) {
+    long n = web.arg("points").toInt();
+
+    if (n >= 3 && n < (long)(count - first))
+      points = lttb.begin(count - first, min(n, (long)UINT16_MAX));
+  }
+
+  // The rows compress about four to one, worth it on a weak link.
+  if (gzipAccepted(web.header("Accept-Encoding").c_str()))
+    gz = new (std::nothrow) Gzip(client);
+  out.client = gz ? (Print *)gz : &client;
+  out.epoch = web.hasArg("epoch");
+  out.p = out.data + snprintf(out.data, sizeof(out.data), "HTTP/1.1 200 OK\n"
     "Content-Type: text/plain\n"
-    "Cache-Control: no-store\n"
-    "\n"
-    "Date,Power\n");
-  p += len;
-  for (uint16_t i = 0; i < NV_LOG_MAX; i++) {
-    if (p - data > 1400) {
-      client.write(data, p - data);
-      p = data;
+    "Cache-Control: no-cache\n"
+    "ETag: %s\n"
+    "X-Last: %lld\n"
+    "Vary: Accept-Encoding\n"
+    "%s"
+    "\n", etag, count ? (long long)log.time : 0LL, gz ? "Content-Encoding: gzip\n" : "");
+  if (gz) {
+    client.write(out.data, out.p - out.data);
+    out.p = out.data;
+    gz->begin();
+  }
+  strcpy(out.p, "Date,Power\n");
+  out.p += strlen(out.p);
+  if (first && !logStore->read(first - 1, &prev))
+    prev.time = 0;
+  for (uint32_t i = first; i < count; i++) {
+    if (!logStore->read(i, &log))
+      continue;
+    // Deadband gaps shorter than the heartbeat held the previous value.
+    if (logStore->deadband() && cfg.flags & CFG_LOG_DEADBAND && prev.time && log.time - prev.time > period &&
+        log.time - prev.time <= logHeartbeat() + period) {
+      // Ahead of the first record it has no slot, the graph starts there.
+      if (points) {
+        if (i > first)
+          lttb.add(i - first - 1, log.time - period, prev.power);
+      } else
+        csvRow(&out, log.time - period, prev.power);
     }
-    if ((i + nvHeader.nvLogFirst) % NV_LOG_MAX == nvHeader.nvLogLast)
-      break;
-    fram.read(NV_LOG_OFFSET + ((i + nvHeader.nvLogFirst) % NV_LOG_MAX) * sizeof(struct nvLog), (uint8_t *)&log, sizeof(struct nvLog));
-    t = log.time;
-    tm = localtime(&t);
-    strftime(timestr, 20, "%F %T", tm);
-    len = snprintf(p, 1460 - (p - data), "%s,%.2f\n", timestr, log.power);
-    p += len;
-  }
-  if (p - data)
-    client.write(data, p - data);
+    prev = log;
+    if (points)
+      lttb.add(i - first, log.time, log.power);
+    else
+      csvRow(&out, log.time, log.power);
+  }
+  if (points)
+    lttb.end();
+  if (out.p - out.data)
+    out.client->write(out.data, out.p - out.data);
+  if (gz) {
+    gz->end();
+    delete gz;
+  }
   client.stop();
 }
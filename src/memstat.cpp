@@ -0,0 +1,185 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include <FastCRC.h>
+#include <stdint.h>
+
+#include "memstat.h"
+#include "scheduler.h"
+
+extern ESP8266WebServer web;
+extern Scheduler        timer;
+
+struct memSample          memLow = { 0, UINT16_MAX, UINT16_MAX, UINT16_MAX, 0 };
+volatile uint32_t         memAllocs;
+static struct memSample   history[MEM_HISTORY], period;
+static uint8_t            historyNext, historyCount;
+static uint16_t           ticks;
+static struct memUri      uris[MEM_URIS];
+static struct memRtc      rtc, prev;
+static bool               prevValid;
+
+/*
+ * Allocation counting.  The link wraps malloc and realloc (see build_flags)
+ * so String growth is counted along with everything else.
+ */
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+  memAllocs++;
+  return __real_malloc(size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+  memAllocs++;
+  return __real_realloc(ptr, size);
+}
+}
+
+static void
+lower(struct memSample *low, const struct memSample *s)
+{
+  low->uptime = s->uptime;
+  low->heap = min(low->heap, s->heap);
+  low->block = min(low->block, s->block);
+  low->stack = min(low->stack, s->stack);
+  low->frag = max(low->frag, s->frag);
+}
+
+// Pick up what the previous boot left in RTC memory.
+void
+memBegin(void)
+{
+  FastCRC16 CRC16;
+
+  ESP.rtcUserMemoryRead(MEM_RTC_BLOCK, (uint32_t *)&prev, sizeof(prev));
+  prevValid = prev.magic == MEM_MAGIC &&
+    prev.crc == CRC16.ccitt((uint8_t *)&prev, offsetof(struct memRtc, crc));
+  period = memLow;
+}
+
+/*
+ * Called after each web.handleClient() that allocated.  The count includes
+ * accepting and parsing the request as well as the handler.
+ */
+void
+memRequest(const char *uri, uint32_t allocs)
+{
+  struct memUri *u;
+
+  for (u = uris; u < uris + MEM_URIS - 1; u++)
+    if (!u->uri[0] || !strncmp(u->uri, uri, MEM_URI - 1))
+      break;
+  if (!u->uri[0]) {
+    strncpy(u->uri, u < uris + MEM_URIS - 1 ? uri : "other", MEM_URI - 1);
+    u->heapLow = UINT16_MAX;
+  }
+  u->requests++;
+  u->allocs += allocs;
+  u->allocsMax = max(u->allocsMax, (uint16_t)min(allocs, (uint32_t)UINT16_MAX));
+  u->heapLow = min(u->heapLow, (uint16_t)ESP.getFreeHeap());
+  strncpy(rtc.uri, uri, MEM_URI - 1);
+}
+
+// Called once a second.
+void
+memSample(void)
+{
+  FastCRC16         CRC16;
+  struct memSample  s;
+
+  s.uptime = millis() / 1000;
+  s.heap = ESP.getFreeHeap();
+  s.block = ESP.getMaxFreeBlockSize();
+  s.stack = ESP.getFreeContStack();
+  s.frag = ESP.getHeapFragmentation();
+  lower(&memLow, &s);
+  lower(&period, &s);
+  if (++ticks == MEM_PERIOD) {
+    ticks = 0;
+    history[historyNext] = period;
+    historyNext = (historyNext + 1) % MEM_HISTORY;
+    historyCount = min(historyCount + 1, MEM_HISTORY);
+    period = s;
+  }
+
+  rtc.magic = MEM_MAGIC;
+  rtc.last = s;
+  rtc.low = memLow;
+  rtc.allocs = memAllocs;
+  rtc.crc = CRC16.ccitt((uint8_t *)&rtc, offsetof(struct memRtc, crc));
+  ESP.rtcUserMemoryWrite(MEM_RTC_BLOCK, (uint32_t *)&rtc, sizeof(rtc));
+}
+
+static void
+printSample(WiFiClient &client, const struct memSample *s)
+{
+  client.printf("%8u %6u %6u %5u%% %6u\n", (unsigned)s->uptime, s->heap, s->block, s->frag, s->stack);
+}
+
+void
+handleMemStats(void)
+{
+  WiFiClient  client = web.client();
+
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-store\r\n\r\n");
+  client.printf("Reset: %s\n"
+    "Heap: %u free, %u max block, %u%% fragmented\n"
+    "Stack: %u free low water\n"
+    "Allocations: %u\n"
+    "Idle: %u%%, %u late deadlines\n"
+    "\n  uptime   heap  block  frag  stack\n",
+    ESP.getResetInfo().c_str(), (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxFreeBlockSize(),
+    ESP.getHeapFragmentation(), (unsigned)ESP.getFreeContStack(), (unsigned)memAllocs,
+    timer.idlePercent(), (unsigned)timer.late);
+  for (uint8_t i = 0; i < historyCount; i++)
+    printSample(client, &history[(historyNext + MEM_HISTORY - historyCount + i) % MEM_HISTORY]);
+  printSample(client, &period);
+  client.print("low water:\n");
+  printSample(client, &memLow);
+
+  if (prevValid) {
+    client.printf("before reset, after %s:\n", prev.uri[0] ? prev.uri : "no request");
+    printSample(client, &prev.last);
+    client.printf("low water, %u allocations:\n", (unsigned)prev.allocs);
+    printSample(client, &prev.low);
+  }
+
+  client.print("\nrequest                  count   allocs    max  heap low\n");
+  for (struct memUri *u = uris; u < uris + MEM_URIS && u->uri[0]; u++)
+    client.printf("%-23s %6u %8u %6u %9u\n", u->uri, (unsigned)u->requests, (unsigned)u->allocs,
+      u->allocsMax, u->heapLow);
+  client.stop();
+}
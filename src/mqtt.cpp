@@ -0,0 +1,281 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <PubSubClient.h>
+#include <WiFiClient.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cse7759b.h"
+#include "nvdata.h"
+#include "logstore.h"
+#include "states.h"
+#include "mqtt.h"
+
+extern uint8_t          state;
+bool setRelay(bool on);
+
+struct mqttStats        mqttStats;
+static WiFiClient       net;
+static PubSubClient    *mqtt = NULL;
+static char             base[STR32 + 8];    // "s31/<hostname>"
+static IPAddress        server;             // Broker address, unset until resolved.
+static time_t           sent = 0;           // Newest history row published.
+static bool             pending;            // More history than one batch.
+static uint32_t         lastTry, lastState, lastHistory;
+static bool             announce;
+
+static bool
+publish(const char *topic, const char *payload, bool retain)
+{
+  uint32_t  start = micros(), elapsed;
+  size_t    len = strlen(payload);
+  bool      ok = mqtt->publish(topic, (const uint8_t *)payload, len, retain);
+
+  elapsed = micros() - start;
+  if (ok) {
+    mqttStats.messages++;
+    mqttStats.bytes += len;
+    mqttStats.publishTotal += elapsed;
+    mqttStats.publishMax = max(mqttStats.publishMax, elapsed);
+  }
+  return ok;
+}
+
+static void
+publishState(void)
+{
+  char  topic[sizeof(base) + 8], payload[160];
+
+  snprintf(topic, sizeof(topic), "%s/state", base);
+  snprintf(payload, sizeof(payload),
+    "{\"time\":%lld,\"voltage\":%.2f,\"current\":%.3f,\"power\":%.2f,\"energy\":%.6lf,\"relay\":\"%s\"}",
+    (long long)time(NULL), voltage, current, power, energy, state & STATE_RELAY ? "ON" : "OFF");
+  publish(topic, payload, false);
+  lastState = millis();
+}
+
+/*
+ * Home Assistant discovery, retained so that it survives broker restarts.
+ * The sensors all read from the one state message.
+ */
+static void
+publishDiscovery(void)
+{
+  static const struct {
+    const char *id, *name, *unit, *devClass, *stateClass;
+  } sensors[] = {
+    { "voltage", "Voltage", "V", "voltage", "measurement" },
+    { "current", "Current", "A", "current", "measurement" },
+    { "power", "Power", "W", "power", "measurement" },
+    { "energy", "Energy", "kWh", "energy", "total_increasing" },
+  };
+  char  topic[96], payload[512], dev[128];
+
+  snprintf(dev, sizeof(dev),
+    "\"avty_t\":\"%s/status\",\"dev\":{\"ids\":[\"%s\"],\"name\":\"%s\",\"mf\":\"Sonoff\",\"mdl\":\"S31\"}",
+    base, cfg.hostname, cfg.hostname);
+  snprintf(topic, sizeof(topic), "homeassistant/switch/%s/relay/config", cfg.hostname);
+  snprintf(payload, sizeof(payload),
+    "{\"name\":\"Relay\",\"uniq_id\":\"%s_relay\",\"stat_t\":\"%s/state\",\"val_tpl\":\"{{value_json.relay}}\","
+    "\"cmd_t\":\"%s/relay/set\",%s}",
+    cfg.hostname, base, base, dev);
+  publish(topic, payload, true);
+  for (uint8_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++) {
+    snprintf(topic, sizeof(topic), "homeassistant/sensor/%s/%s/config", cfg.hostname, sensors[i].id);
+    snprintf(payload, sizeof(payload),
+      "{\"name\":\"%s\",\"uniq_id\":\"%s_%s\",\"stat_t\":\"%s/state\",\"val_tpl\":\"{{value_json.%s}}\","
+      "\"unit_of_meas\":\"%s\",\"dev_cla\":\"%s\",\"stat_cla\":\"%s\",%s}",
+      sensors[i].name, cfg.hostname, sensors[i].id, base, sensors[i].id,
+      sensors[i].unit, sensors[i].devClass, sensors[i].stateClass, dev);
+    publish(topic, payload, true);
+  }
+}
+
+/*
+ * Logged history is the offline queue: rows the broker hasn't had are sent
+ * from the log store, in FRAM if fitted, a batch per call so the loop isn't
+ * held up after a long outage.
+ */
+static void
+publishHistory(void)
+{
+  char          topic[sizeof(base) + 8], payload[MQTT_BATCH * 24];
+  struct nvLog  log;
+  time_t        last = sent;
+  uint32_t      first, i, n, rows = 0;
+  int           len = 0;
+
+  if (!logStore || (!pending && millis() - lastHistory < 1000))
+    return;
+  lastHistory = millis();
+  n = logStore->count();
+  first = logStore->since(sent);
+  for (i = first; i < n && len < (int)sizeof(payload) - 24; i++) {
+    if (!logStore->read(i, &log)) {
+      // Minutes with no sample are skipped, anything else ends the batch.
+      if (!logStore->gap(i))
+        break;
+      last = log.time;
+      continue;
+    }
+    len += snprintf(payload + len, sizeof(payload) - len, "%lld,%.1f\n", (long long)log.time, log.power);
+    last = log.time;
+    rows++;
+  }
+  if (len) {
+    snprintf(topic, sizeof(topic), "%s/history", base);
+    if (!publish(topic, payload, false))
+      return;
+  }
+  if (last == sent)
+    return;
+  mqttStats.rows += rows;
+  sent = last;
+  pending = i < n;
+  if (state & STATE_FRAM_PRESENT)
+    nvHeader.mqttSent = sent;
+}
+
+static void
+callback(char *topic, uint8_t *payload, unsigned int len)
+{
+  if (len == 2 && !memcmp(payload, "ON", 2))
+    setRelay(true);
+  else if (len == 3 && !memcmp(payload, "OFF", 3))
+    setRelay(false);
+  else if (len == 6 && !memcmp(payload, "TOGGLE", 6))
+    setRelay(~state & STATE_RELAY);
+  else
+    return;
+  publishState();
+}
+
+/*
+ * Connecting blocks the loop and with it the CSE7759B UART, so the broker is
+ * resolved on one pass and connected to on a later one, each with a short
+ * timeout.  A failed connect resolves the name again next time.
+ */
+static void
+reconnect(void)
+{
+  char      will[sizeof(base) + 8], topic[sizeof(base) + 12];
+  uint32_t  start = millis();
+  bool      ok;
+
+  lastTry = start;
+  if (!server.isSet()) {
+    if (WiFi.hostByName(cfg.mqttHost, server, MQTT_DNS) == 1) {
+      mqtt->setServer(server, cfg.mqttPort ? cfg.mqttPort : MQTT_PORT);
+      lastTry -= MQTT_RETRY;
+    } else
+      server = IPAddress();
+    mqttStats.connectMax = max(mqttStats.connectMax, (uint32_t)(millis() - start));
+    return;
+  }
+  snprintf(will, sizeof(will), "%s/status", base);
+  net.setTimeout(MQTT_CONNECT);
+  ok = mqtt->connect(cfg.hostname, cfg.mqttUser[0] ? cfg.mqttUser : NULL,
+    cfg.mqttUser[0] ? cfg.mqttPass : NULL, will, 0, true, "offline");
+  net.setTimeout(MQTT_SOCKET);
+  mqttStats.connectMax = max(mqttStats.connectMax, (uint32_t)(millis() - start));
+  if (!ok) {
+    server = IPAddress();
+    return;
+  }
+  mqttStats.connects++;
+  publish(will, "online", true);
+  snprintf(topic, sizeof(topic), "%s/relay/set", base);
+  mqtt->subscribe(topic);
+  announce = true;
+}
+
+void
+mqttBegin(void)
+{
+  struct nvLog  log;
+  uint32_t      heap = ESP.getFreeHeap();
+
+  if (mqtt) {
+    mqtt->disconnect();
+    delete mqtt;
+    mqtt = NULL;
+  }
+  if (!cfg.mqttHost[0])
+    return;
+
+  snprintf(base, sizeof(base), "s31/%s", cfg.hostname);
+  mqtt = new PubSubClient(net);
+  mqtt->setBufferSize(MQTT_BUFFER);
+  server = IPAddress();
+  mqtt->setCallback(callback);
+  mqtt->setSocketTimeout(2);
+  mqttStats.heap = heap - ESP.getFreeHeap();
+
+  // Don't back fill history logged before MQTT was set up.
+  sent = state & STATE_FRAM_PRESENT ? nvHeader.mqttSent : 0;
+  if (!sent && logStore && logStore->count() && logStore->read(logStore->count() - 1, &log))
+    sent = log.time;
+  pending = false;
+  lastTry = millis() - MQTT_RETRY;
+}
+
+// Called from loop().
+void
+mqttHandle(void)
+{
+  if (!mqtt || ~state & STATE_GOT_IP_ADDRESS)
+    return;
+  if (!mqtt->connected()) {
+    if (millis() - lastTry >= MQTT_RETRY)
+      reconnect();
+    return;
+  }
+  mqtt->loop();
+  if (announce) {
+    publishDiscovery();
+    publishState();
+    announce = false;
+  }
+  if (millis() - lastState >= (cfg.mqttPeriod ? cfg.mqttPeriod : MQTT_PERIOD) * 1000UL)
+    publishState();
+  publishHistory();
+}
+
+bool
+mqttConnected(void)
+{
+  return mqtt && mqtt->connected();
+}
+
+uint32_t
+mqttBacklog(void)
+{
+  return logStore ? logStore->count() - logStore->since(sent) : 0;
+}
@@ -0,0 +1,149 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <ESP8266WebServer.h>
+#include <new>
+#include <stdint.h>
+
+#include "config.h"
+#include "gzip.h"
+#include "page.h"
+
+extern struct config          cfg;
+extern ESP8266WebServer       web;
+
+static const char pageStatus[] PROGMEM =
+  "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nVary: Accept-Encoding\r\n";
+
+static const char pageHead[] PROGMEM =
+  "<html>"
+  "<head>\n"
+  "<style>body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }</style>"
+  "<link rel='icon' type='image/x-icon' href='/favicon.ico'>";
+
+static const char pageChecked[] PROGMEM = "checked";
+
+const __FlashStringHelper *
+checked(bool on)
+{
+  return FPSTR(on ? pageChecked : pageChecked + sizeof(pageChecked) - 1);
+}
+
+/*
+ * A refresh returns to the root page after that many seconds, and 'head' is
+ * added to the <head>.  When the client takes gzip the body goes through an
+ * encoder, if one fits in the heap.
+ */
+void
+Page::begin(uint8_t refresh, const __FlashStringHelper *head)
+{
+  if (gzipAccepted(web.header("Accept-Encoding").c_str()))
+    gz = new (std::nothrow) Gzip(client);
+  put(FPSTR(pageStatus));
+  if (gz) {
+    put(F("Content-Encoding: gzip\r\n\r\n"));
+    flush();
+    gz->begin();
+    sink = gz;
+  } else
+    put(F("\r\n"));
+  put(FPSTR(pageHead));
+  if (refresh)
+    (*this)(F("<meta http-equiv='Refresh' content='"), refresh, F("; url=/'>"));
+  if (head)
+    put(head);
+  (*this)(F("<title>"), cfg.hostname, F("</title>\n</head>\n<body>\n<h1>Switch "), cfg.hostname, F("</h1>"));
+}
+
+void
+Page::end(void)
+{
+  put(F("</body>\n</html>"));
+  flush();
+  if (gz) {
+    gz->end();
+    delete gz;
+    gz = NULL;
+  }
+  client.stop();
+}
+
+void
+Page::put(const char *s)
+{
+  size_t n = strlen(s), k;
+
+  while (n) {
+    room(1);
+    k = min(n, (size_t)(buf + sizeof(buf) - p));
+    memcpy(p, s, k);
+    p += k;
+    s += k;
+    n -= k;
+  }
+}
+
+void
+Page::put(const __FlashStringHelper *fs)
+{
+  PGM_P   s = (PGM_P)fs;
+  size_t  n = strlen_P(s), k;
+
+  while (n) {
+    room(1);
+    k = min(n, (size_t)(buf + sizeof(buf) - p));
+    memcpy_P(p, s, k);
+    p += k;
+    s += k;
+    n -= k;
+  }
+}
+
+void
+Page::put(struct pageFixed f)
+{
+  room(24);
+  p = fmtFixed(p, f.v, f.decimals);
+}
+
+void
+Page::put(struct pageTwo t)
+{
+  room(2);
+  *p++ = '0' + t.v / 10 % 10;
+  *p++ = '0' + t.v % 10;
+}
+
+void
+Page::flush(void)
+{
+  if (p > buf)
+    sink->write(buf, p - buf);
+  p = buf;
+}
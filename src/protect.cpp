@@ -0,0 +1,129 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cfgstore.h"
+#include "nvdata.h"
+#include "states.h"
+#include "protect.h"
+
+extern struct config    cfg;
+extern struct nvHeader  nvHeader;
+extern uint8_t          state;
+bool setRelay(bool on);
+void saveNvHeader(void);
+
+uint8_t                 protectReason = TRIP_NONE;
+uint16_t                protectLatency = 0;   // us, at most, from frame arrival to the relay opening.
+const char             *protectReasons[] = { "none", "overcurrent", "overpower" };
+static uint32_t         armed = 0;            // millis() when the relay last closed.
+static bool             unsaved = false;      // Trip latched in the config but not yet saved.
+
+// The trip is kept in the FRAM header if fitted, otherwise in the config.
+static void
+protectLatch(void)
+{
+  if (state & STATE_FRAM_PRESENT) {
+    nvHeader.trip = protectReason;
+    nvHeader.tripLatency = protectLatency;
+    saveNvHeader();
+  }
+  else {
+    cfg.trip = protectReason;
+    cfg.tripLatency = protectLatency;
+    unsaved = true;
+  }
+}
+
+// Save a trip latched in the config, away from the frame that tripped.
+void
+protectSave(void)
+{
+  if (unsaved) {
+    unsaved = false;
+    saveConfig();
+  }
+}
+
+// Start the inrush grace window, called as the relay closes.
+void
+protectArm(void)
+{
+  armed = millis();
+}
+
+void
+protectBegin(void)
+{
+  if (state & STATE_FRAM_PRESENT) {
+    protectReason = nvHeader.trip;
+    protectLatency = nvHeader.tripLatency;
+  }
+  else {
+    protectReason = cfg.trip;
+    protectLatency = cfg.tripLatency;
+  }
+}
+
+/*
+ * Called for every decoded frame with the earliest time its last byte can
+ * have arrived.  The latency so covers any time loop() spent elsewhere as
+ * well as the decode and the check, and is an upper bound: a frame behind
+ * a 250 ms MQTT or DNS wait reports that wait.  It saturates at 65535 us.
+ * The relay is opened before anything else is done, and without FRAM the
+ * config save is left to protectSave().
+ */
+void
+protectCheck(double i, double p, uint32_t frame)
+{
+  uint8_t reason;
+
+  if (~state & STATE_RELAY || millis() - armed < cfg.inrushMs)
+    return;
+
+  if (cfg.tripA > 0 && i > cfg.tripA)
+    reason = TRIP_CURRENT;
+  else if (cfg.tripW && p > cfg.tripW)
+    reason = TRIP_POWER;
+  else
+    return;
+
+  setRelay(false);
+  protectLatency = min((uint32_t)(micros() - frame), (uint32_t)UINT16_MAX);
+  protectReason = reason;
+  protectLatch();
+}
+
+void
+protectReset(void)
+{
+  protectReason = TRIP_NONE;
+  protectLatch();
+}
@@ -0,0 +1,197 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+#define RAMLOG_GAP    0         // Token for a minute with no sample.
+
+/*
+ * History for units without FRAM, one sample per RAMLOG_PERIOD.  A sample
+ * is its 0.1W value less the one before it in the block, zigzag encoded so
+ * small steps either way are small numbers, plus one so that 0 marks a
+ * gap, as a varint: seven bits a byte, the top bit set on all but the last.
+ * A step of under 6.4W takes a byte, up to 819W two and any other three,
+ * so a steady or cycling load keeps about 95 hours and the worst case 33.
+ * The buffer is a ring of RAMLOG_BLOCK byte blocks that each start from 0,
+ * so the oldest block can be dropped whole.  Sample times are implied by
+ * their distance from the newest sample.
+ */
+
+// Allocate early in setup() so the buffer comes from unfragmented heap.
+bool
+RamLog::begin(void)
+{
+  if (!(ring = (uint8_t *)malloc(RAMLOG_BYTES)))
+    return false;
+  counts = ring + RAMLOG_BLOCKS * RAMLOG_BLOCK;
+  return true;
+}
+
+static uint8_t
+encode(uint8_t *p, uint16_t v, uint16_t prev, bool gap)
+{
+  int32_t   d = (int32_t)v - prev;
+  uint32_t  code = gap ? RAMLOG_GAP : ((uint32_t)d << 1 ^ (uint32_t)(d >> 31)) + 1;
+  uint8_t   n = 0;
+
+  for (; code >= 0x80; code >>= 7)
+    p[n++] = code | 0x80;
+  p[n++] = code;
+  return n;
+}
+
+void
+RamLog::push(uint16_t v, bool gap)
+{
+  uint8_t   token[3], n = encode(token, v, prev, gap), newest;
+
+  if (!blocks || fill + n > RAMLOG_BLOCK) {
+    if (blocks == RAMLOG_BLOCKS) {
+      used -= counts[oldest];
+      oldest = (oldest + 1) % RAMLOG_BLOCKS;
+      blocks--;
+      cursor.valid = false;
+    }
+    counts[(oldest + blocks) % RAMLOG_BLOCKS] = 0;
+    blocks++;
+    fill = 0;
+    prev = 0;
+    n = encode(token, v, prev, gap);
+  }
+  newest = (oldest + blocks - 1) % RAMLOG_BLOCKS;
+  memcpy(ring + newest * RAMLOG_BLOCK + fill, token, n);
+  fill += n;
+  counts[newest]++;
+  used++;
+  if (!gap)
+    prev = v;
+}
+
+bool
+RamLog::append(const struct nvLog *log)
+{
+  time_t t = log->time - log->time % RAMLOG_PERIOD;
+
+  if (used && t <= last)
+    return false;
+
+  if (used) {
+    time_t gaps = min((time_t)RAMLOG_BLOCKS * RAMLOG_BLOCK, (t - last) / RAMLOG_PERIOD - 1);
+
+    while (gaps-- > 0)
+      push(0, true);
+  }
+  push(constrain(log->power, 0.0f, 6553.5f) * 10 + 0.5f, false);
+  last = t;
+  return true;
+}
+
+/*
+ * The i'th oldest sample, false for a gap.  Reads carry on from the last
+ * one, so walking the history in order decodes each sample once.
+ */
+bool
+RamLog::decode(uint32_t i, uint16_t *v)
+{
+  const uint8_t  *p;
+  uint32_t        code;
+  uint8_t         shift, b;
+
+  if (!cursor.valid || i < cursor.next) {
+    cursor.block = oldest;
+    cursor.first = 0;
+    cursor.valid = true;
+    cursor.at = 0;
+    cursor.prev = 0;
+    cursor.next = 0;
+  }
+  while (i >= cursor.first + counts[cursor.block]) {
+    cursor.first += counts[cursor.block];
+    cursor.block = (cursor.block + 1) % RAMLOG_BLOCKS;
+    cursor.at = 0;
+    cursor.prev = 0;
+    cursor.next = cursor.first;
+  }
+  p = ring + cursor.block * RAMLOG_BLOCK;
+  for (;;) {
+    for (code = 0, shift = 0; (b = p[cursor.at++]) & 0x80; shift += 7)
+      code |= (uint32_t)(b & 0x7f) << shift;
+    code |= (uint32_t)b << shift;
+    if (code != RAMLOG_GAP)
+      cursor.prev += (int32_t)((code - 1) >> 1) ^ -(int32_t)((code - 1) & 1);
+    if (cursor.next++ == i)
+      break;
+  }
+  *v = cursor.prev;
+  return code != RAMLOG_GAP;
+}
+
+// Read the i'th oldest sample, returns false for a gap but still sets its time.
+bool
+RamLog::read(uint32_t i, struct nvLog *log)
+{
+  uint16_t v;
+
+  log->time = last - (time_t)(used - 1 - i) * RAMLOG_PERIOD;
+  if (!decode(i, &v))
+    return false;
+  log->power = v / 10.0f;
+  return true;
+}
+
+bool
+RamLog::gap(uint32_t i)
+{
+  uint16_t v;
+
+  return i < used && !decode(i, &v);
+}
+
+// Samples held at the density so far, a byte each until there are some.
+uint32_t
+RamLog::capacity(void)
+{
+  uint32_t bytes = blocks ? (blocks - 1) * RAMLOG_BLOCK + fill : 0;
+
+  return bytes ? (uint64_t)used * RAMLOG_BLOCKS * RAMLOG_BLOCK / bytes : RAMLOG_BLOCKS * RAMLOG_BLOCK;
+}
+
+// Sample times are implied, no search needed.
+uint32_t
+RamLog::since(time_t since)
+{
+  time_t first = last - (time_t)(used - 1) * RAMLOG_PERIOD;
+
+  if (!used || since < first)
+    return 0;
+  return min((time_t)used, (since - first) / RAMLOG_PERIOD + 1);
+}
@@ -0,0 +1,93 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "scheduler.h"
+
+bool
+Scheduler::setInterval(uint32_t ms, void (*fn)(void))
+{
+  if (count == TIMER_TASKS || !ms)
+    return false;
+  tasks[count++] = { fn, ms, (uint32_t)(millis() + ms) };
+  return true;
+}
+
+// Run what is due.  A task that fell a whole period behind starts afresh.
+void
+Scheduler::run(void)
+{
+  for (struct task *t = tasks; t < tasks + count; t++) {
+    uint32_t now = millis();
+
+    if ((int32_t)(now - t->due) < 0)
+      continue;
+    t->fn();
+    t->due += t->period;
+    if ((int32_t)(now - t->due) >= 0) {
+      late++;
+      t->due = now + t->period;
+    }
+  }
+}
+
+// Milliseconds until the next deadline, 0 if one has passed.
+uint32_t
+Scheduler::next(void) const
+{
+  uint32_t  now = millis(), wait = UINT32_MAX;
+
+  for (const struct task *t = tasks; t < tasks + count; t++) {
+    int32_t left = t->due - now;
+
+    if (left <= 0)
+      return 0;
+    wait = min(wait, (uint32_t)left);
+  }
+  return wait;
+}
+
+/*
+ * Give the time to the SDK, which lets the radio doze between beacons,
+ * and keep count of it.
+ */
+void
+Scheduler::idle(uint32_t ms)
+{
+  uint32_t  start = micros();
+
+  if (ms)
+    delay(ms);
+  windowIdle += micros() - start;
+  if (micros() - windowStart >= TIMER_WINDOW * 1000UL) {
+    percent = (uint64_t)windowIdle * 100 / (micros() - windowStart);
+    windowStart = micros();
+    windowIdle = 0;
+  }
+}
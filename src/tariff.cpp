@@ -0,0 +1,147 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "states.h"
+#include "tariff.h"
+
+extern struct config    cfg;
+extern struct nvHeader  nvHeader;
+extern uint8_t          state;
+
+uint8_t         tariffBand = 0;
+uint32_t        tariffUnknown = 0;  // Pulses counted before the clock was set.
+static time_t   bandStart = 0;      // Band valid from bandStart...
+static time_t   bandEnd = 0;        // ...until bandEnd.
+
+/*
+ * Find the band in force at minute-of-day 'minute' on 'wday'.  Before the
+ * first switch point of a day the last band of the preceding day applies.
+ */
+static uint8_t
+bandAt(int wday, int minute)
+{
+  for (int d = 0; d < 8; d++) {
+    const struct tariff *t = cfg.tariff[(wday + 7 - d % 7) % 7];
+    int best = -1;
+    uint8_t band = 0;
+
+    for (int i = 0; i < TARIFF_POINTS; i++) {
+      int at = t[i].h * 60 + t[i].m;
+
+      if (~t[i].flags & TARIFF_ENABLED || at > minute || at < best)
+        continue;
+      best = at;
+      band = t[i].flags & TARIFF_BAND_MASK;
+    }
+    if (best >= 0)
+      return band;
+    minute = 24 * 60;
+  }
+  return 0;
+}
+
+/*
+ * Work out the current band and the epoch at which it next changes, so the
+ * per-frame path only compares against bandEnd.
+ */
+static void
+findBand(time_t now)
+{
+  struct tm tm = *localtime(&now);
+  int       minute = tm.tm_hour * 60 + tm.tm_min;
+
+  tariffBand = bandAt(tm.tm_wday, minute);
+  bandStart = now;
+  bandEnd = now + 86400;
+
+  for (int d = 0; d < 8; d++) {
+    const struct tariff *t = cfg.tariff[(tm.tm_wday + d) % 7];
+    int next = 24 * 60;
+
+    for (int i = 0; i < TARIFF_POINTS; i++) {
+      int at = t[i].h * 60 + t[i].m;
+
+      if (t[i].flags & TARIFF_ENABLED && at > minute && at < next)
+        next = at;
+    }
+    if (next < 24 * 60) {
+      struct tm b = tm;
+
+      b.tm_mday += d;
+      b.tm_hour = next / 60;
+      b.tm_min = next % 60;
+      b.tm_sec = 0;
+      b.tm_isdst = -1;
+      bandEnd = mktime(&b);
+      if (bandEnd <= now)
+        bandEnd = now + 60;
+      break;
+    }
+    minute = -1;
+  }
+}
+
+void
+tariffAddPulses(uint32_t pulses)
+{
+  time_t now;
+
+  if (~cfg.flags & CFG_TARIFF)
+    return;
+
+  // Without the time there's no telling which band they fell in.
+  if (~state & STATE_NTP_GOT_TIME) {
+    tariffUnknown += pulses;
+    return;
+  }
+
+  now = time(NULL);
+  if (now >= bandEnd || now < bandStart)
+    findBand(now);
+
+  nvHeader.tariffPulses[tariffBand] += pulses;
+}
+
+void
+tariffReset(void)
+{
+  memset(nvHeader.tariffPulses, '\0', sizeof(nvHeader.tariffPulses));
+  tariffUnknown = 0;
+}
+
+// Force the band to be recalculated on the next frame.
+void
+tariffUpdate(void)
+{
+  bandStart = bandEnd = 0;
+}
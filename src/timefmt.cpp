@@ -0,0 +1,231 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "timefmt.h"
+
+#define WEEK  (7 * 86400)
+#define YEAR  53          // Weeks to search for a zone transition.
+
+/*
+ * The UTC offset is constant between zone transitions.  Cache the offset and
+ * the span it applies to so that formatting a time is integer arithmetic,
+ * localtime() is only consulted when a time falls outside the cached span.
+ */
+static time_t   zoneStart = 0, zoneEnd = 0;
+static int32_t  zoneOffset;
+
+static const char digits2[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+static int32_t
+daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = y - era * 400;
+  uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+static void
+civilFromDays(int32_t z, int32_t *y, uint32_t *m, uint32_t *d)
+{
+  z += 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = z - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int32_t
+offsetAt(time_t t)
+{
+  struct tm *tm = localtime(&t);
+
+  return daysFromCivil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday) * 86400LL +
+    tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec - t;
+}
+
+/*
+ * Step a week at a time from 'from' in direction 'dir' until the offset
+ * changes, then bisect to the second.  Returns the last time with the
+ * offset 'off', or the search limit if there is no transition.
+ */
+static time_t
+zoneEdge(time_t from, int32_t off, int dir)
+{
+  time_t in = from, out;
+
+  for (int i = 0; i < YEAR; i++) {
+    out = in + dir * WEEK;
+    if (offsetAt(out) != off) {
+      while (out - in > 1 || in - out > 1) {
+        time_t mid = in + (out - in) / 2;
+
+        if (offsetAt(mid) == off)
+          in = mid;
+        else
+          out = mid;
+      }
+      return in;
+    }
+    in = out;
+  }
+  return in;
+}
+
+static void
+findZone(time_t t)
+{
+  zoneOffset = offsetAt(t);
+  zoneStart = zoneEdge(t, zoneOffset, -1);
+  zoneEnd = zoneEdge(t, zoneOffset, 1);
+}
+
+// Forget the cached zone, call when the timezone changes.
+void
+fmtReset(void)
+{
+  zoneStart = zoneEnd = 0;
+}
+
+static inline char *
+put2(char *p, uint32_t v)
+{
+  memcpy(p, &digits2[v * 2], 2);
+  return p + 2;
+}
+
+static char *
+putu(char *p, uint32_t v)
+{
+  char  buf[10], *q = buf + sizeof(buf);
+
+  while (v >= 100) {
+    q -= 2;
+    memcpy(q, &digits2[(v % 100) * 2], 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    q -= 2;
+    memcpy(q, &digits2[v * 2], 2);
+  }
+  else
+    *--q = '0' + v;
+
+  memcpy(p, q, buf + sizeof(buf) - q);
+  return p + (buf + sizeof(buf) - q);
+}
+
+// Format 't' as local "YYYY-MM-DD HH:MM:SS", the same as strftime("%F %T").
+char *
+fmtTime(char *p, time_t t)
+{
+  int32_t   y, days, secs;
+  uint32_t  m, d;
+
+  if (t < zoneStart || t > zoneEnd || zoneStart == zoneEnd)
+    findZone(t);
+
+  t += zoneOffset;
+  days = t / 86400;
+  secs = t % 86400;
+  if (secs < 0) {
+    secs += 86400;
+    days--;
+  }
+  civilFromDays(days, &y, &m, &d);
+
+  p = put2(p, y / 100);
+  p = put2(p, y % 100);
+  *p++ = '-';
+  p = put2(p, m);
+  *p++ = '-';
+  p = put2(p, d);
+  *p++ = ' ';
+  p = put2(p, secs / 3600);
+  *p++ = ':';
+  p = put2(p, secs / 60 % 60);
+  *p++ = ':';
+  return put2(p, secs % 60);
+}
+
+// Format 'v' rounded to 'decimals' places like printf("%.*f"), halves to even.
+char *
+fmtFixed(char *p, double v, uint8_t decimals)
+{
+  uint32_t  scale = 1;
+  uint64_t  n;
+  double    x;
+
+  for (uint8_t i = 0; i < decimals; i++)
+    scale *= 10;
+
+  if (v < 0) {
+    v = -v;
+    if (v * scale > 0.5)
+      *p++ = '-';
+  }
+  x = v * scale;
+  n = (uint64_t)x;
+  if (x - n > 0.5 || (x - n == 0.5 && n & 1))
+    n++;
+
+  p = putu(p, n / scale);
+  if (decimals) {
+    uint32_t  frac = n % scale;
+
+    *p++ = '.';
+    for (uint8_t i = decimals; i; i--) {
+      p[i - 1] = '0' + frac % 10;
+      frac /= 10;
+    }
+    p += decimals;
+  }
+  return p;
+}
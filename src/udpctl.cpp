@@ -0,0 +1,219 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "cse7759b.h"
+#include "protect.h"
+#include "states.h"
+#include "udpproto.h"
+#include "udpctl.h"
+
+#define UDP_SUBSCRIBERS   4
+#define UDP_SENDERS       8       // Addresses remembered for replay checks.
+
+extern uint8_t          state;
+bool setRelay(bool on);
+
+static WiFiUDP          udp;
+static uint64_t         key[2];
+static bool             enabled = false;
+static uint16_t         cpu = 0;
+static struct {
+  IPAddress   ip;
+  uint16_t    port;
+  uint16_t    period;
+  uint32_t    nonce;
+  uint32_t    next;               // millis() of the next push.
+  uint32_t    expires;
+} subs[UDP_SUBSCRIBERS];
+static struct {
+  IPAddress   ip;
+  uint32_t    time;               // Newest request accepted, 0 for a free slot,
+  uint32_t    nonce;              // and its nonce.
+  uint32_t    used;               // millis() it arrived.
+} senders[UDP_SENDERS];
+
+void
+udpBegin(void)
+{
+  if (enabled)
+    udp.stop();
+  enabled = cfg.udpKey[0] != '\0';
+  for (uint8_t i = 0; i < UDP_SUBSCRIBERS; i++)
+    subs[i].period = 0;
+  if (!enabled)
+    return;
+  udpKey(cfg.udpKey, key);
+  udp.begin(UDP_PORT);
+}
+
+static void
+udpSend(IPAddress ip, uint16_t port, uint8_t op, uint8_t result, uint32_t nonce)
+{
+  struct udpStatus  s;
+
+  s.magic = UDP_MAGIC;
+  s.version = UDP_VERSION;
+  s.op = op;
+  s.result = result;
+  s.nonce = nonce;
+  s.time = time(NULL);
+  s.state = state;
+  s.trip = protectReason;
+  s.cpu = cpu;
+  s.voltage = voltage;
+  s.current = current;
+  s.power = power;
+  s.energy = energy;
+  udpSeal(&s, sizeof(s), key);
+  udp.beginPacket(ip, port);
+  udp.write((const uint8_t *)&s, sizeof(s));
+  udp.endPacket();
+}
+
+/*
+ * Each sender's requests must come in (time, nonce) order, so a captured
+ * request is stale as soon as a newer one has arrived.  A sender is only
+ * forgotten once quiet for twice UDP_SKEW, when its old requests fail the
+ * clock check.  Without NTP time there is no clock check, and a request can
+ * be replayed after its sender has been forgotten.
+ */
+static bool
+udpFresh(const struct udpRequest *r)
+{
+  IPAddress ip = udp.remoteIP();
+  int32_t   skew = r->time - (uint32_t)time(NULL);
+  uint32_t  now = millis();
+  uint8_t   i, lru = 0;
+
+  if (state & STATE_NTP_GOT_TIME && (skew > UDP_SKEW || skew < -UDP_SKEW))
+    return false;
+  for (i = 0; i < UDP_SENDERS; i++) {
+    if (senders[i].time && senders[i].ip == ip)
+      break;
+    if (senders[lru].time && (!senders[i].time || now - senders[i].used > now - senders[lru].used))
+      lru = i;
+  }
+  if (i < UDP_SENDERS) {
+    if (!udpNewer(r->time, r->nonce, senders[i].time, senders[i].nonce))
+      return false;
+  } else {
+    if (senders[lru].time && now - senders[lru].used < 2 * UDP_SKEW * 1000)
+      return false;
+    i = lru;
+    senders[i].ip = ip;
+  }
+  senders[i].time = r->time;
+  senders[i].nonce = r->nonce;
+  senders[i].used = now;
+  return true;
+}
+
+static uint8_t
+udpSubscribe(const struct udpRequest *r)
+{
+  IPAddress ip = udp.remoteIP();
+  uint16_t  port = udp.remotePort();
+  int8_t    slot = -1;
+
+  for (uint8_t i = 0; i < UDP_SUBSCRIBERS; i++) {
+    if (subs[i].period && subs[i].ip == ip && subs[i].port == port) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 && (!subs[i].period || (int32_t)(millis() - subs[i].expires) >= 0))
+      slot = i;
+  }
+  if (slot < 0)
+    return UDP_ERR_FULL;
+  subs[slot].ip = ip;
+  subs[slot].port = port;
+  subs[slot].period = r->arg;
+  subs[slot].nonce = r->nonce;
+  subs[slot].next = millis() + r->arg * 1000;
+  subs[slot].expires = millis() + UDP_SUB_TTL * 1000;
+  return UDP_OK;
+}
+
+/*
+ * Called from loop().  Unauthenticated, malformed and stale requests are
+ * dropped without a reply.
+ */
+void
+udpHandle(void)
+{
+  struct udpRequest r;
+  uint32_t          start, now;
+  uint8_t           result = UDP_OK;
+
+  if (!enabled)
+    return;
+
+  now = millis();
+  for (uint8_t i = 0; i < UDP_SUBSCRIBERS; i++) {
+    if (!subs[i].period)
+      continue;
+    if ((int32_t)(now - subs[i].expires) >= 0)
+      subs[i].period = 0;
+    else if ((int32_t)(now - subs[i].next) >= 0) {
+      subs[i].next += subs[i].period * 1000;
+      udpSend(subs[i].ip, subs[i].port, UDP_OP_PUSH, UDP_OK, subs[i].nonce);
+    }
+  }
+
+  if (udp.parsePacket() != sizeof(r))
+    return;
+  start = micros();
+  udp.read((uint8_t *)&r, sizeof(r));
+  if (r.magic != UDP_MAGIC || r.version != UDP_VERSION || !udpVerify(&r, sizeof(r), key) || !udpFresh(&r))
+    return;
+
+  switch (r.op) {
+    case UDP_OP_STATUS:
+      break;
+    case UDP_OP_SET:
+      if (!setRelay(r.arg))
+        result = UDP_ERR_HELD;
+      break;
+    case UDP_OP_TOGGLE:
+      if (!setRelay(~state & STATE_RELAY))
+        result = UDP_ERR_HELD;
+      break;
+    case UDP_OP_SUBSCRIBE:
+      result = udpSubscribe(&r);
+      break;
+    default:
+      result = UDP_ERR_OP;
+  }
+  udpSend(udp.remoteIP(), udp.remotePort(), r.op, result, r.nonce);
+  cpu = min((uint32_t)(micros() - start), (uint32_t)UINT16_MAX);
+}
@@ -0,0 +1,219 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "states.h"
+#include "wlan.h"
+
+extern struct config    cfg;
+extern uint8_t          state;
+
+struct wlanStats        wlanStats;
+const uint16_t          wlanBuckets[WLAN_BUCKETS - 1] = { 1, 2, 5, 10, 30, 60, 300 };   // Seconds.
+static WiFiEventHandler eventConnected, eventDisconnected, eventGotIP;
+static uint8_t          phase = WLAN_CONNECTING;
+static uint8_t          failures;       // Since the last address.
+static uint32_t         since;          // Start of the attempt or the wait.
+static uint32_t         backoff;
+static uint32_t         lostAt;
+static bool             lost;
+static uint8_t          hintBssid[6], hintChannel;
+static bool             hint;
+
+static uint8_t
+reasonIndex(uint8_t reason)
+{
+  if (reason >= 1 && reason <= 24)
+    return reason;
+  if (reason >= 200 && reason <= 204)
+    return reason - 200 + 25;
+  return 0;
+}
+
+uint8_t
+wlanReason(uint8_t i)
+{
+  return i > 24 ? i - 25 + 200 : i;
+}
+
+// resetConfig() leaves "none" for a plug that was never set up.
+static bool
+configured(void)
+{
+  return *cfg.ssid && strcmp(cfg.ssid, "none");
+}
+
+/*
+ * The first attempt after losing an established link goes straight to the
+ * access point it was on; later ones scan in case it has moved channel.
+ */
+static void
+attempt(void)
+{
+  wlanStats.attempts++;
+  if (hint && !failures)
+    WiFi.begin(cfg.ssid, cfg.psk, hintChannel, hintBssid);
+  else
+    WiFi.begin(cfg.ssid, cfg.psk);
+  phase = WLAN_CONNECTING;
+  since = millis();
+}
+
+static void
+fallback(void)
+{
+  if (WiFi.getMode() & WIFI_AP)
+    return;
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(NAME, "");
+  wlanStats.fallbacks++;
+}
+
+// Half to all of limit, so that a room of plugs does not retry in step.
+static void
+wait(uint32_t limit)
+{
+  backoff = limit / 2 + ESP.random() % (limit / 2 + 1);
+  phase = WLAN_BACKOFF;
+  since = millis();
+  // Stop the SDK retrying on its own meanwhile, keeping its credentials.
+  WiFi.disconnect(false, false);
+}
+
+static void
+fail(void)
+{
+  if (failures < UINT8_MAX)
+    failures++;
+  if (failures == WLAN_BUDGET)
+    fallback();
+  wait(min((uint32_t)WLAN_BACKOFF_MAX, (uint32_t)WLAN_BACKOFF_MIN << min(failures - 1, 7)));
+}
+
+/*
+ * The SDK reconnects by itself as fast as it can, which during an outage
+ * keeps the radio and the CPU busy.  Take that over and space the attempts.
+ */
+void
+wlanBegin(void)
+{
+  if (!eventGotIP) {
+    eventConnected = WiFi.onStationModeConnected([](const WiFiEventStationModeConnected& event) {
+      memcpy(hintBssid, event.bssid, sizeof(hintBssid));
+      hintChannel = event.channel;
+      hint = true;
+    });
+    eventGotIP = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP& event) {
+      uint32_t  elapsed = millis() - lostAt;
+      uint8_t   i;
+
+      state |= STATE_GOT_IP_ADDRESS;
+      phase = WLAN_CONNECTED;
+      failures = 0;
+      backoff = 0;
+      if (lost) {
+        for (i = 0; i < WLAN_BUCKETS - 1 && elapsed >= wlanBuckets[i] * 1000UL; i++)
+          ;
+        wlanStats.reconnects[i]++;
+        wlanStats.reconnectLast = elapsed;
+        wlanStats.reconnectMax = max(wlanStats.reconnectMax, elapsed);
+        lost = false;
+      }
+    });
+    // Only a disconnect of our own making is expected while backing off.
+    eventDisconnected = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected& event) {
+      state &= ~STATE_GOT_IP_ADDRESS;
+      if (phase == WLAN_BACKOFF)
+        return;
+      wlanStats.reason = event.reason;
+      wlanStats.reasons[reasonIndex(event.reason)]++;
+      if (phase == WLAN_CONNECTED) {
+        wlanStats.disconnects++;
+        lostAt = millis();
+        lost = true;
+        wait(WLAN_BACKOFF_MIN);
+      }
+      else
+        fail();
+    });
+  }
+
+  WiFi.setAutoReconnect(false);
+  WiFi.hostname(cfg.hostname);
+  failures = 0;
+  hint = false;
+  if (configured())
+    attempt();
+  else
+    fallback();
+}
+
+void
+wlanHandle(void)
+{
+  if (!configured())
+    return;
+  if (phase == WLAN_CONNECTING && millis() - since >= WLAN_ATTEMPT)
+    fail();
+  else if (phase == WLAN_BACKOFF && millis() - since >= backoff && ~state & STATE_OTA_OR_REBOOT)
+    attempt();
+  else if (phase == WLAN_CONNECTED && WiFi.getMode() == WIFI_AP_STA) {
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+  }
+}
+
+uint8_t
+wlanState(void)
+{
+  return phase;
+}
+
+uint8_t
+wlanFailures(void)
+{
+  return failures;
+}
+
+// Left of the current wait.
+uint32_t
+wlanBackoff(void)
+{
+  return phase == WLAN_BACKOFF ? backoff - min(backoff, (uint32_t)(millis() - since)) : 0;
+}
+
+const uint8_t *
+wlanHint(uint8_t *channel)
+{
+  *channel = hintChannel;
+  return hint ? hintBssid : NULL;
+}
@@ -0,0 +1,200 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Models saving the config through src/cfgstore.cpp on each store it can
+ * use, for what a commit costs and what a power cut during one leaves.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o cfgsim tools/cfgsim.cpp src/cfgstore.cpp
+ *
+ *   cfgsim [-n saves] [-s seed]
+ *
+ * Each store starts from a config in the EEPROM sector, as an older
+ * firmware left it, and boots as setup() does, moving it into the slots.
+ * Then come -n saves (default 1000) each changing a field, and half of
+ * them lose power at a random byte of what they write.  After each save
+ * the plug reboots and the config loaded must be the new one, or the old
+ * one if the power was cut.  Anything else is corrupt and the exit status
+ * is non-zero, except for the EEPROM store, which is there to show what
+ * saving used to do.  Last the LittleFS files are deleted, as uploading a
+ * filesystem image does, and the config must survive that too.  The costs
+ * of the parts are in the host headers.
+ */
+
+#include <random>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <FRAM.h>
+#include <LittleFS.h>
+
+#include "config.h"
+#include "cfgstore.h"
+#include "nvdata.h"
+#include "states.h"
+
+#define SIGNATURE 0x1a2b3b56    // As main.cpp has it.
+#define FRAM_SIZE 32768
+
+struct cut {};
+
+struct config     cfg;
+struct nvHeader   nvHeader;
+FRAM32            fram;
+uint8_t           state;
+
+static std::mt19937 rng;
+static uint32_t   budget, written;
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: cfgsim [-n saves] [-s seed]\n");
+  exit(2);
+}
+
+static void
+count(void)
+{
+  written++;
+}
+
+static void
+power(void)
+{
+  if (!budget--)
+    throw cut();
+}
+
+static void
+boot(uint8_t store)
+{
+  memset(&cfg, 0x5a, sizeof(cfg));
+  memset(&cfgStats, 0, sizeof(cfgStats));
+  state = store == CFG_STORE_FRAM ? STATE_FRAM_PRESENT : 0;
+  nvHeader.size = FRAM_SIZE;
+  if (!cfgLoad(store == CFG_STORE_FS) && cfg.signature == SIGNATURE)
+    saveConfig();
+}
+
+static bool
+run(uint8_t store, uint32_t saves)
+{
+  struct config   want, prev;
+  uint32_t        cuts = 0, old = 0, lost = 0, bad = 0, done = 0, bytes;
+  uint64_t        sum = 0, max = 0, start;
+  bool            wiped;
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.signature = SIGNATURE;
+  strcpy(cfg.hostname, "s31");
+  memset(EEPROM.flash, 0xff, sizeof(EEPROM.flash));
+  memcpy(EEPROM.flash, &cfg, sizeof(cfg));
+  memset(fram.mem, 0, sizeof(fram.mem));
+  LittleFS.files.clear();
+  boot(store);
+
+  start = hostUs;
+  saveConfig();
+  start = hostUs - start;
+
+  // What a save writes, which is the same every time.
+  cfg.tripW = 1;
+  hostPersist = count;
+  written = 0;
+  saveConfig();
+  bytes = written;
+
+  for (uint32_t v = 1; v <= saves; v++) {
+    bool  lostPower = false;
+
+    prev = cfg;
+    snprintf(cfg.hostname, sizeof(cfg.hostname), "s31-%u", (unsigned)v);
+    want = cfg;
+
+    hostPersist = power;
+    budget = rng() % 2 ? std::uniform_int_distribution<uint32_t>(0, bytes - 1)(rng) : UINT32_MAX;
+    try {
+      saveConfig();
+      sum += cfgStats.commitLast;
+      max = std::max(max, (uint64_t)cfgStats.commitLast);
+      done++;
+    }
+    catch (const cut &) {
+      lostPower = true;
+      cuts++;
+    }
+    hostPersist = NULL;
+
+    boot(store);
+    if (!memcmp(&cfg, &want, sizeof(cfg)))
+      continue;
+    if (!memcmp(&cfg, &prev, sizeof(cfg)))
+      lostPower ? old++ : lost++;
+    else
+      bad++;
+    // Set it again, as whoever saved it would.
+    cfg = want;
+    saveConfig();
+  }
+
+  // An uploaded filesystem image takes the LittleFS slots with it.
+  want = cfg;
+  LittleFS.files.clear();
+  boot(store);
+  wiped = memcmp(&cfg, &want, sizeof(cfg));
+
+  printf("%-8s %6.0f us a commit, %6u worst, %u us unchanged, %4u bytes; %u cut, %u kept the old config, %u lost, %u corrupt%s\n",
+    cfgStores[store], done ? (double)sum / done : 0, (unsigned)max, (unsigned)start, (unsigned)bytes, (unsigned)cuts,
+    (unsigned)old, (unsigned)lost, (unsigned)bad, wiped ? ", lost to a new filesystem" : "");
+  return !wiped && (store == CFG_STORE_EEPROM || (!lost && !bad));
+}
+
+int
+main(int argc, char **argv)
+{
+  uint32_t  saves = 1000;
+  int       ch;
+  bool      ok = true;
+
+  while ((ch = getopt(argc, argv, "n:s:")) != -1) {
+    switch (ch) {
+      case 'n': saves = atoi(optarg); break;
+      case 's': rng.seed(atoi(optarg)); break;
+      default: usage();
+    }
+  }
+  ok &= run(CFG_STORE_EEPROM, saves);
+  ok &= run(CFG_STORE_FS, saves);
+  ok &= run(CFG_STORE_FRAM, saves);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Checks fmtTime() and fmtFixed() against the localtime(), strftime() and
+ * printf() path they replaced in handleNvData() and times both.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o fmtbench tools/fmtbench.cpp src/timefmt.cpp
+ *
+ *   fmtbench [-n rows] [-s seconds] [-z tz]
+ *
+ * Formats -n rows (default 200000) -s seconds apart (default 97, so that the
+ * rows walk through the DST changes) as history CSV lines in zone -z
+ * (default EST5EDT,M3.2.0,M11.1.0), reporting any line that differs, then
+ * the rows per second for each path.  The exit status is non-zero on a
+ * mismatch.
+ */
+
+#include <chrono>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timefmt.h"
+
+#define ROWS    200000
+#define STEP    97
+#define ZONE    "EST5EDT,M3.2.0,M11.1.0"
+#define START   1700000000
+
+static volatile size_t  sink;
+
+static double
+nowS(void)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: fmtbench [-n rows] [-s seconds] [-z tz]\n");
+  exit(2);
+}
+
+// Power readings with a spread of magnitudes and the odd negative one.
+static float
+powerAt(int i)
+{
+  return (i % 3000) * 1.37f - (i % 7 ? 0 : 5.0f);
+}
+
+static size_t
+oldRow(char *buf, time_t t, float power)
+{
+  char  ts[20];
+
+  strftime(ts, sizeof(ts), "%F %T", localtime(&t));
+  return snprintf(buf, 64, "%s,%.2f\n", ts, power);
+}
+
+static size_t
+newRow(char *buf, time_t t, float power)
+{
+  char *p = fmtTime(buf, t);
+
+  *p++ = ',';
+  p = fmtFixed(p, power, 2);
+  *p++ = '\n';
+  *p = '\0';
+  return p - buf;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char  *zone = ZONE;
+  char         a[64], b[64];
+  double       start, old, fast;
+  time_t       first;
+  int          ch, rows = ROWS, step = STEP, bad = 0;
+
+  while ((ch = getopt(argc, argv, "n:s:z:")) != -1) {
+    switch (ch) {
+      case 'n': rows = atoi(optarg); break;
+      case 's': step = atoi(optarg); break;
+      case 'z': zone = optarg; break;
+      default: usage();
+    }
+  }
+  if (rows <= 0 || step <= 0)
+    usage();
+  setenv("TZ", zone, 1);
+  tzset();
+  first = START - (time_t)rows * step / 2;
+
+  for (int i = 0; i < rows; i++) {
+    time_t t = first + (time_t)i * step;
+
+    oldRow(a, t, powerAt(i));
+    newRow(b, t, powerAt(i));
+    if (strcmp(a, b) && bad++ < 10)
+      printf("mismatch at %lld: %.*s | %.*s\n", (long long)t,
+        (int)strlen(a) - 1, a, (int)strlen(b) - 1, b);
+  }
+  printf("%d rows over %.1f days, %d mismatched\n", rows, (double)rows * step / 86400, bad);
+
+  start = nowS();
+  for (int i = 0; i < rows; i++)
+    sink += oldRow(a, first + (time_t)i * step, powerAt(i));
+  old = nowS() - start;
+  fmtReset();
+  start = nowS();
+  for (int i = 0; i < rows; i++)
+    sink += newRow(b, first + (time_t)i * step, powerAt(i));
+  fast = nowS() - start;
+
+  printf("localtime/strftime/printf: %.0f rows/s\n", rows / old);
+  printf("fmtTime/fmtFixed:          %.0f rows/s, %.1fx\n", rows / fast, old / fast);
+  return bad ? 1 : 0;
+}
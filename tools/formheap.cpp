@@ -0,0 +1,424 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Models what saving the settings does to the heap, through the raw body
+ * decoder the save handlers use, formDecode() over the server's parsed
+ * arguments, and lookups that copy a String per field as the handlers did
+ * before the field tables.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o formheap tools/formheap.cpp src/form.cpp
+ *
+ *   formheap [-n saves] [-a bytes] [-s seed]
+ *
+ * The heap is a first-fit arena of -a bytes (default 24576, about what the
+ * firmware has free) standing in for umm_malloc.  Each of -n saves (default
+ * 10000) takes turns at the config, schedule and tariff forms and a JSON
+ * PUT of the whole config.  For the argument paths the server reads the
+ * body and parses it into Strings in the arena, while a raw body costs the
+ * server one HTTPRaw buffer.  A longer lived allocation of random size
+ * lands during each request as timers and clients would.  Reports the
+ * allocations per save of each kind, server included, and the largest free
+ * block before, after and at worst.  Each form is first decoded both ways
+ * from the same values and the results compared.  The exit status is
+ * non-zero if they differ, or if either table decoder allocated at all.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+#include "config.h"
+#include "form.h"
+#include "nvdata.h"
+#include "configform.h"
+
+#define ARENA   24576
+#define SAVES   10000
+#define LIVE    6           // Long lived allocations kept at once.
+#define CHUNK   64          // Bytes of body per feed, as it arrives.
+#define RAW     1480        // sizeof(HTTPRaw), its buffer is HTTP_RAW_BUFLEN.
+#define CHECKS  200
+
+#define N(t)    (sizeof(t) / sizeof(t[0]))
+
+enum { SAVE_CONFIG, SAVE_SCHEDULE, SAVE_TARIFF, SAVE_JSON, KINDS };
+enum { PATH_STRING, PATH_ARGS, PATH_BODY, PATHS };
+
+static const char *paths[] = { "String", "args", "body" };
+
+ESP8266WebServer          web;
+static struct config      cfg;
+static uint8_t           *arena;
+static size_t             arenaSize;
+static std::map<size_t, std::pair<size_t, bool>> blocks;   // Offset to size and in use.
+static uint64_t           allocs;
+static std::string        body;
+static std::vector<std::pair<std::string, std::string>> pairs;
+static const char         pad[] = "kitchen-plug-living-room-network-name-pool.ntp.org-and-more-text";
+static volatile float     sink;
+
+static const struct form {
+  const struct formField   *fields;
+  uint8_t                   n;
+} forms[] = {
+  { configForm,   N(configForm) },
+  { scheduleForm, N(scheduleForm) },
+  { tariffForm,   N(tariffForm) },
+};
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: formheap [-n saves] [-a bytes] [-s seed]\n");
+  exit(2);
+}
+
+static void *
+arenaMalloc(size_t n)
+{
+  n = (n + 7) & ~(size_t)7;
+  for (auto &b : blocks) {
+    if (b.second.second || b.second.first < n)
+      continue;
+    if (b.second.first > n)
+      blocks[b.first + n] = { b.second.first - n, false };
+    b.second = { n, true };
+    allocs++;
+    return arena + b.first;
+  }
+  fprintf(stderr, "out of memory after %llu allocations\n", (unsigned long long)allocs);
+  exit(1);
+}
+
+static void
+arenaFree(void *p)
+{
+  auto  b = blocks.find((uint8_t *)p - arena), next = std::next(b);
+
+  b->second.second = false;
+  if (next != blocks.end() && !next->second.second) {
+    b->second.first += next->second.first;
+    blocks.erase(next);
+  }
+  if (b != blocks.begin()) {
+    auto prev = std::prev(b);
+
+    if (!prev->second.second) {
+      prev->second.first += b->second.first;
+      blocks.erase(b);
+    }
+  }
+}
+
+static size_t
+maxFree(void)
+{
+  size_t max = 0;
+
+  for (auto &b : blocks)
+    if (!b.second.second)
+      max = std::max(max, b.second.first);
+  return max;
+}
+
+static void
+add(const char *name, const char *value)
+{
+  static const char hex[] = "0123456789ABCDEF";
+
+  pairs.push_back({ name, value });
+  if (!body.empty())
+    body += '&';
+  body += name;
+  body += '=';
+  for (const char *v = value; *v; v++) {
+    if (isalnum(*v) || strchr("-._", *v))
+      body += *v;
+    else if (*v == ' ')
+      body += '+';
+    else {
+      body += '%';
+      body += hex[(uint8_t)*v >> 4];
+      body += hex[*v & 15];
+    }
+  }
+}
+
+// The argument name of entry k of a field.
+static void
+fieldName(const struct formField *f, int k, char *name, size_t len)
+{
+  if (!f->count)
+    snprintf(name, len, "%.15s", f->name);
+  else if (!f->inner)
+    snprintf(name, len, "%.15s%u", f->name, (unsigned)k % 10);
+  else
+    snprintf(name, len, "%.15s%u%u", f->name, (unsigned)k / f->inner % 10, (unsigned)k % f->inner % 10);
+}
+
+static int
+entries(const struct formField *f)
+{
+  return f->count ? f->count * (f->inner ? f->inner : 1) : 1;
+}
+
+/*
+ * Every field of a table with a plausible value, indexed fields expanded,
+ * as the body they come in.  About half the checkboxes are ticked.
+ */
+static void
+request(const struct form *form)
+{
+  char  name[FORM_KEY], value[80];
+
+  pairs.clear();
+  body.clear();
+  for (uint8_t i = 0; i < form->n; i++) {
+    const struct formField *f = &form->fields[i];
+
+    for (int k = 0; k < entries(f); k++) {
+      fieldName(f, k, name, sizeof(name));
+      switch (f->type) {
+        case FORM_STR:   snprintf(value, sizeof(value), "%.*s %d&%%", rand() % (f->size - 8), pad, rand() % 100); break;
+        case FORM_FLOAT: snprintf(value, sizeof(value), "%.3f", f->max * (rand() % 100) / 100); break;
+        case FORM_INT:
+        case FORM_BITS:  snprintf(value, sizeof(value), "%d", (int)f->min); break;
+        case FORM_FLAG:  strcpy(value, "on"); if (rand() % 2) continue; break;
+        case FORM_HM:    snprintf(value, sizeof(value), "%02d:%02d", rand() % 24, rand() % 60); break;
+      }
+      add(name, value);
+    }
+  }
+}
+
+/*
+ * What the server allocates to make arguments of a form body: the body as
+ * read, a String copy of it, and an array of RequestArgument, two Strings
+ * each, filled in.  The copy goes once parsed and the arguments at the end
+ * of the request.
+ */
+static void
+parse(void)
+{
+  void  *plain = hostMalloc(body.size() + 1), *search, *array;
+
+  search = hostMalloc(body.size() + 1);
+  hostFree(plain);
+  array = hostMalloc(pairs.size() * 24);
+  for (auto &p : pairs) {
+    web.names.push_back(p.first.c_str());
+    web.values.push_back(p.second.c_str());
+  }
+  hostFree(search);
+  web.array = array;
+}
+
+// The handlers before the tables: a String copy for every field looked up.
+static void
+stringSave(const struct form *form)
+{
+  char  name[FORM_KEY];
+
+  for (uint8_t i = 0; i < form->n; i++) {
+    const struct formField *f = &form->fields[i];
+
+    for (int k = 0; k < entries(f); k++) {
+      fieldName(f, k, name, sizeof(name));
+      if (web.hasArg(name)) {
+        String value = web.arg(name);
+
+        sink += value.toFloat();
+      }
+    }
+  }
+}
+
+// The end of a request, when the server lets go of the arguments.
+static void
+done(void)
+{
+  web.names.clear();
+  web.values.clear();
+  if (web.array)
+    hostFree(web.array);
+  web.array = NULL;
+}
+
+// The body as the raw handler is given it.
+static void
+bodySave(const struct form *form)
+{
+  struct formBody b;
+
+  formBodyBegin(&b, form->fields, form->n, &cfg);
+  for (size_t off = 0; off < body.size(); off += CHUNK)
+    formBodyFeed(&b, body.data() + off, std::min((size_t)CHUNK, body.size() - off));
+  formBodyEnd(&b);
+}
+
+// The same values decoded from the arguments and from the body must agree.
+static bool
+check(void)
+{
+  struct config args, raw;
+  int           bad = 0;
+
+  for (int i = 0; i < CHECKS; i++) {
+    const struct form *form = &forms[i % 3];
+
+    memset(&cfg, i, sizeof(cfg));
+    request(form);
+    parse();
+    bodySave(form);
+    raw = cfg;
+    memset(&cfg, i, sizeof(cfg));
+    formDecode(form->fields, form->n, &cfg);
+    args = cfg;
+    bad += memcmp(&args, &raw, sizeof(args)) != 0;
+    done();
+  }
+  memset(&cfg, 0, sizeof(cfg));
+  printf("body and args decoders %s over %d forms\n", bad ? "differ" : "agree", CHECKS);
+  return !bad;
+}
+
+// The document GET returns, fed back in pieces as a PUT body would arrive.
+static void
+jsonSave(const std::string &doc)
+{
+  struct formJson j;
+
+  formJsonBegin(&j, configJson, CONFIG_JSON, &cfg);
+  for (size_t off = 0; off < doc.size(); off += CHUNK)
+    formJsonFeed(&j, doc.data() + off, std::min((size_t)CHUNK, doc.size() - off));
+  if (!formJsonEnd(&j)) {
+    fprintf(stderr, "JSON document rejected\n");
+    exit(1);
+  }
+}
+
+class StringPrint : public Print {
+public:
+  size_t write(uint8_t c) { s += (char)c; return 1; }
+  std::string s;
+};
+
+static bool
+run(int path, int saves, unsigned seed)
+{
+  String      live[LIVE];
+  StringPrint doc;
+  uint64_t    per[KINDS] = {}, before, mark, decoded, decoder = 0;
+  size_t      start, worst;
+  std::string pad(256, 'x');
+  void       *raw;
+
+  blocks.clear();
+  blocks[0] = { arenaSize, false };
+  srand(seed);
+  formJsonWrite(doc, configJson, CONFIG_JSON, &cfg);
+  start = worst = maxFree();
+
+  for (int i = 0; i < saves; i++) {
+    int kind = i % KINDS;
+
+    raw = NULL;
+    before = allocs;
+    if (kind != SAVE_JSON)
+      request(&forms[kind]);
+    if (kind != SAVE_JSON && path != PATH_BODY)
+      parse();
+    else
+      raw = hostMalloc(RAW);
+    mark = allocs;
+    live[i % LIVE] = pad.substr(0, 16 + rand() % 180).c_str();
+    before += allocs - mark;        // Not the request's own.
+    decoded = allocs;
+    if (kind == SAVE_JSON)
+      jsonSave(doc.s);
+    else if (path == PATH_BODY)
+      bodySave(&forms[kind]);
+    else if (path == PATH_ARGS)
+      formDecode(forms[kind].fields, forms[kind].n, &cfg);
+    else
+      stringSave(&forms[kind]);
+    decoder += allocs - decoded;
+    per[kind] += allocs - before;
+
+    if (raw)
+      hostFree(raw);
+    done();
+    worst = std::min(worst, maxFree());
+  }
+
+  printf("%-7s allocations per save with the server's: config %.0f, schedule %.0f, tariff %.0f, JSON %.0f; "
+    "%llu by the decoder\n", paths[path], (double)per[SAVE_CONFIG] * KINDS / saves,
+    (double)per[SAVE_SCHEDULE] * KINDS / saves, (double)per[SAVE_TARIFF] * KINDS / saves,
+    (double)per[SAVE_JSON] * KINDS / saves, (unsigned long long)decoder);
+  printf("        largest free block %zu -> %zu bytes, worst %zu\n", start, maxFree(), worst);
+  return path == PATH_STRING || !decoder;
+}
+
+int
+main(int argc, char **argv)
+{
+  int       ch, saves = SAVES;
+  unsigned  seed = 1;
+  bool      ok;
+
+  arenaSize = ARENA;
+  while ((ch = getopt(argc, argv, "a:n:s:")) != -1) {
+    switch (ch) {
+      case 'a': arenaSize = atoi(optarg); break;
+      case 'n': saves = atoi(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (saves <= 0 || arenaSize < 4096)
+    usage();
+  ok = check();
+  arena = (uint8_t *)malloc(arenaSize);
+  hostMalloc = arenaMalloc;
+  hostFree = arenaFree;
+
+  for (int path = 0; path < PATHS; path++)
+    ok &= run(path, saves, seed);
+  printf("%d saves, %s\n", saves, ok ? "no allocations from the tables" : "the tables allocated or disagreed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Measures the firmware's gzip encoder on pages and history: the ratio,
+ * host CPU per KB, and a round trip through zlib to check the output.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o gzipbench tools/gzipbench.cpp src/gzip.cpp src/timefmt.cpp -lz
+ *
+ *   gzipbench [-r reps] [-p host[:port]] [file ...]
+ *
+ * -p fetches the plug's own pages, /, /config, /schedule, /tariff and the
+ * history as /data.txt and /data.txt?epoch, uncompressed.  Files, such as
+ * pages saved with curl, are measured as they are.  Without either, a day
+ * of 10 s history rows is made with the firmware's row formatting, a fridge
+ * cycling over a standby floor with the odd kettle.  Each input is
+ * compressed -r times (default 20) in 1460 byte writes as the handlers
+ * make them, and zlib -1 and -6 are shown for comparison.
+ */
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <Arduino.h>
+
+#include "gzip.h"
+#include "timefmt.h"
+
+#define REPS      20
+#define SEGMENT   1460
+#define ROWS      8640      // A day of NV_LOG_PERIOD samples.
+
+struct input {
+  std::string name;
+  std::string data;
+};
+
+class StringPrint : public Print {
+public:
+  size_t write(uint8_t c) { s += (char)c; return 1; }
+  size_t write(const uint8_t *buf, size_t len) { s.append((const char *)buf, len); return len; }
+  std::string s;
+};
+
+static double
+nowUs(void)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: gzipbench [-r reps] [-p host[:port]] [file ...]\n");
+  exit(2);
+}
+
+static bool
+resolve(const std::string &spec, struct sockaddr_in *sin)
+{
+  std::string       name = spec, port = "80";
+  size_t            colon = spec.rfind(':');
+  struct addrinfo   hints = {}, *ai;
+
+  if (colon != std::string::npos) {
+    name = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+  }
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(atoi(port.c_str()));
+  if (inet_pton(AF_INET, name.c_str(), &sin->sin_addr) == 1)
+    return true;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(name.c_str(), port.c_str(), &hints, &ai) != 0)
+    return false;
+  *sin = *(struct sockaddr_in *)ai->ai_addr;
+  freeaddrinfo(ai);
+  return true;
+}
+
+// The body of a GET without Accept-Encoding, so it comes back uncompressed.
+static bool
+fetch(const struct sockaddr_in *sin, const char *host, const char *path, std::string &body)
+{
+  std::string reply;
+  char        buf[4096];
+  ssize_t     n;
+  size_t      end;
+  int         fd;
+
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    return false;
+  if (connect(fd, (const struct sockaddr *)sin, sizeof(*sin)) == 0) {
+    n = snprintf(buf, sizeof(buf), "GET %s HTTP/1.0\r\nHost: %s\r\n\r\n", path, host);
+    send(fd, buf, n, MSG_NOSIGNAL);
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+      reply.append(buf, n);
+  }
+  close(fd);
+  // The firmware ends some header blocks with bare newlines.
+  if ((end = reply.find("\r\n\r\n")) != std::string::npos)
+    body = reply.substr(end + 4);
+  else if ((end = reply.find("\n\n")) != std::string::npos)
+    body = reply.substr(end + 2);
+  else
+    return false;
+  return reply.compare(0, 5, "HTTP/") == 0 && reply.compare(8, 5, " 200 ") == 0 && !body.empty();
+}
+
+static bool
+readFile(const char *path, std::string &s)
+{
+  FILE   *f = fopen(path, "r");
+  char    buf[4096];
+  size_t  n;
+
+  if (!f)
+    return false;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    s.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+// Rows as handleNvData() writes them, dates or epoch seconds.
+static std::string
+history(bool epoch)
+{
+  std::mt19937                      rng(1);
+  std::normal_distribution<double>  noise(0, 1);
+  std::string                       csv = "Date,Power\n";
+  char                              row[48], *p;
+  time_t                            t = 1792281600;
+
+  for (int i = 0; i < ROWS; i++, t += 10) {
+    double power = 3.2 + noise(rng) * 0.1;
+
+    if (i / 90 % 3 == 0)
+      power = 95 + noise(rng);
+    if (i % 2000 < 18)
+      power = 2150 + noise(rng) * 5;
+    p = epoch ? fmtFixed(row, t, 0) : fmtTime(row, t);
+    *p++ = ',';
+    p = fmtFixed(p, power, 2);
+    *p++ = '\n';
+    csv.append(row, p - row);
+  }
+  return csv;
+}
+
+static std::string
+gunzip(const std::string &z)
+{
+  z_stream    st = {};
+  std::string out;
+  char        buf[16384];
+  int         r;
+
+  inflateInit2(&st, 16 + MAX_WBITS);
+  st.next_in = (Bytef *)z.data();
+  st.avail_in = z.size();
+  do {
+    st.next_out = (Bytef *)buf;
+    st.avail_out = sizeof(buf);
+    r = inflate(&st, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - st.avail_out);
+  } while (r == Z_OK);
+  inflateEnd(&st);
+  return r == Z_STREAM_END ? out : "";
+}
+
+static size_t
+zlibSize(const std::string &in, int level)
+{
+  uLongf  len = compressBound(in.size());
+  Bytef  *buf = (Bytef *)malloc(len);
+
+  compress2(buf, &len, (const Bytef *)in.data(), in.size(), level);
+  free(buf);
+  return len + 18 - 6;      // gzip wrapper rather than zlib's.
+}
+
+static bool
+measure(const struct input *in, int reps)
+{
+  StringPrint sink;
+  Gzip       *gz = new Gzip(sink);
+  double      start, us;
+  double      kb = in->data.size() / 1024.0;
+  bool        ok;
+
+  start = nowUs();
+  for (int r = 0; r < reps; r++) {
+    sink.s.clear();
+    gz->begin();
+    for (size_t off = 0; off < in->data.size(); off += SEGMENT)
+      gz->write((const uint8_t *)in->data.data() + off, std::min((size_t)SEGMENT, in->data.size() - off));
+    gz->end();
+  }
+  us = (nowUs() - start) / reps;
+  ok = gunzip(sink.s) == in->data;
+  printf("%-20s %8zu -> %7zu bytes %5.2fx %7.2f us/KB %s   zlib -1 %5.2fx  -6 %5.2fx\n",
+    in->name.c_str(), in->data.size(), sink.s.size(), (double)in->data.size() / sink.s.size(), us / kb,
+    ok ? "ok" : "MISMATCH", (double)in->data.size() / zlibSize(in->data, 1),
+    (double)in->data.size() / zlibSize(in->data, 6));
+  delete gz;
+  return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const char   *paths[] = { "/", "/config", "/schedule", "/tariff", "/data.txt", "/data.txt?epoch" };
+  std::vector<struct input> inputs;
+  struct sockaddr_in  sin;
+  const char         *plug = NULL;
+  int                 ch, reps = REPS, bad = 0;
+
+  while ((ch = getopt(argc, argv, "p:r:")) != -1) {
+    switch (ch) {
+      case 'p': plug = optarg; break;
+      case 'r': reps = std::max(1, atoi(optarg)); break;
+      default: usage();
+    }
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  if (plug) {
+    if (!resolve(plug, &sin)) {
+      fprintf(stderr, "%s: unknown host\n", plug);
+      return 1;
+    }
+    for (const char *path : paths) {
+      struct input in = { path, "" };
+
+      if (fetch(&sin, plug, path, in.data))
+        inputs.push_back(in);
+      else
+        fprintf(stderr, "%s%s: no page\n", plug, path);
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    struct input in = { argv[i], "" };
+
+    if (!readFile(argv[i], in.data)) {
+      perror(argv[i]);
+      return 1;
+    }
+    inputs.push_back(in);
+  }
+  if (!plug && optind == argc) {
+    inputs.push_back({ "history, dates", history(false) });
+    inputs.push_back({ "history, epoch", history(true) });
+  }
+
+  if (inputs.empty())
+    return 1;
+  printf("sizeof(Gzip) %zu bytes\n", sizeof(Gzip));
+  for (auto &in : inputs)
+    bad += !measure(&in, reps);
+  return bad ? 1 : 0;
+}
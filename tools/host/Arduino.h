@@ -0,0 +1,245 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Just enough of the Arduino core to build firmware sources into the host
+ * programs in tools/.  Time is simulated: millis(), micros() and delay()
+ * read and advance hostUs, which the program drives.  String takes its
+ * memory through hostMalloc and hostFree so a program can model the heap.
+ * Serial is the receive side of a UART: it calls hostUart before reporting
+ * what is buffered, and the program delivers whatever has arrived by then.
+ * The storage shims call hostPersist before each byte reaches the part, and
+ * a program cuts the power by throwing from it.
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)   (s)
+#define F(s)      ((const __FlashStringHelper *)(s))
+#define FPSTR(p)  ((const __FlashStringHelper *)(p))
+#define memcpy_P  memcpy
+#define strlen_P  strlen
+#define strncpy_P strncpy
+
+class __FlashStringHelper;
+typedef const char *PGM_P;
+
+using std::max;
+using std::min;
+
+inline uint64_t hostUs;
+inline void    *(*hostMalloc)(size_t) = malloc;
+inline void     (*hostFree)(void *) = free;
+inline void     (*hostUart)(void);
+inline void     (*hostPersist)(void);
+
+// SPI flash, a typical sector erase and 256 byte page program.
+#define HOST_SECTOR   4096
+#define HOST_ERASE_US 45000
+#define HOST_PAGE_US  700
+
+static inline uint32_t
+millis(void)
+{
+  return hostUs / 1000;
+}
+
+static inline uint32_t
+micros(void)
+{
+  return hostUs;
+}
+
+static inline void
+delay(uint32_t ms)
+{
+  hostUs += ms * 1000ULL;
+}
+
+static inline void
+yield(void)
+{
+}
+
+template <typename T, typename L, typename H> static inline T
+constrain(T v, L lo, H hi)
+{
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+
+  virtual size_t
+  write(const uint8_t *buf, size_t len)
+  {
+    size_t n = 0;
+
+    while (len-- && write(*buf++))
+      n++;
+    return n;
+  }
+
+  size_t
+  write(const char *buf, size_t len)
+  {
+    return write((const uint8_t *)buf, len);
+  }
+
+  size_t
+  print(const char *s)
+  {
+    return write((const uint8_t *)s, strlen(s));
+  }
+
+  // Like the core, output that outgrows the stack buffer is formatted again on the heap.
+  size_t
+  printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char    temp[64], *buf = temp;
+    va_list ap;
+    size_t  len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(temp, sizeof(temp), fmt, ap);
+    va_end(ap);
+    if (len >= sizeof(temp)) {
+      if (!(buf = (char *)hostMalloc(len + 1)))
+        return 0;
+      va_start(ap, fmt);
+      vsnprintf(buf, len + 1, fmt, ap);
+      va_end(ap);
+    }
+    len = write((const uint8_t *)buf, len);
+    if (buf != temp)
+      hostFree(buf);
+    return len;
+  }
+};
+
+class String {
+public:
+  String(const char *s = "") { copy(s); }
+  String(const String &s) { copy(s.buf); }
+  ~String() { release(); }
+
+  String &
+  operator=(const String &s)
+  {
+    if (this != &s) {
+      release();
+      copy(s.buf);
+    }
+    return *this;
+  }
+
+  bool operator==(const char *s) const { return !strcmp(buf, s); }
+  const char *c_str(void) const { return buf; }
+  unsigned int length(void) const { return strlen(buf); }
+  long toInt(void) const { return atol(buf); }
+  float toFloat(void) const { return atof(buf); }
+
+private:
+  // Like the core, up to ten characters are kept inline and take no heap.
+  void
+  copy(const char *s)
+  {
+    size_t len = strlen(s);
+
+    buf = len < sizeof(sso) ? sso : (char *)hostMalloc(len + 1);
+    memcpy(buf, s, len + 1);
+  }
+
+  void
+  release(void)
+  {
+    if (buf != sso)
+      hostFree(buf);
+  }
+
+  char *buf;
+  char  sso[11];
+};
+
+// The core's default receive buffer, which overruns rather than blocks.
+class HardwareSerial {
+public:
+  int
+  available(void)
+  {
+    if (hostUart)
+      hostUart();
+    return len;
+  }
+
+  int
+  read(void)
+  {
+    uint8_t c;
+
+    if (!available())
+      return -1;
+    c = rx[head];
+    head = (head + 1) % sizeof(rx);
+    len--;
+    return c;
+  }
+
+  void flush(void) {}
+
+  bool
+  receive(uint8_t c)
+  {
+    if (len == sizeof(rx)) {
+      overruns++;
+      return false;
+    }
+    rx[(head + len++) % sizeof(rx)] = c;
+    return true;
+  }
+
+  uint32_t  overruns = 0;
+
+private:
+  uint8_t   rx[256];
+  uint16_t  head = 0, len = 0;
+};
+
+inline HardwareSerial Serial;
@@ -0,0 +1,100 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * The core's EEPROM: a RAM copy of one flash sector, which commit() erases
+ * and programs again if anything was put.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+class EEPROMClass {
+public:
+  void
+  begin(size_t size)
+  {
+    len = min(size, sizeof(flash));
+    buf = (uint8_t *)realloc(buf, len);
+    memcpy(buf, flash, len);
+    dirty = false;
+  }
+
+  template <typename T> T &
+  get(int address, T &t)
+  {
+    memcpy(&t, buf + address, sizeof(T));
+    return t;
+  }
+
+  template <typename T> const T &
+  put(int address, const T &t)
+  {
+    if (memcmp(buf + address, &t, sizeof(T))) {
+      memcpy(buf + address, &t, sizeof(T));
+      dirty = true;
+    }
+    return t;
+  }
+
+  bool
+  commit(void)
+  {
+    if (!len)
+      return false;
+    if (!dirty)
+      return true;
+    hostUs += HOST_ERASE_US + (len + 255) / 256 * HOST_PAGE_US;
+    memset(flash, 0xff, sizeof(flash));
+    for (size_t i = 0; i < len; i++) {
+      if (hostPersist)
+        hostPersist();
+      flash[i] = buf[i];
+    }
+    dirty = false;
+    return true;
+  }
+
+  void
+  end(void)
+  {
+    commit();
+    free(buf);
+    buf = NULL;
+    len = 0;
+  }
+
+  uint8_t   flash[HOST_SECTOR];
+
+private:
+  uint8_t  *buf = NULL;
+  size_t    len = 0;
+  bool      dirty = false;
+};
+
+inline EEPROMClass EEPROM;
@@ -0,0 +1,76 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * The parsed arguments and headers of a request, which is all the form
+ * decoders and pages use.  Programs fill 'names' and 'values', and
+ * 'headerNames' and 'headerValues', before calling a handler.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "Arduino.h"
+
+class ESP8266WebServer {
+public:
+  int args(void) { return names.size(); }
+  const String &argName(int i) { return names[i]; }
+  const String &arg(int i) { return values[i]; }
+
+  String
+  arg(const char *name)
+  {
+    for (size_t i = 0; i < names.size(); i++)
+      if (names[i] == name)
+        return values[i];
+    return String();
+  }
+
+  bool
+  hasArg(const char *name)
+  {
+    for (size_t i = 0; i < names.size(); i++)
+      if (names[i] == name)
+        return true;
+    return false;
+  }
+
+  String
+  header(const char *name)
+  {
+    for (size_t i = 0; i < headerNames.size(); i++)
+      if (headerNames[i] == name)
+        return headerValues[i];
+    return String();
+  }
+
+  std::vector<String> names, values;
+  std::vector<String> headerNames, headerValues;
+  void               *array = NULL;      // A program's stand in for the server's own.
+};
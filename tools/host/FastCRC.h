@@ -0,0 +1,82 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * The FastCRC calls the firmware makes.  FastCRC32 matches zlib's crc32()
+ * and FastCRC16::ccitt() is CRC-16/CCITT-FALSE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class FastCRC16 {
+public:
+  uint16_t
+  ccitt(const uint8_t *data, size_t len)
+  {
+    uint16_t crc = 0xffff;
+
+    while (len--) {
+      crc ^= *data++ << 8;
+      for (int i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+    }
+    return crc;
+  }
+};
+
+// Table driven like the library, so timings that include it are fair.
+class FastCRC32 {
+public:
+  uint32_t crc32(const uint8_t *data, size_t len) { return crc = update(0, data, len); }
+  uint32_t crc32_upd(const uint8_t *data, size_t len) { return crc = update(crc, data, len); }
+
+private:
+  static uint32_t
+  update(uint32_t crc, const uint8_t *data, size_t len)
+  {
+    static uint32_t table[256];
+
+    if (!table[1]) {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for (int k = 0; k < 8; k++)
+          c = c & 1 ? c >> 1 ^ 0xedb88320 : c >> 1;
+        table[i] = c;
+      }
+    }
+    crc = ~crc;
+    while (len--)
+      crc = table[(crc ^ *data++) & 0xff] ^ crc >> 8;
+    return ~crc;
+  }
+
+  uint32_t crc = 0;
+};
@@ -0,0 +1,110 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * LittleFS as far as whole small files go.  A file written is copy on
+ * write: its data goes to a freshly erased block and the directory entry
+ * moves to it at close(), so a power cut before then leaves the old file.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <Arduino.h>
+
+class FS;
+
+class File {
+public:
+  operator bool() const { return fs; }
+
+  size_t
+  read(uint8_t *buf, size_t len)
+  {
+    len = min(len, data.size() - pos);
+    memcpy(buf, data.data() + pos, len);
+    pos += len;
+    return len;
+  }
+
+  size_t
+  write(const uint8_t *buf, size_t len)
+  {
+    data.append((const char *)buf, len);
+    return len;
+  }
+
+  inline void close(void);
+
+private:
+  friend class FS;
+
+  FS          *fs = NULL;
+  std::string path, data;
+  size_t      pos = 0;
+  bool        writing = false;
+};
+
+class FS {
+public:
+  File
+  open(const char *path, const char *mode)
+  {
+    File  f;
+
+    hostUs += HOST_PAGE_US / 2;     // Reading the directory.
+    if (*mode == 'w')
+      f.writing = true;
+    else if (files.count(path))
+      f.data = files[path];
+    else
+      return f;
+    f.fs = this;
+    f.path = path;
+    return f;
+  }
+
+  std::map<std::string, std::string> files;
+};
+
+void
+File::close(void)
+{
+  if (fs && writing) {
+    hostUs += HOST_ERASE_US + ((data.size() + 255) / 256 + 1) * HOST_PAGE_US;
+    for (size_t i = 0; i <= data.size(); i++) {
+      if (hostPersist)
+        hostPersist();
+    }
+    fs->files[path] = data;
+  }
+  fs = NULL;
+}
+
+inline FS LittleFS;
@@ -0,0 +1,152 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Collector side check for the InfluxDB line protocol export.  Counts
+ * datagrams and lines per sender and uses the "# seq=" comment each datagram
+ * opens with to count lost and out of order ones.
+ *
+ *   c++ -O2 -o influxsink tools/influxsink.cpp
+ *   influxsink [-v] [-p port]
+ *
+ * -v prints every line received.  Totals are printed every 10 seconds.
+ */
+
+#include <map>
+#include <string>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PORT    8089
+#define REPORT  10
+
+struct sender {
+  uint32_t  next = 0;           // Sequence number expected next.
+  uint32_t  datagrams = 0;
+  uint32_t  lines = 0;
+  uint32_t  lost = 0;
+  uint32_t  late = 0;           // Reordered or duplicated.
+  uint32_t  bad = 0;            // No sequence comment.
+};
+
+static void
+report(std::map<std::string, struct sender> &senders)
+{
+  for (auto &s : senders)
+    printf("%s: %u datagrams, %u lines, %.1f lines/datagram, %u lost, %u late, %u bad\n",
+      s.first.c_str(), s.second.datagrams, s.second.lines,
+      s.second.datagrams ? (double)s.second.lines / s.second.datagrams : 0.0,
+      s.second.lost, s.second.late, s.second.bad);
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+  std::map<std::string, struct sender> senders;
+  struct sockaddr_in  sin = {}, from;
+  socklen_t           len;
+  char                buf[2048], addr[INET_ADDRSTRLEN + 8];
+  bool                verbose = false;
+  uint16_t            port = PORT;
+  time_t              next = time(NULL) + REPORT;
+  int                 ch, fd;
+
+  while ((ch = getopt(argc, argv, "vp:")) != -1) {
+    switch (ch) {
+      case 'v':
+        verbose = true;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: influxsink [-v] [-p port]\n");
+        return 2;
+    }
+  }
+
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    perror("bind");
+    return 1;
+  }
+
+  for (;;) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    ssize_t       n;
+
+    if (time(NULL) >= next) {
+      report(senders);
+      next += REPORT;
+    }
+    if (poll(&pfd, 1, 1000) <= 0)
+      continue;
+    len = sizeof(from);
+    if ((n = recvfrom(fd, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&from, &len)) <= 0)
+      continue;
+    buf[n] = '\0';
+    inet_ntop(AF_INET, &from.sin_addr, addr, sizeof(addr));
+
+    struct sender &s = senders[addr];
+    unsigned long seq;
+    char          *line, *save;
+
+    s.datagrams++;
+    if (sscanf(buf, "# seq=%lu", &seq) != 1)
+      s.bad++;
+    else if (seq >= s.next) {
+      s.lost += seq - s.next;
+      s.next = seq + 1;
+    }
+    else if (seq == 0) {
+      s.next = 1;               // The sender restarted.
+    }
+    else {
+      // Counted as lost when it was skipped over.
+      s.late++;
+      if (s.lost)
+        s.lost--;
+    }
+    for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+      if (line[0] == '#')
+        continue;
+      s.lines++;
+      if (verbose)
+        printf("%s %s\n", addr, line);
+    }
+  }
+}
@@ -0,0 +1,228 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Lays the FRAM history ring out again through src/framlog.cpp, as nvInit()
+ * does when a part of another size is fitted, and cuts the power part way.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o logsim tools/logsim.cpp src/framlog.cpp src/logstore.cpp
+ *
+ *   logsim [-n cuts] [-s seed]
+ *
+ * For a ring that grows, one that shrinks and one that grows a little, a
+ * wrapped log is filled and resized once to time it, then -n times (default
+ * 500) with the power cut at a random byte of what the resize writes, after
+ * which the plug boots again.  The log found must be the whole result of
+ * the resize, or empty when the cut came before the new layout was saved.
+ * Records out of order or missing from the middle are a scrambled log and
+ * make the exit status non-zero.
+ */
+
+#include <random>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <FastCRC.h>
+#include <FRAM.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+#define CUTS  500
+
+struct cut {};
+
+struct nvHeader   nvHeader;
+FRAM32            fram;
+
+static std::mt19937 rng;
+static uint32_t   budget, written;
+
+static const struct {
+  const char *name;
+  uint32_t    from, to;
+} layouts[] = {
+  { "grow",   1000, 3000 },
+  { "shrink", 3000, 1000 },
+  { "nudge",  1000, 1100 },
+};
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: logsim [-n cuts] [-s seed]\n");
+  exit(2);
+}
+
+static void
+count(void)
+{
+  written++;
+}
+
+static void
+power(void)
+{
+  if (!budget--)
+    throw cut();
+}
+
+// As main.cpp has it.
+void
+saveNvHeader(void)
+{
+  FastCRC16 CRC16;
+
+  nvHeader.crc = CRC16.ccitt((uint8_t *)&nvHeader, sizeof(struct nvHeader) - 2);
+  fram.write(NV_HEADER_OFFSET, (uint8_t *)&nvHeader, sizeof(nvHeader));
+}
+
+// The log part of nvInit().
+static void
+boot(uint32_t max)
+{
+  FastCRC16 CRC16;
+
+  fram.read(NV_HEADER_OFFSET, (uint8_t *)&nvHeader, sizeof(nvHeader));
+  if (nvHeader.crc != CRC16.ccitt((uint8_t *)&nvHeader, sizeof(struct nvHeader) - 2))
+    memset(&nvHeader, '\0', sizeof(struct nvHeader));
+  if (nvHeader.nvLogMax != max)
+    framLogResize(max);
+  saveNvHeader();
+}
+
+// 1 for the whole log, 0 for an empty one and -1 for anything else.
+static int
+check(uint32_t want, time_t newest)
+{
+  FramLog       log;
+  struct nvLog  r;
+  uint32_t      n = log.count();
+
+  if (!n)
+    return 0;
+  if (n != want)
+    return -1;
+  for (uint32_t i = 0; i < n; i++) {
+    log.read(i, &r);
+    if (r.time != newest - (time_t)(n - 1 - i))
+      return -1;
+  }
+  return 1;
+}
+
+static bool
+run(uint32_t from, uint32_t to, uint32_t cuts, const char *name)
+{
+  static uint8_t  image[sizeof(fram.mem)];
+  FramLog         log;
+  struct nvLog    r = {};
+  uint32_t        records = from + from / 3, want = min(from, to) - 1, bytes;
+  uint32_t        kept = 0, empty = 0, bad = 0;
+  uint64_t        start;
+
+  memset(fram.mem, 0, sizeof(fram.mem));
+  memset(&nvHeader, 0, sizeof(nvHeader));
+  saveNvHeader();
+  boot(from);
+  for (uint32_t i = 1; i <= records; i++) {
+    r.time = i;
+    r.power = i;
+    log.add(&r);
+  }
+  memcpy(image, fram.mem, sizeof(image));
+
+  written = 0;
+  hostPersist = count;
+  start = hostUs;
+  boot(to);
+  start = hostUs - start;
+  hostPersist = NULL;
+  bytes = written;
+  if (check(want, records) != 1)
+    bad++;
+
+  for (uint32_t i = 0; i < cuts; i++) {
+    memcpy(fram.mem, image, sizeof(image));
+    budget = rng() % bytes;
+    hostPersist = power;
+    try {
+      boot(to);
+    }
+    catch (const cut &) {
+    }
+    hostPersist = NULL;
+    boot(to);
+    switch (check(want, records)) {
+      case 1:
+        kept++;
+        break;
+      case 0:
+        empty++;
+        break;
+      default:
+        bad++;
+    }
+  }
+  printf("%-6s %4u -> %4u slots, %u records, resize writes %u bytes in %.1f ms\n", name, from, to, want,
+    bytes, start / 1000.0);
+  printf("       %u cuts: %u kept, %u emptied, %u scrambled\n", cuts, kept, empty, bad);
+  return !bad;
+}
+
+int
+main(int argc, char **argv)
+{
+  uint32_t  cuts = CUTS;
+  int       c;
+  bool      ok = true;
+
+  while ((c = getopt(argc, argv, "n:s:")) != -1) {
+    switch (c) {
+      case 'n':
+        cuts = atoi(optarg);
+        break;
+      case 's':
+        rng.seed(atoi(optarg));
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc)
+    usage();
+
+  for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+    ok &= run(layouts[i].from, layouts[i].to, cuts, layouts[i].name);
+  return !ok;
+}
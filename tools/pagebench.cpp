@@ -0,0 +1,410 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Renders the root page with Page and with the printf() call it replaced,
+ * checks that the bodies agree and times both.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o pagebench tools/pagebench.cpp src/page.cpp src/gzip.cpp src/timefmt.cpp
+ *
+ *   pagebench [-n renders] [-s seed]
+ *
+ * Each of -n renders (default 20000) draws new readings from -s seed, with
+ * tariffs, demand, a trip, the brownout line and the history script all on,
+ * and the page goes out uncompressed.  The two handlers are copies of
+ * handleRoot() before and after, as main.cpp doesn't build on the host.
+ * Reported per render are the time, the heap allocations (the core's
+ * printf() formats anything over 63 bytes on the heap) and the writes to
+ * the connection.  The exit status is non-zero if any body differs.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include <WiFiClient.h>
+
+#include "config.h"
+#include "page.h"
+#include "rootpage.h"
+#include "states.h"
+
+#define RENDERS       20000
+#define AUTO_VERSION  "1.0.0-bench"
+
+// What handleRoot() reads, under the firmware's names.
+struct config     cfg;
+ESP8266WebServer  web;
+double            power, voltage, current, energy, kWhPerPulse = 0.001;
+uint8_t           state, tariffBand, protectReason;
+uint16_t          protectLatency, checkpointHoldup, checkpointLatency;
+uint32_t          tariffUnknown;
+time_t            bootTime;
+const char       *protectReasons[] = { "none", "overcurrent", "overpower" };
+void             *logStore = &cfg;
+static float      demand;
+static time_t     now;
+
+static struct {
+  uint32_t  tariffPulses[TARIFF_BANDS];
+} nvHeader;
+
+static struct {
+  uint16_t  heap;
+} memLow;
+
+static struct {
+  uint32_t getFreeHeap(void) { return 23456; }
+  uint32_t getMaxFreeBlockSize(void) { return 19872; }
+  uint8_t getHeapFragmentation(void) { return 12; }
+  String getResetReason(void) { return String("Software/System restart"); }
+} ESP;
+
+static uint64_t allocs;
+
+static void *
+countMalloc(size_t n)
+{
+  allocs++;
+  return malloc(n);
+}
+
+static float
+demandAverage(void)
+{
+  return demand;
+}
+
+static double
+nowS(void)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: pagebench [-n renders] [-s seed]\n");
+  exit(2);
+}
+
+static void
+readings(void)
+{
+  voltage = 200 + drand48() * 50;
+  current = drand48() * 15;
+  power = voltage * current * (0.5 + drand48() / 2);
+  energy = drand48() * 100000;
+  for (uint8_t b = 0; b < TARIFF_BANDS; b++)
+    nvHeader.tariffPulses[b] = lrand48() % 100000000;
+  tariffBand = lrand48() % TARIFF_BANDS;
+  tariffUnknown = lrand48() % 1000;
+  demand = drand48() * 4000;
+  protectLatency = lrand48() % 2 ? UINT16_MAX : lrand48() % 60000;
+  state = lrand48() & (STATE_RELAY | STATE_SHED);
+  state |= STATE_NTP_GOT_TIME | STATE_FRAM_PRESENT;
+  now = 1700000000 + lrand48() % 100000000;
+  bootTime = now - lrand48() % 10000000;
+  memLow.heap = lrand48() % 30000;
+}
+
+// handleRoot() as it was, without the gzip encoder.
+static void
+rootPrintf(WiFiClient &client)
+{
+  Print     *out = &client;
+  struct tm *tm;
+  char       timestr[20], tariffs[192] = "", brownout[80] = "", trip[96] = "", demand[96] = "";
+  double     va, vars;
+  time_t     t = now, uptime = 0;
+  int        sec, min, hr, day;
+
+  va = voltage * current;
+  vars = va * va - power * power;
+  vars = vars > 0 ? sqrt(vars) : 0;
+
+  tm = localtime(&t);
+  strftime(timestr, 20, "%F %T", tm);
+
+  if (state & STATE_NTP_GOT_TIME)
+    uptime = t - bootTime;
+
+  sec = uptime % 60;
+  min = (uptime / 60) % 60;
+  hr = (uptime / 3600) % 24;
+  day = uptime / 86400;
+
+  if (cfg.flags & CFG_TARIFF) {
+    int len = 0;
+
+    for (uint8_t b = 0; b < TARIFF_BANDS; b++)
+      len += snprintf(tariffs + len, sizeof(tariffs) - len, "%sT%d: %.3lfkWh<br>",
+        b == tariffBand ? "&#9656;" : "", b + 1, nvHeader.tariffPulses[b] * kWhPerPulse);
+    if (tariffUnknown)
+      snprintf(tariffs + len, sizeof(tariffs) - len, "Before NTP: %.3lfkWh<br>", tariffUnknown * kWhPerPulse);
+  }
+
+  if (cfg.brownoutV && state & STATE_FRAM_PRESENT)
+    snprintf(brownout, sizeof(brownout), "<br>Brownout: %ums hold-up, %uus checkpoint",
+      checkpointHoldup, checkpointLatency);
+
+  if (cfg.demandMin && cfg.demandW)
+    snprintf(demand, sizeof(demand), "<p>Demand %.0fW of %dW over %d min%s",
+      demandAverage(), cfg.demandW, cfg.demandMin, state & STATE_SHED ? ", load shed" : "");
+  if (protectReason)
+    snprintf(trip, sizeof(trip), "<p>Tripped on %s in %s%uus, <a href='/tripreset'>Reset</a>",
+      protectReasons[protectReason], protectLatency == UINT16_MAX ? "over " : "", protectLatency);
+
+  client.print("HTTP/1.1 200 OK\nContent-Type: text/html\nVary: Accept-Encoding\n\n");
+  out->printf("<html lang='en'>"
+    "<head>"
+    "%s"
+    "<meta charset='UTF-8'>"
+    "<title>%s</title>"
+    "%s"
+    "<link rel='icon' type='image/x-icon' href='/favicon.ico'>"
+    "<style>"
+      "body { background-color: #cccccc; font-family: Arial, Helvetica, Sans-Serif; Color: #000088; }"
+      ".dygraph-legend {text-align: right;background: none;}"
+    "</style>"
+    "</head>"
+    "<body>"
+    "<h1>Switch %s</h1>"
+    "%s<p><span id='now'>"
+    "%.2fV %.3fA<br>"
+    "%.2fW<br>"
+    "%.2fVA<br>"
+    "%.2fVAR<br>"
+    "PF=%.1f<br>"
+    "%.6lfkWh<br>"
+    "</span>%s"
+    "<p>Plug is %s, turn %s"
+    "%s"
+    "%s"
+    "%s"
+    "%s"
+    "<p><a href='/config'>Configuration</a>"
+    "%s"
+    "%s"
+    "<p><font size=1>"
+    "Uptime: %d days %02d:%02d:%02d"
+    "<br>Firmware: %s"
+    "<br>Boot reason: %s"
+    "<br>Heap: %u free, %u max block, %u%% fragmented, %u low water"
+    "%s"
+    "</font>"
+    "%s"
+    "</body>"
+    "</html>",
+    logStore ? "" : "<meta http-equiv='Refresh' content='60; url=/'>",
+    cfg.hostname,
+    logStore ? "<script src='dygraph.min.js'></script><link rel='stylesheet' type='text/css' href='dygraph.css'>" : "",
+    cfg.hostname, timestr, voltage, current, power, va, vars,
+    voltage > 0 && current > 0 ? power / voltage / current : 1,
+    energy, tariffs,
+    state & STATE_RELAY ? "on" : "off", state & STATE_RELAY ? "<a href='/off'>Off</a>" : "<a href='/on'>On</a>",
+    trip, demand,
+    state & STATE_RELAY ? "<p><a href='/powercycle'>Load Power Cycle</a>" : "",
+    logStore ? "<div id='history'></div>" : "",
+    cfg.flags & CFG_SCHEDULE ? "<p><a href='/schedule'>Schedule</a>" : "",
+    cfg.flags & CFG_TARIFF ? "<p><a href='/tariff'>Tariffs</a>" : "",
+    day, hr, min, sec, AUTO_VERSION, ESP.getResetReason().c_str(),
+    (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxFreeBlockSize(), ESP.getHeapFragmentation(), (unsigned)memLow.heap,
+    brownout,
+    logStore ? rootScript : "");
+  client.stop();
+}
+
+// handleRoot() as it is.
+static void
+rootPage(WiFiClient &client)
+{
+  Page       page(client);
+  struct tm *tm;
+  char       timestr[20];
+  double     va, vars;
+  time_t     t = now, uptime = 0;
+
+  va = voltage * current;
+  vars = va * va - power * power;
+  vars = vars > 0 ? sqrt(vars) : 0;
+
+  tm = localtime(&t);
+  strftime(timestr, 20, "%F %T", tm);
+
+  if (state & STATE_NTP_GOT_TIME)
+    uptime = t - bootTime;
+
+  // Without the history script the page reloads itself.
+  page.begin(logStore ? 0 : 60, logStore ? FPSTR(rootHead) : NULL);
+  page(timestr, F("<p><span id='now'>"),
+    fixed(voltage, 2), F("V "), fixed(current, 3), F("A<br>"),
+    fixed(power, 2), F("W<br>"),
+    fixed(va, 2), F("VA<br>"),
+    fixed(vars, 2), F("VAR<br>PF="),
+    fixed(voltage > 0 && current > 0 ? power / voltage / current : 1, 1), F("<br>"),
+    fixed(energy, 6), F("kWh<br></span>"));
+  if (cfg.flags & CFG_TARIFF) {
+    for (uint8_t b = 0; b < TARIFF_BANDS; b++)
+      page(b == tariffBand ? F("&#9656;T") : F("T"), b + 1, F(": "),
+        fixed(nvHeader.tariffPulses[b] * kWhPerPulse, 3), F("kWh<br>"));
+    if (tariffUnknown)
+      page(F("Before NTP: "), fixed(tariffUnknown * kWhPerPulse, 3), F("kWh<br>"));
+  }
+  page(F("<p>Plug is "), state & STATE_RELAY ? F("on, turn <a href='/off'>Off</a>") : F("off, turn <a href='/on'>On</a>"));
+  if (protectReason)
+    page(F("<p>Tripped on "), protectReasons[protectReason], F(" in "), protectLatency == UINT16_MAX ? F("over ") : F(""),
+      protectLatency, F("us, <a href='/tripreset'>Reset</a>"));
+  if (cfg.demandMin && cfg.demandW)
+    page(F("<p>Demand "), fixed(demandAverage(), 0), F("W of "), cfg.demandW, F("W over "), cfg.demandMin, F(" min"),
+      state & STATE_SHED ? F(", load shed") : F(""));
+  if (state & STATE_RELAY)
+    page(F("<p><a href='/powercycle'>Load Power Cycle</a>"));
+  if (logStore)
+    page(F("<div id='history'></div>"));
+  page(F("<p><a href='/config'>Configuration</a>"));
+  if (cfg.flags & CFG_SCHEDULE)
+    page(F("<p><a href='/schedule'>Schedule</a>"));
+  if (cfg.flags & CFG_TARIFF)
+    page(F("<p><a href='/tariff'>Tariffs</a>"));
+  page(F("<p><font size=1>Uptime: "), (long)(uptime / 86400), F(" days "),
+    two(uptime / 3600 % 24), F(":"), two(uptime / 60 % 60), F(":"), two(uptime % 60),
+    F("<br>Firmware: "), AUTO_VERSION,
+    F("<br>Boot reason: "), ESP.getResetReason().c_str(),
+    F("<br>Heap: "), (unsigned)ESP.getFreeHeap(), F(" free, "), (unsigned)ESP.getMaxFreeBlockSize(), F(" max block, "),
+    (unsigned)ESP.getHeapFragmentation(), F("% fragmented, "), (unsigned)memLow.heap, F(" low water"));
+  if (cfg.brownoutV && state & STATE_FRAM_PRESENT)
+    page(F("<br>Brownout: "), (unsigned)checkpointHoldup, F("ms hold-up, "), (unsigned)checkpointLatency, F("us checkpoint"));
+  page(F("</font>"));
+  if (logStore)
+    page(FPSTR(rootScript));
+  page.end();
+}
+
+// The body between the heading and the tail, which both share.
+static std::string
+body(const std::string &page)
+{
+  size_t a = page.find("</h1>"), b = page.rfind("</body>");
+
+  return a == std::string::npos || b == std::string::npos ? page : page.substr(a, b - a);
+}
+
+// Where two bodies part, with some context.
+static void
+mismatch(int render, const std::string &a, const std::string &b)
+{
+  size_t at = std::mismatch(a.begin(), a.begin() + std::min(a.size(), b.size()), b.begin()).first - a.begin();
+  size_t from = at > 40 ? at - 40 : 0;
+
+  printf("render %d differs at %zu:\n  printf ...%.60s\n  Page   ...%.60s\n", render, at,
+    a.c_str() + from, b.c_str() + from);
+}
+
+static double
+timed(void (*render)(WiFiClient &), int renders, long seed, WiFiClient &client, uint64_t *n)
+{
+  double  start;
+
+  srand48(seed);
+  allocs = 0;
+  start = nowS();
+  for (int i = 0; i < renders; i++) {
+    readings();
+    client.sent.clear();
+    render(client);
+  }
+  *n = allocs;
+  return (nowS() - start) / renders * 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+  WiFiClient  a, b;
+  uint64_t    na, nb;
+  double      ta, tb;
+  long        seed = 1;
+  int         c, renders = RENDERS, differ = 0;
+  uint32_t    wa, wb;
+
+  while ((c = getopt(argc, argv, "n:s:")) != -1) {
+    switch (c) {
+      case 'n':
+        renders = atoi(optarg);
+        break;
+      case 's':
+        seed = atol(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc || renders < 1)
+    usage();
+
+  hostMalloc = countMalloc;
+  strcpy(cfg.hostname, "kitchen-kettle");
+  cfg.flags = CFG_TARIFF | CFG_SCHEDULE;
+  cfg.brownoutV = 180;
+  cfg.demandMin = 15;
+  cfg.demandW = 2400;
+  protectReason = 1;
+  checkpointHoldup = 38;
+  checkpointLatency = 1900;
+
+  srand48(seed);
+  for (int i = 0; i < renders; i++) {
+    readings();
+    a.sent.clear();
+    b.sent.clear();
+    rootPrintf(a);
+    rootPage(b);
+    if (body(a.sent) != body(b.sent) && differ++ < 3)
+      mismatch(i, body(a.sent), body(b.sent));
+  }
+
+  a.writes = b.writes = 0;
+  ta = timed(rootPrintf, renders, seed, a, &na);
+  wa = a.writes;
+  tb = timed(rootPage, renders, seed, b, &nb);
+  wb = b.writes;
+  printf("%d renders of the root page, %zu bytes, bodies %s\n", renders, b.sent.size(),
+    differ ? "differ" : "agree");
+  printf("printf %7.2f us, %.1f allocations, %.1f writes per render\n", ta, (double)na / renders, (double)wa / renders);
+  printf("Page   %7.2f us, %.1f allocations, %.1f writes per render\n", tb, (double)nb / renders, (double)wb / renders);
+  return differ != 0;
+}
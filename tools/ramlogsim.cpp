@@ -0,0 +1,166 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Feeds power traces through the RAM history in src/ramlog.cpp, checks
+ * every sample it holds against a plain copy and reports how far back it
+ * reaches.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o ramlogsim tools/ramlogsim.cpp src/ramlog.cpp src/logstore.cpp
+ *
+ *   ramlogsim [-d days] [-s seed]
+ *
+ * Each trace runs for -d days (default 7) of one minute samples, with the
+ * odd outage leaving gaps.  After each hour the history is read in order
+ * and at random and must match.  Reported are the hours held at the end and
+ * the bytes per sample; the old store held a fixed 51.2 hours.  The exit
+ * status is non-zero on any mismatch.
+ */
+
+#include <random>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "nvdata.h"
+#include "logstore.h"
+
+#define DAYS    7
+#define START   1699999980      // On a minute.
+
+struct nvHeader nvHeader;
+
+static std::mt19937 rng;
+
+enum { STEADY, FRIDGE, HEATER, WORST, TRACES };
+static const char *traces[] = { "steady", "fridge", "heater", "worst" };
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: ramlogsim [-d days] [-s seed]\n");
+  exit(2);
+}
+
+// Watts in minute m, negative for no sample.
+static float
+power(int trace, uint32_t m)
+{
+  std::uniform_real_distribution<float> noise(-2, 2);
+
+  if (m % 1440 == 700 && m / 1440 % 3 == 1)
+    return -1;                              // A few minutes off the air.
+  switch (trace) {
+    case STEADY:
+      return 60 + noise(rng);
+    case FRIDGE:
+      return (m % 45 < 15 ? 110 : 2) + noise(rng);
+    case HEATER:
+      return rng() % 3 ? 1500 + noise(rng) * 20 : 0;
+    default:
+      return m & 1 ? 6553.5 : 0;
+  }
+}
+
+static bool
+same(RamLog &log, const std::vector<int32_t> &ref, uint32_t i)
+{
+  struct nvLog  r;
+  uint32_t      at = ref.size() - log.count() + i;
+  bool          sample = log.read(i, &r);
+
+  if (r.time != START + (time_t)at * RAMLOG_PERIOD || sample != (ref[at] >= 0) || log.gap(i) == sample)
+    return false;
+  return !sample || (int32_t)(r.power * 10 + 0.5f) == ref[at];
+}
+
+static bool
+run(int trace, uint32_t days)
+{
+  RamLog                log;
+  std::vector<int32_t>  ref;
+  struct nvLog          r;
+  uint32_t              bad = 0, n;
+
+  if (!log.begin())
+    return false;
+  for (uint32_t m = 0; m < days * 1440; m++) {
+    float w = power(trace, m);
+
+    if (w >= 0) {
+      r.time = START + m * RAMLOG_PERIOD;
+      r.power = w;
+      log.add(&r);
+      ref.resize(m + 1, -1);
+      ref[m] = constrain(w, 0.0f, 6553.5f) * 10 + 0.5f;
+    }
+    if (m % 60 || !(n = log.count()))
+      continue;
+    for (uint32_t i = 0; i < n; i++)
+      bad += !same(log, ref, i);
+    for (uint32_t k = 0; k < 200; k++)
+      bad += !same(log, ref, rng() % n);
+  }
+  n = log.count();
+  printf("%-6s %6.1f hours, %u samples, %.2f bytes per sample, %u wrong\n", traces[trace],
+    n / 60.0, n, (double)RAMLOG_BLOCKS * RAMLOG_BLOCK / n, bad);
+  return !bad;
+}
+
+int
+main(int argc, char **argv)
+{
+  uint32_t  days = DAYS;
+  int       c;
+  bool      ok = true;
+
+  while ((c = getopt(argc, argv, "d:s:")) != -1) {
+    switch (c) {
+      case 'd':
+        days = atoi(optarg);
+        break;
+      case 's':
+        rng.seed(atoi(optarg));
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc || !days)
+    usage();
+
+  for (int t = 0; t < TRACES; t++)
+    ok &= run(t, days);
+  return !ok;
+}
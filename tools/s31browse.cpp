@@ -0,0 +1,289 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Lists the plugs on the LAN from their _s31._tcp mDNS adverts, the power
+ * and energy figures come from the TXT records so no plug is connected to.
+ *
+ *   c++ -O2 -o s31browse tools/s31browse.cpp
+ *   s31browse [-t seconds] [-w]
+ *
+ * Queries are repeated during the -t window (default 3 s) to catch lost
+ * answers.  -w keeps listening and reprints the table whenever a plug
+ * announces a change.
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MDNS_ADDR   "224.0.0.251"
+#define MDNS_PORT   5353
+#define SERVICE     "_s31._tcp.local"
+#define QUERIES     3
+
+#define T_A         1
+#define T_PTR       12
+#define T_TXT       16
+#define T_SRV       33
+
+struct srv {
+  std::string target;
+  uint16_t    port;
+};
+
+static std::set<std::string>                               instances;
+static std::map<std::string, struct srv>                   srvs;
+static std::map<std::string, std::map<std::string, std::string>> txts;
+static std::map<std::string, std::string>                  addrs;
+
+static std::string
+lower(std::string s)
+{
+  for (auto &c : s)
+    c = tolower((unsigned char)c);
+  return s;
+}
+
+// Read a possibly compressed name at off, returns the offset after it.
+static ssize_t
+name(const uint8_t *pkt, size_t len, size_t off, std::string &out)
+{
+  size_t  end = 0, hops = 0;
+
+  out.clear();
+  while (off < len) {
+    uint8_t n = pkt[off];
+
+    if (n == 0) {
+      if (!end)
+        end = off + 1;
+      return end;
+    }
+    if ((n & 0xc0) == 0xc0) {
+      if (off + 1 >= len || ++hops > 16)
+        return -1;
+      if (!end)
+        end = off + 2;
+      off = (n & 0x3f) << 8 | pkt[off + 1];
+      continue;
+    }
+    if (off + 1 + n > len)
+      return -1;
+    if (!out.empty())
+      out += '.';
+    out.append((const char *)pkt + off + 1, n);
+    off += 1 + n;
+  }
+  return -1;
+}
+
+static uint16_t
+get16(const uint8_t *p)
+{
+  return p[0] << 8 | p[1];
+}
+
+static void
+parse(const uint8_t *pkt, size_t len)
+{
+  std::string owner, value;
+  size_t      records, off = 12;
+  ssize_t     n;
+
+  if (len < 12 || !(pkt[2] & 0x80))
+    return;
+  for (uint16_t i = get16(pkt + 4); i; i--) {     // Skip questions.
+    if ((n = name(pkt, len, off, owner)) < 0)
+      return;
+    off = n + 4;
+  }
+  records = get16(pkt + 6) + get16(pkt + 8) + get16(pkt + 10);
+  while (records--) {
+    if ((n = name(pkt, len, off, owner)) < 0 || (size_t)n + 10 > len)
+      return;
+    const uint8_t *rr = pkt + n;
+    uint16_t      type = get16(rr), rdlen = get16(rr + 8);
+    size_t        rdata = n + 10;
+
+    if (rdata + rdlen > len)
+      return;
+    owner = lower(owner);
+    switch (type) {
+      case T_PTR:
+        if (owner == SERVICE && name(pkt, len, rdata, value) > 0)
+          instances.insert(lower(value));
+        break;
+      case T_SRV:
+        if (rdlen > 6 && name(pkt, len, rdata + 6, value) > 0)
+          srvs[owner] = { lower(value), get16(pkt + rdata + 4) };
+        break;
+      case T_TXT:
+        for (size_t p = rdata; p < rdata + rdlen && p + 1 + pkt[p] <= rdata + rdlen; p += 1 + pkt[p]) {
+          std::string kv((const char *)pkt + p + 1, pkt[p]);
+          size_t      eq = kv.find('=');
+
+          if (eq != std::string::npos)
+            txts[owner][kv.substr(0, eq)] = kv.substr(eq + 1);
+        }
+        break;
+      case T_A:
+        if (rdlen == 4) {
+          char ip[INET_ADDRSTRLEN];
+
+          inet_ntop(AF_INET, pkt + rdata, ip, sizeof(ip));
+          addrs[owner] = ip;
+        }
+        break;
+    }
+    off = rdata + rdlen;
+  }
+}
+
+static void
+query(int fd)
+{
+  uint8_t             pkt[64] = { 0 };
+  size_t              len = 12;
+  const char         *label = SERVICE;
+  struct sockaddr_in  to = {};
+
+  pkt[5] = 1;                                     // One question.
+  while (*label) {
+    const char *dot = strchr(label, '.');
+    size_t      n = dot ? (size_t)(dot - label) : strlen(label);
+
+    pkt[len++] = n;
+    memcpy(pkt + len, label, n);
+    len += n;
+    label += n + (dot ? 1 : 0);
+  }
+  pkt[len++] = 0;
+  pkt[len++] = 0;
+  pkt[len++] = T_PTR;
+  pkt[len++] = 0;
+  pkt[len++] = 1;                                 // IN
+  to.sin_family = AF_INET;
+  to.sin_port = htons(MDNS_PORT);
+  inet_pton(AF_INET, MDNS_ADDR, &to.sin_addr);
+  sendto(fd, pkt, len, 0, (struct sockaddr *)&to, sizeof(to));
+}
+
+static void
+table(void)
+{
+  printf("%-24s %-15s %-6s %10s %12s  %s\n", "NAME", "ADDRESS", "RELAY", "W", "KWH", "FIRMWARE");
+  for (auto &i : instances) {
+    auto        &txt = txts[i];
+    std::string  host = i.substr(0, i.find('.')), ip = "-";
+    auto         s = srvs.find(i);
+
+    if (s != srvs.end() && addrs.count(s->second.target))
+      ip = addrs[s->second.target];
+    printf("%-24s %-15s %-6s %10s %12s  %s\n", host.c_str(), ip.c_str(),
+      txt.count("relay") ? txt["relay"].c_str() : "-", txt.count("w") ? txt["w"].c_str() : "-",
+      txt.count("kwh") ? txt["kwh"].c_str() : "-", txt.count("fw") ? txt["fw"].c_str() : "-");
+  }
+  printf("%zu plugs\n", instances.size());
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct sockaddr_in  sin = {};
+  struct ip_mreq      mreq = {};
+  uint8_t             pkt[1500];
+  bool                watch = false;
+  int                 ch, fd, one = 1, timeout = 3;
+
+  while ((ch = getopt(argc, argv, "t:w")) != -1) {
+    switch (ch) {
+      case 't':
+        timeout = atoi(optarg);
+        break;
+      case 'w':
+        watch = true;
+        break;
+      default:
+        fprintf(stderr, "usage: s31browse [-t seconds] [-w]\n");
+        return 2;
+    }
+  }
+
+  // Share 5353 with any local responder and hear multicast answers.
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(MDNS_PORT);
+  inet_pton(AF_INET, MDNS_ADDR, &mreq.imr_multiaddr);
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+      bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+    perror("mdns socket");
+    return 1;
+  }
+
+  time_t  start = time(NULL), next = start;
+  int     sent = 0;
+  bool    changed = false;
+
+  for (;;) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    ssize_t       n;
+
+    if (sent < QUERIES && time(NULL) >= next) {
+      query(fd);
+      sent++;
+      next += (timeout + QUERIES - 1) / QUERIES;
+    }
+    if (!watch && time(NULL) >= start + timeout)
+      break;
+    if (poll(&pfd, 1, 250) > 0 && (n = recv(fd, pkt, sizeof(pkt), 0)) > 0) {
+      parse(pkt, n);
+      changed = true;
+    }
+    if (watch && changed && time(NULL) >= start + timeout) {
+      table();
+      changed = false;
+    }
+  }
+  table();
+  return 0;
+}
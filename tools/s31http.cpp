@@ -0,0 +1,250 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Measures how many requests a plug answers per second, typically for the
+ * static assets.
+ *
+ *   c++ -O2 -o s31http tools/s31http.cpp
+ *
+ *   s31http [-c conns] [-n requests] [-t ms] [-I] [-H header] ... host[:port] path ...
+ *
+ * Sends -n requests (default 200) with -c in flight (default 2, the plug
+ * only serves one at a time), cycling through the paths.  -I sends HEAD
+ * rather than GET and each -H adds a request header, for instance
+ * "Accept-Encoding: gzip", "If-None-Match: <etag>" or "Range: bytes=0-1023".
+ * Reports the rate, the status codes seen, the body bytes and latencies.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONNS       2
+#define REQUESTS    200
+#define TIMEOUT_MS  5000
+
+struct conn {
+  int         fd;
+  size_t      path;
+  bool        sent;
+  uint64_t    started;
+  std::string buf;
+};
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool
+resolve(const std::string &spec, struct sockaddr_in *sin)
+{
+  std::string       name = spec, port = "80";
+  size_t            colon = spec.rfind(':');
+  struct addrinfo   hints = {}, *ai;
+
+  if (colon != std::string::npos) {
+    name = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+  }
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(atoi(port.c_str()));
+  if (inet_pton(AF_INET, name.c_str(), &sin->sin_addr) == 1)
+    return true;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(name.c_str(), port.c_str(), &hints, &ai) != 0)
+    return false;
+  *sin = *(struct sockaddr_in *)ai->ai_addr;
+  freeaddrinfo(ai);
+  return true;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: s31http [-c conns] [-n requests] [-t ms] [-I] [-H header] ... host[:port] path ...\n");
+  exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct sockaddr_in        addr;
+  std::vector<std::string>  paths, requests;
+  std::string               host, headers;
+  std::set<struct conn *>   conns;
+  std::map<int, uint32_t>   statuses;
+  std::vector<uint64_t>     latency;
+  struct epoll_event        events[64];
+  uint64_t                  bytes = 0, start, elapsed;
+  uint32_t                  sent = 0, done = 0, failures = 0;
+  int                       opt, maxConns = CONNS, total = REQUESTS, timeout = TIMEOUT_MS, ep;
+  const char               *method = "GET";
+
+  while ((opt = getopt(argc, argv, "c:n:t:IH:")) != -1) {
+    switch (opt) {
+      case 'c': maxConns = std::max(1, atoi(optarg)); break;
+      case 'n': total = std::max(1, atoi(optarg)); break;
+      case 't': timeout = atoi(optarg); break;
+      case 'I': method = "HEAD"; break;
+      case 'H': headers += std::string(optarg) + "\r\n"; break;
+      default: usage();
+    }
+  }
+  if (argc - optind < 2)
+    usage();
+  host = argv[optind++];
+  if (!resolve(host, &addr)) {
+    fprintf(stderr, "s31http: can't resolve %s\n", host.c_str());
+    return 1;
+  }
+  for (; optind < argc; optind++) {
+    paths.push_back(argv[optind]);
+    requests.push_back(std::string(method) + " " + argv[optind] + " HTTP/1.1\r\nHost: " + host +
+      "\r\nConnection: close\r\n" + headers + "\r\n");
+  }
+
+  ep = epoll_create1(0);
+  start = nowNs();
+  while (done < (uint32_t)total) {
+    while (sent < (uint32_t)total && conns.size() < (size_t)maxConns) {
+      struct epoll_event  ev;
+      struct conn        *c;
+      int                 fd, one = 1;
+
+      if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        perror("socket");
+        return 1;
+      }
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        failures++;
+        done++;
+        sent++;
+        continue;
+      }
+      c = new conn{ fd, sent % paths.size(), false, nowNs(), "" };
+      ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+      ev.data.ptr = c;
+      epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+      conns.insert(c);
+      sent++;
+    }
+
+    int n = epoll_wait(ep, events, 64, 100);
+
+    for (int i = 0; i < n; i++) {
+      struct conn *c = (struct conn *)events[i].data.ptr;
+      bool         finished = false;
+
+      if (!c->sent && events[i].events & EPOLLOUT) {
+        const std::string &r = requests[c->path];
+
+        if (write(c->fd, r.data(), r.size()) != (ssize_t)r.size())
+          finished = true;
+        c->sent = true;
+        epoll_event ev = { EPOLLIN | EPOLLRDHUP, { c } };
+        epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+      }
+      if (!finished && events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        char    buf[16384];
+        ssize_t r;
+
+        while ((r = read(c->fd, buf, sizeof(buf))) > 0)
+          c->buf.append(buf, r);
+        finished = r == 0 || (r < 0 && errno != EAGAIN);
+      }
+      if (!finished)
+        continue;
+
+      size_t  eoh = c->buf.find("\r\n\r\n");
+      int     status = 0;
+
+      if (eoh != std::string::npos && sscanf(c->buf.c_str(), "HTTP/1.%*d %d", &status) == 1) {
+        statuses[status]++;
+        bytes += c->buf.size() - eoh - 4;
+        latency.push_back(nowNs() - c->started);
+      } else
+        failures++;
+      ::close(c->fd);
+      conns.erase(c);
+      delete c;
+      done++;
+    }
+
+    // Give up on requests that have stalled.
+    for (auto it = conns.begin(); it != conns.end(); ) {
+      struct conn *c = *it;
+
+      if (nowNs() - c->started < timeout * 1000000ULL) {
+        ++it;
+        continue;
+      }
+      ::close(c->fd);
+      it = conns.erase(it);
+      delete c;
+      failures++;
+      done++;
+    }
+  }
+  elapsed = nowNs() - start;
+
+  std::sort(latency.begin(), latency.end());
+  printf("%u requests in %.3f s, %.1f requests/s, %u failed\n", (unsigned)total, elapsed / 1e9,
+    total * 1e9 / elapsed, (unsigned)failures);
+  for (auto &s : statuses)
+    printf("  %d: %u\n", s.first, (unsigned)s.second);
+  printf("body %llu bytes, %.1f KB/s\n", (unsigned long long)bytes, bytes * 1e9 / elapsed / 1024);
+  if (latency.size())
+    printf("latency ms: p50 %.2f p99 %.2f max %.2f\n", latency[latency.size() / 2] / 1e6,
+      latency[latency.size() * 99 / 100] / 1e6, latency.back() / 1e6);
+  return failures != 0;
+}
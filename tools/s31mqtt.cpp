@@ -0,0 +1,447 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Watches a plug's MQTT traffic through a broker, typically a local
+ * mosquitto, and reports the publish rate, bytes and the history replay.
+ *
+ *   c++ -O2 -o s31mqtt tools/s31mqtt.cpp
+ *
+ *   s31mqtt [-b broker[:port]] [-u user -P pass] [-t seconds] [-r toggles] [-d host[:port]] name
+ *   s31mqtt [-b broker[:port]] [-u user -P pass] [-t seconds] mock name
+ *
+ * Subscribes to s31/<name>/# for -t seconds (default 60) and prints the
+ * messages, bytes and rate per topic.  History rows are checked to arrive in
+ * time order without repeats.  -r sends that many TOGGLE commands, one a
+ * second, and times the state message that answers each.  -d fetches the
+ * plug's /debug/mqtt at the end for its own publish times and the heap the
+ * client took.
+ *
+ * "mock" publishes as a plug would, state messages back to back and a
+ * history batch of 32 rows after every tenth, and answers relay commands,
+ * so that the broker and this tool can be measured without a device.
+ */
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BROKER      "127.0.0.1:1883"
+#define SECONDS     60
+#define KEEPALIVE   60
+#define BATCH       32          // MQTT_BATCH in include/mqtt.h.
+
+struct topicStats {
+  uint64_t  messages;
+  uint64_t  bytes;
+};
+
+static const char  *user, *pass;
+static std::string  base;
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,
+    "usage: s31mqtt [-b broker[:port]] [-u user -P pass] [-t seconds] [-r toggles] [-d host[:port]] name\n"
+    "       s31mqtt [-b broker[:port]] [-u user -P pass] [-t seconds] mock name\n");
+  exit(2);
+}
+
+static bool
+resolve(const std::string &spec, const char *fallback, struct sockaddr_in *sin)
+{
+  std::string       name = spec, port = fallback;
+  size_t            colon = spec.rfind(':');
+  struct addrinfo   hints = {}, *ai;
+
+  if (colon != std::string::npos) {
+    name = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+  }
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(atoi(port.c_str()));
+  if (inet_pton(AF_INET, name.c_str(), &sin->sin_addr) == 1)
+    return true;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(name.c_str(), port.c_str(), &hints, &ai) != 0)
+    return false;
+  *sin = *(struct sockaddr_in *)ai->ai_addr;
+  freeaddrinfo(ai);
+  return true;
+}
+
+static void
+putString(std::string &p, const std::string &s)
+{
+  p += (char)(s.size() >> 8);
+  p += (char)s.size();
+  p += s;
+}
+
+// Fixed header and remaining length in front of the variable part.
+static bool
+sendPacket(int fd, uint8_t type, const std::string &body)
+{
+  std::string p(1, (char)type);
+  size_t      len = body.size();
+
+  do {
+    p += (char)((len & 0x7f) | (len > 0x7f ? 0x80 : 0));
+    len >>= 7;
+  } while (len);
+  p += body;
+  for (size_t off = 0; off < p.size(); ) {
+    ssize_t n = send(fd, p.data() + off, p.size() - off, MSG_NOSIGNAL);
+
+    if (n <= 0)
+      return false;
+    off += n;
+  }
+  return true;
+}
+
+static bool
+readFull(int fd, void *buf, size_t len)
+{
+  for (size_t off = 0; off < len; ) {
+    ssize_t n = recv(fd, (char *)buf + off, len - off, 0);
+
+    if (n <= 0)
+      return false;
+    off += n;
+  }
+  return true;
+}
+
+static bool
+readPacket(int fd, uint8_t *type, std::string &body)
+{
+  uint8_t   b;
+  size_t    len = 0;
+  int       shift = 0;
+
+  if (!readFull(fd, type, 1))
+    return false;
+  do {
+    if (!readFull(fd, &b, 1) || shift > 21)
+      return false;
+    len |= (size_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+  body.resize(len);
+  return !len || readFull(fd, &body[0], len);
+}
+
+static int
+connectBroker(const char *spec, const std::string &id)
+{
+  struct sockaddr_in  sin;
+  std::string         p, reply;
+  uint8_t             type;
+  int                 fd, on = 1;
+
+  if (!resolve(spec, "1883", &sin)) {
+    fprintf(stderr, "%s: unknown host\n", spec);
+    return -1;
+  }
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      connect(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    perror(spec);
+    return -1;
+  }
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  putString(p, "MQTT");
+  p += (char)4;
+  p += (char)(0x02 | (user ? 0x80 : 0) | (pass ? 0x40 : 0));
+  p += (char)(KEEPALIVE >> 8);
+  p += (char)KEEPALIVE;
+  putString(p, id);
+  if (user)
+    putString(p, user);
+  if (pass)
+    putString(p, pass);
+  if (!sendPacket(fd, 0x10, p) || !readPacket(fd, &type, reply) ||
+      type != 0x20 || reply.size() != 2 || reply[1]) {
+    fprintf(stderr, "%s: connect refused\n", spec);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool
+subscribe(int fd, const std::string &topic)
+{
+  std::string p("\0\1", 2);
+
+  putString(p, topic);
+  p += (char)0;
+  return sendPacket(fd, 0x82, p);
+}
+
+static bool
+publish(int fd, const std::string &topic, const std::string &payload, bool retain = false)
+{
+  std::string p;
+
+  putString(p, topic);
+  p += payload;
+  return sendPacket(fd, 0x30 | retain, p);
+}
+
+// The body of a plain HTTP/1.0 GET, for the plug's own figures.
+static std::string
+fetch(const char *spec, const char *path)
+{
+  struct sockaddr_in  sin;
+  std::string         reply;
+  char                buf[1024];
+  ssize_t             n;
+  int                 fd;
+  size_t              body;
+
+  if (!resolve(spec, "80", &sin) || (fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    return "";
+  if (connect(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0) {
+    n = snprintf(buf, sizeof(buf), "GET %s HTTP/1.0\r\n\r\n", path);
+    send(fd, buf, n, MSG_NOSIGNAL);
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+      reply.append(buf, n);
+  }
+  close(fd);
+  body = reply.find("\r\n\r\n");
+  return body == std::string::npos ? "" : reply.substr(body + 4);
+}
+
+static bool
+relayOn(const std::string &payload)
+{
+  return payload.find("\"relay\":\"ON\"") != std::string::npos;
+}
+
+static int
+watch(const char *broker, const char *plug, int seconds, int toggles)
+{
+  std::map<std::string, struct topicStats>  topics;
+  std::vector<uint64_t>                     rtt;
+  std::string                               body, topic;
+  uint64_t                                  start, end, now, toggled = 0, ping;
+  uint64_t                                  rows = 0, late = 0, repeats = 0;
+  long long                                 newest = 0;
+  struct pollfd                             pfd;
+  uint8_t                                   type;
+  int                                       fd, sentToggles = 0, relay = -1;
+
+  if ((fd = connectBroker(broker, "s31mqtt-" + std::to_string(getpid()))) < 0 ||
+      !subscribe(fd, base + "/#"))
+    return 1;
+  start = ping = nowNs();
+  end = start + seconds * 1000000000ULL;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while ((now = nowNs()) < end) {
+    if (sentToggles < toggles && !toggled && now - start >= (sentToggles + 1) * 1000000000ULL) {
+      if (!publish(fd, base + "/relay/set", "TOGGLE"))
+        break;
+      toggled = now;
+      sentToggles++;
+    }
+    if (now - ping >= KEEPALIVE / 2 * 1000000000ULL) {
+      sendPacket(fd, 0xc0, "");
+      ping = now;
+    }
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    if (!readPacket(fd, &type, body)) {
+      fprintf(stderr, "%s: connection lost\n", broker);
+      break;
+    }
+    if ((type & 0xf0) != 0x30 || body.size() < 2)
+      continue;
+
+    size_t  len = (uint8_t)body[0] << 8 | (uint8_t)body[1];
+    size_t  off = 2 + len + ((type & 0x06) ? 2 : 0);
+
+    if (off > body.size())
+      continue;
+    topic = body.substr(2 + base.size(), len - base.size());
+    body.erase(0, off);
+    topics[topic].messages++;
+    topics[topic].bytes += body.size();
+
+    if (topic == "/state") {
+      if (toggled && relay >= 0 && relayOn(body) != relay) {
+        rtt.push_back(nowNs() - toggled);
+        toggled = 0;
+      }
+      relay = relayOn(body);
+    } else if (topic == "/history") {
+      for (size_t p = 0; p < body.size(); ) {
+        size_t      nl = body.find('\n', p);
+        long long   t = atoll(body.c_str() + p);
+
+        if (t == newest)
+          repeats++;
+        else if (t < newest)
+          late++;
+        newest = std::max(newest, t);
+        rows++;
+        if (nl == std::string::npos)
+          break;
+        p = nl + 1;
+      }
+    }
+  }
+  close(fd);
+
+  double elapsed = (nowNs() - start) / 1e9;
+
+  for (auto &t : topics)
+    printf("%-28s %8llu messages %10llu bytes %8.1f/s %8.0f B/s\n", (base + t.first).c_str(),
+      (unsigned long long)t.second.messages, (unsigned long long)t.second.bytes,
+      t.second.messages / elapsed, t.second.bytes / elapsed);
+  printf("History: %llu rows, %llu out of order, %llu repeated\n",
+    (unsigned long long)rows, (unsigned long long)late, (unsigned long long)repeats);
+  if (toggles) {
+    std::sort(rtt.begin(), rtt.end());
+    printf("Toggles: %zu of %d answered", rtt.size(), sentToggles);
+    if (!rtt.empty())
+      printf(", round trip min %.1f median %.1f max %.1f ms", rtt.front() / 1e6,
+        rtt[rtt.size() / 2] / 1e6, rtt.back() / 1e6);
+    printf("\n");
+  }
+  if (plug)
+    printf("%s", fetch(plug, "/debug/mqtt").c_str());
+  return late || repeats ? 1 : 0;
+}
+
+static int
+mock(const char *broker, int seconds)
+{
+  std::string     body, history;
+  uint64_t        start = nowNs(), end = start + seconds * 1000000000ULL;
+  uint64_t        messages = 0, bytes = 0;
+  long long       t = time(NULL) - 1000000;
+  struct pollfd   pfd;
+  uint8_t         type;
+  bool            on = false;
+  char            payload[160];
+  int             fd;
+
+  if ((fd = connectBroker(broker, "s31mock-" + std::to_string(getpid()))) < 0 ||
+      !subscribe(fd, base + "/relay/set") ||
+      !publish(fd, base + "/status", "online", true))
+    return 1;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (nowNs() < end) {
+    while (poll(&pfd, 1, 0) > 0) {
+      if (!readPacket(fd, &type, body))
+        return 1;
+      if ((type & 0xf0) == 0x30 && body.size() >= 6 && !body.compare(body.size() - 6, 6, "TOGGLE"))
+        on = !on;
+    }
+    snprintf(payload, sizeof(payload),
+      "{\"time\":%lld,\"voltage\":%.2f,\"current\":%.3f,\"power\":%.2f,\"energy\":%.6lf,\"relay\":\"%s\"}",
+      (long long)time(NULL), 230.0, on ? 0.435 : 0.0, on ? 100.0 : 0.0, messages / 3600.0, on ? "ON" : "OFF");
+    if (!publish(fd, base + "/state", payload))
+      break;
+    bytes += strlen(payload);
+    if (++messages % 10 == 0) {
+      history.clear();
+      for (int i = 0; i < BATCH; i++) {
+        snprintf(payload, sizeof(payload), "%lld,%.1f\n", t += 10, 100.0);
+        history += payload;
+      }
+      if (!publish(fd, base + "/history", history))
+        break;
+      bytes += history.size();
+    }
+  }
+  publish(fd, base + "/status", "offline", true);
+  sendPacket(fd, 0xe0, "");
+  close(fd);
+  printf("Published %llu state messages, %llu bytes, %.0f/s\n", (unsigned long long)messages,
+    (unsigned long long)bytes, messages / ((nowNs() - start) / 1e9));
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char  *broker = BROKER, *plug = NULL;
+  int          ch, seconds = SECONDS, toggles = 0;
+
+  while ((ch = getopt(argc, argv, "b:d:P:r:t:u:")) != -1) {
+    switch (ch) {
+      case 'b': broker = optarg; break;
+      case 'd': plug = optarg; break;
+      case 'P': pass = optarg; break;
+      case 'r': toggles = atoi(optarg); break;
+      case 't': seconds = std::max(1, atoi(optarg)); break;
+      case 'u': user = optarg; break;
+      default: usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc == 2 && !strcmp(argv[0], "mock")) {
+    base = std::string("s31/") + argv[1];
+    return mock(broker, seconds);
+  }
+  if (argc != 1)
+    usage();
+  base = std::string("s31/") + argv[0];
+  return watch(broker, plug, seconds, toggles);
+}
@@ -0,0 +1,462 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Pushes a config template to many plugs at once, or saves each plug's
+ * config, over /api/v1/config.
+ *
+ *   c++ -O2 -o s31push tools/s31push.cpp
+ *
+ *   s31push [-c conns] [-t ms] -s template.json host[:port] ... | -f hostfile
+ *   s31push [-c conns] [-t ms] -g dir host[:port] ... | -f hostfile
+ *   s31push mock -n plugs [-p port]
+ *
+ * The template is any part of the document GET returns; members left out
+ * are kept by each plug, so it usually carries only what the fleet shares.
+ * "{host}" in it is replaced by the plug's name without the port, for
+ * instance "hostname":"{host}".  -g writes each plug's config to dir/host.json
+ * (host_port.json with a port), which can be edited and pushed back; GET
+ * leaves out psk, udpKey and mqttPass, so a pushed file keeps them.  -c
+ * connections are in flight from one epoll loop (default 64) and -t ms are
+ * allowed per plug.  A line is printed per plug and the exit status is
+ * non-zero if any failed.
+ *
+ * "mock" serves that many fake plugs on consecutive loopback ports.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONNS       64
+#define TIMEOUT_MS  5000
+#define MOCK_PORT   21000
+
+struct host {
+  std::string         name;
+  struct sockaddr_in  addr;
+  std::string         request;
+  std::string         reply;    // Body.
+  int                 code;
+  uint64_t            elapsed;
+};
+
+struct conn {
+  size_t      host;
+  int         fd;
+  size_t      sent;
+  uint64_t    started;
+  std::string buf;
+};
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+raiseFiles(void)
+{
+  struct rlimit rl;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+static bool
+resolve(const std::string &spec, struct sockaddr_in *sin)
+{
+  std::string       name = spec, port = "80";
+  size_t            colon = spec.rfind(':');
+  struct addrinfo   hints = {}, *ai;
+
+  if (colon != std::string::npos) {
+    name = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+  }
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(atoi(port.c_str()));
+  if (inet_pton(AF_INET, name.c_str(), &sin->sin_addr) == 1)
+    return true;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(name.c_str(), port.c_str(), &hints, &ai) != 0)
+    return false;
+  *sin = *(struct sockaddr_in *)ai->ai_addr;
+  freeaddrinfo(ai);
+  return true;
+}
+
+static bool
+readFile(const char *path, std::string &s)
+{
+  FILE   *f = fopen(path, "r");
+  char    buf[4096];
+  size_t  n;
+
+  if (!f)
+    return false;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    s.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+static std::string
+substitute(std::string s, const std::string &name)
+{
+  std::string host = name.substr(0, name.rfind(':'));
+
+  for (size_t at = 0; (at = s.find("{host}", at)) != std::string::npos; at += host.size())
+    s.replace(at, 6, host);
+  return s;
+}
+
+/*
+ * Every plug gets one request on its own connection, at most conns at a
+ * time, and the reply is complete when the plug closes the connection.
+ */
+static void
+run(std::vector<struct host> &hosts, int maxConns, int timeout)
+{
+  std::set<struct conn *>   conns;
+  struct epoll_event        events[256];
+  size_t                    next = 0;
+  int                       ep = epoll_create1(0);
+
+  while (next < hosts.size() || !conns.empty()) {
+    while (next < hosts.size() && conns.size() < (size_t)maxConns) {
+      struct host        &h = hosts[next];
+      struct epoll_event  ev;
+      struct conn        *c;
+      int                 fd, one = 1;
+
+      h.code = -1;
+      if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0 ||
+          (connect(fd, (struct sockaddr *)&h.addr, sizeof(h.addr)) < 0 && errno != EINPROGRESS)) {
+        if (fd >= 0)
+          close(fd);
+        next++;
+        continue;
+      }
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      c = new conn{ next++, fd, 0, nowNs(), "" };
+      ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+      ev.data.ptr = c;
+      epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+      conns.insert(c);
+    }
+
+    int n = epoll_wait(ep, events, 256, 100);
+
+    for (int i = 0; i < n; i++) {
+      struct conn  *c = (struct conn *)events[i].data.ptr;
+      struct host  &h = hosts[c->host];
+      bool          finished = false;
+      char          buf[16384];
+      ssize_t       r;
+
+      if (c->sent < h.request.size() && events[i].events & EPOLLOUT) {
+        r = send(c->fd, h.request.data() + c->sent, h.request.size() - c->sent, MSG_NOSIGNAL);
+        if (r < 0 && errno != EAGAIN)
+          finished = true;
+        else if (r > 0 && (c->sent += r) == h.request.size()) {
+          struct epoll_event ev = { EPOLLIN | EPOLLRDHUP, { c } };
+
+          epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+        }
+      }
+      if (!finished && events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        while ((r = recv(c->fd, buf, sizeof(buf), 0)) > 0)
+          c->buf.append(buf, r);
+        finished = r == 0 || (r < 0 && errno != EAGAIN);
+      }
+      if (!finished)
+        continue;
+
+      size_t end = c->buf.find("\r\n\r\n");
+
+      if (end != std::string::npos && sscanf(c->buf.c_str(), "HTTP/1.%*d %d", &h.code) == 1)
+        h.reply = c->buf.substr(end + 4);
+      h.elapsed = nowNs() - c->started;
+      epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+      close(c->fd);
+      conns.erase(c);
+      delete c;
+    }
+
+    // Give up on plugs that have stalled.
+    for (auto it = conns.begin(); it != conns.end(); ) {
+      struct conn *c = *it;
+
+      if (nowNs() - c->started < timeout * 1000000ULL) {
+        ++it;
+        continue;
+      }
+      hosts[c->host].elapsed = nowNs() - c->started;
+      close(c->fd);
+      it = conns.erase(it);
+      delete c;
+    }
+  }
+  close(ep);
+}
+
+/*
+ * Mock plugs
+ */
+
+static void
+mockReply(int fd, int plug, const std::string &req)
+{
+  std::string   resp;
+  char          body[160];
+
+  if (!req.compare(0, 22, "GET /api/v1/config HTT")) {
+    snprintf(body, sizeof(body), "{\"hostname\":\"mock%d\",\"ssid\":\"net\",\"schedule\":{\"random\":[false,false,false,false,false,false,false]}}\n", plug);
+    resp = std::string("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n") + body;
+  }
+  else if (!req.compare(0, 22, "PUT /api/v1/config HTT")) {
+    size_t  last = req.find_last_not_of(" \t\r\n");
+    bool    ok = req.find("\r\n\r\n{") != std::string::npos && last != std::string::npos && req[last] == '}';
+
+    resp = ok ? "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n{\"saved\":true,\"rejected\":0}\n" :
+      "HTTP/1.1 400 Bad Request\r\nContent-Type: application/json\r\n\r\n{\"error\":\"malformed\"}\n";
+  }
+  else
+    resp = "HTTP/1.1 404 Not Found\r\n\r\n";
+  send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+}
+
+// Answer once the header and Content-Length bytes of body have arrived.
+static int
+mock(int plugs, int port)
+{
+  struct epoll_event              ev;
+  std::vector<struct epoll_event> events(1024);
+  std::map<int, std::string>      pending;
+  std::map<int, int>              plugOf;
+  int                             ep = epoll_create1(0), one = 1;
+
+  raiseFiles();
+  for (int i = 0; i < plugs; i++) {
+    struct sockaddr_in  sin = {};
+    int                 fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port + i);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(fd, 64) < 0) {
+      perror("mock listen");
+      return 1;
+    }
+    plugOf[fd] = -1 - i;                          // Negative marks a listener.
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  for (;;) {
+    int n = epoll_wait(ep, events.data(), events.size(), -1);
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd, plug = plugOf[fd], c;
+
+      if (plug < 0) {
+        while ((c = accept4(fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+          plugOf[c] = -1 - plug;
+          ev.events = EPOLLIN;
+          ev.data.fd = c;
+          epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+        }
+        continue;
+      }
+
+      char    buf[4096];
+      ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+      if (len > 0) {
+        std::string &req = pending[fd];
+        size_t       end, at;
+
+        req.append(buf, len);
+        if ((end = req.find("\r\n\r\n")) == std::string::npos)
+          continue;
+        at = req.find("Content-Length: ");
+        if (at != std::string::npos && at < end && req.size() < end + 4 + atoi(req.c_str() + at + 16))
+          continue;
+        mockReply(fd, plug, req);
+      }
+      else if (len < 0 && errno == EAGAIN)
+        continue;
+      epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+      close(fd);
+      pending.erase(fd);
+      plugOf.erase(fd);
+    }
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,
+    "usage: s31push [-c conns] [-t ms] -s template.json host[:port] ... | -f hostfile\n"
+    "       s31push [-c conns] [-t ms] -g dir host[:port] ... | -f hostfile\n"
+    "       s31push mock -n plugs [-p port]\n");
+  exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+  std::vector<struct host>  hosts;
+  std::vector<std::string>  names;
+  std::string               tmpl;
+  const char               *push = NULL, *dir = NULL, *hostFile = NULL;
+  int                       ch, conns = CONNS, timeout = TIMEOUT_MS, plugs = 10, port = MOCK_PORT;
+  uint32_t                  failed = 0;
+  uint64_t                  start;
+  bool                      mocking = argc > 1 && !strcmp(argv[1], "mock");
+
+  if (mocking) {
+    argc--;
+    argv++;
+  }
+  while ((ch = getopt(argc, argv, "c:f:g:n:p:s:t:")) != -1) {
+    switch (ch) {
+      case 'c': conns = std::max(1, atoi(optarg)); break;
+      case 'f': hostFile = optarg; break;
+      case 'g': dir = optarg; break;
+      case 'n': plugs = atoi(optarg); break;
+      case 'p': port = atoi(optarg); break;
+      case 's': push = optarg; break;
+      case 't': timeout = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (mocking)
+    return mock(plugs, port);
+  if (!push == !dir)
+    usage();
+  if (push && !readFile(push, tmpl)) {
+    perror(push);
+    return 1;
+  }
+
+  for (int i = optind; i < argc; i++)
+    names.push_back(argv[i]);
+  if (hostFile) {
+    FILE *f = fopen(hostFile, "r");
+    char  line[256];
+
+    if (!f) {
+      perror(hostFile);
+      return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+      line[strcspn(line, " \t\r\n#")] = '\0';
+      if (line[0])
+        names.push_back(line);
+    }
+    fclose(f);
+  }
+  if (names.empty())
+    usage();
+  raiseFiles();
+  for (auto &n : names) {
+    struct host h = {};
+
+    h.name = n;
+    if (!resolve(n, &h.addr)) {
+      fprintf(stderr, "%s: unknown host\n", n.c_str());
+      failed++;
+      continue;
+    }
+    if (push) {
+      std::string body = substitute(tmpl, n);
+
+      h.request = "PUT /api/v1/config HTTP/1.0\r\nContent-Type: application/json\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+    else
+      h.request = "GET /api/v1/config HTTP/1.0\r\n\r\n";
+    hosts.push_back(h);
+  }
+
+  start = nowNs();
+  run(hosts, conns, timeout);
+  for (auto &h : hosts) {
+    bool ok = h.code == 200;
+
+    if (ok && dir) {
+      std::string path = std::string(dir) + "/" + h.name + ".json";
+      FILE       *f;
+
+      std::replace(path.begin() + strlen(dir), path.end(), ':', '_');
+      f = fopen(path.c_str(), "w");
+
+      ok = f && fwrite(h.reply.data(), 1, h.reply.size(), f) == h.reply.size();
+      if (f)
+        fclose(f);
+    }
+    if (!ok)
+      failed++;
+    h.reply.erase(h.reply.find_last_not_of("\r\n") + 1);
+    if (h.code < 0)
+      printf("%s: no reply, %.1f ms\n", h.name.c_str(), h.elapsed / 1e6);
+    else
+      printf("%s: %d %s, %.1f ms\n", h.name.c_str(), h.code, dir && ok ? "saved" : h.reply.c_str(), h.elapsed / 1e6);
+  }
+  fprintf(stderr, "%zu plugs in %.1f ms, %u failed\n", hosts.size(), (nowNs() - start) / 1e6, (unsigned)failed);
+  return failed != 0;
+}
@@ -0,0 +1,703 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Scrapes status and history from many plugs at once and merges the history
+ * into one time aligned CSV with a column per plug.
+ *
+ *   c++ -O2 -o s31scrape tools/s31scrape.cpp
+ *
+ *   s31scrape [-c conns] [-t ms] [-b seconds] [-i seconds] [-o file] [-s file] host[:port] ... | -f hostfile
+ *   s31scrape mock -n plugs [-p port]
+ *   s31scrape bench -n plugs [-p port] [-c conns]
+ *
+ * Each plug is asked for /api/v1/status then /data.txt?epoch&since=<last>,
+ * one connection each, with -c connections in flight from a single epoll
+ * loop and -t ms allowed per request.  History is averaged into -b second
+ * buckets (default 10) and written to -o (default stdout); -s writes a status
+ * row per plug.  With -i the scrape repeats, asking each plug only for rows
+ * newer than it has already sent and appending the new buckets.
+ *
+ * "mock" serves that many fake plugs on consecutive loopback ports with an
+ * hour of history each.  "bench" runs the mock in a child and times a full
+ * scrape and an incremental one against it.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONNS       512
+#define TIMEOUT_MS  2000
+#define BUCKET      10
+#define MOCK_PORT   20000
+#define MOCK_ROWS   360         // An hour of 10 second samples.
+
+struct host {
+  std::string         name;
+  struct sockaddr_in  addr;
+  bool                ok;
+  bool                relay;
+  double              power, energy;
+  long long           since;    // X-Last from the previous history reply.
+  uint64_t            started, elapsed;   // ns for both requests.
+  std::vector<std::pair<long long, float>> rows;
+};
+
+enum phase { STATUS, HISTORY };
+
+struct conn {
+  int         fd;
+  size_t      host;
+  enum phase  phase;
+  bool        sent;
+  uint64_t    deadline;
+  std::string buf;
+};
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+raiseFiles(void)
+{
+  struct rlimit rl;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+static bool
+resolve(const std::string &spec, struct sockaddr_in *sin)
+{
+  std::string       name = spec, port = "80";
+  size_t            colon = spec.rfind(':');
+  struct addrinfo   hints = {}, *ai;
+
+  if (colon != std::string::npos) {
+    name = spec.substr(0, colon);
+    port = spec.substr(colon + 1);
+  }
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(atoi(port.c_str()));
+  if (inet_pton(AF_INET, name.c_str(), &sin->sin_addr) == 1)
+    return true;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(name.c_str(), port.c_str(), &hints, &ai) != 0)
+    return false;
+  *sin = *(struct sockaddr_in *)ai->ai_addr;
+  freeaddrinfo(ai);
+  return true;
+}
+
+/*
+ * Scraper
+ */
+
+class Scraper {
+public:
+  Scraper(std::vector<struct host> &hosts, int conns, int timeout)
+    : hosts(hosts), maxConns(conns), timeout(timeout) {}
+  void run(void);
+
+  uint64_t  bytes = 0;
+  uint32_t  failures = 0;
+  uint32_t  unchanged = 0;      // 304 replies to incremental requests.
+
+private:
+  bool open(size_t host, enum phase phase);
+  void close(struct conn *c, bool ok);
+  void sweep(void);
+  void readable(struct conn *c);
+  void writable(struct conn *c);
+  void parse(struct conn *c);
+
+  std::vector<struct host> &hosts;
+  std::set<struct conn *>   conns;
+  int       maxConns, timeout, ep = -1;
+  size_t    next = 0;
+};
+
+bool
+Scraper::open(size_t h, enum phase phase)
+{
+  struct conn         *c;
+  struct epoll_event   ev;
+  int                  fd, one = 1;
+
+  if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
+    return false;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(fd, (struct sockaddr *)&hosts[h].addr, sizeof(hosts[h].addr)) < 0 && errno != EINPROGRESS) {
+    ::close(fd);
+    return false;
+  }
+  c = new conn{ fd, h, phase, false, nowNs() + timeout * 1000000ULL, "" };
+  ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = c;
+  epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  conns.insert(c);
+  return true;
+}
+
+void
+Scraper::close(struct conn *c, bool ok)
+{
+  struct host &h = hosts[c->host];
+
+  epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+  ::close(c->fd);
+  conns.erase(c);
+  if (ok && c->phase == STATUS && open(c->host, HISTORY)) {
+    delete c;
+    return;
+  }
+  if (!ok)
+    failures++;
+  h.ok = ok;
+  h.elapsed = nowNs() - h.started;
+  delete c;
+}
+
+void
+Scraper::writable(struct conn *c)
+{
+  struct host        &h = hosts[c->host];
+  struct epoll_event  ev;
+  char                req[160];
+  int                 err = 0, len;
+  socklen_t           elen = sizeof(err);
+
+  getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &elen);
+  if (err) {
+    close(c, false);
+    return;
+  }
+  if (c->phase == STATUS)
+    len = snprintf(req, sizeof(req), "GET /api/v1/status HTTP/1.0\r\n\r\n");
+  else
+    len = snprintf(req, sizeof(req), "GET /data.txt?epoch=1&since=%lld HTTP/1.0\r\n\r\n", h.since);
+  if (send(c->fd, req, len, MSG_NOSIGNAL) != len) {
+    close(c, false);
+    return;
+  }
+  c->sent = true;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = c;
+  epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+void
+Scraper::readable(struct conn *c)
+{
+  char    buf[16384];
+  ssize_t n;
+
+  while ((n = recv(c->fd, buf, sizeof(buf), 0)) > 0) {
+    c->buf.append(buf, n);
+    bytes += n;
+  }
+  if (n == 0) {
+    parse(c);
+    return;
+  }
+  if (errno != EAGAIN && errno != EWOULDBLOCK)
+    close(c, false);
+}
+
+static double
+field(const std::string &s, const char *name)
+{
+  size_t at = s.find(name);
+
+  return at == std::string::npos ? NAN : strtod(s.c_str() + at + strlen(name), NULL);
+}
+
+// The plug ends some headers with a bare newline.
+void
+Scraper::parse(struct conn *c)
+{
+  struct host  &h = hosts[c->host];
+  const char   *p = c->buf.c_str(), *body, *eol;
+  size_t        end = c->buf.find("\r\n\r\n"), lf = c->buf.find("\n\n");
+  int           code = 0;
+
+  sscanf(p, "HTTP/1.%*d %d", &code);
+  if (lf != std::string::npos && (end == std::string::npos || lf < end))
+    body = p + lf + 2;
+  else if (end != std::string::npos)
+    body = p + end + 4;
+  else {
+    close(c, false);
+    return;
+  }
+
+  if (c->phase == STATUS) {
+    if (code != 200) {
+      close(c, false);
+      return;
+    }
+    h.power = field(c->buf, "\"power\":");
+    h.energy = field(c->buf, "\"energy\":");
+    h.relay = c->buf.find("\"relay\":true") != std::string::npos;
+    close(c, true);
+    return;
+  }
+
+  if (code == 304) {
+    unchanged++;
+    close(c, true);
+    return;
+  }
+  if (code != 200) {
+    close(c, false);
+    return;
+  }
+  const char *last = strstr(p, "X-Last: ");
+  if (last && last < body)
+    h.since = strtoll(last + 8, NULL, 10);
+  if ((eol = strchr(body, '\n')))                 // Column names.
+    body = eol + 1;
+  while (*body) {
+    char      *e;
+    long long  t = strtoll(body, &e, 10);
+
+    if (*e == ',')
+      h.rows.push_back({ t, strtof(e + 1, NULL) });
+    if (!(eol = strchr(body, '\n')))
+      break;
+    body = eol + 1;
+  }
+  close(c, true);
+}
+
+// Requests past their deadline count as failures.
+void
+Scraper::sweep(void)
+{
+  std::vector<struct conn *> expired;
+  uint64_t                   now = nowNs();
+
+  for (auto c : conns)
+    if (now > c->deadline)
+      expired.push_back(c);
+  for (auto c : expired)
+    close(c, false);
+}
+
+void
+Scraper::run(void)
+{
+  std::vector<struct epoll_event> events(1024);
+  uint64_t                        lastSweep = nowNs();
+
+  ep = epoll_create1(0);
+  next = 0;
+  bytes = failures = unchanged = 0;
+  for (auto &h : hosts)
+    h.rows.clear();
+
+  while (next < hosts.size() || !conns.empty()) {
+    while ((int)conns.size() < maxConns && next < hosts.size()) {
+      hosts[next].started = nowNs();
+      if (!open(next, STATUS)) {
+        hosts[next].ok = false;
+        failures++;
+      }
+      next++;
+    }
+    int n = epoll_wait(ep, events.data(), events.size(), 50);
+
+    for (int i = 0; i < n; i++) {
+      struct conn *c = (struct conn *)events[i].data.ptr;
+
+      if (!conns.count(c))
+        continue;                                 // Closed earlier in this batch.
+      if (!c->sent)
+        writable(c);
+      else
+        readable(c);
+    }
+    if (nowNs() - lastSweep > 100000000ULL) {
+      sweep();
+      lastSweep = nowNs();
+    }
+  }
+  ::close(ep);
+}
+
+/*
+ * Output
+ */
+
+// Average each plug's rows into buckets and write those after 'after'.
+static long long
+merge(FILE *out, std::vector<struct host> &hosts, int bucket, long long after, bool header)
+{
+  std::map<long long, std::vector<std::pair<float, int>>> table;
+  long long                                               last = after;
+
+  for (size_t i = 0; i < hosts.size(); i++) {
+    for (auto &r : hosts[i].rows) {
+      long long b = r.first / bucket * bucket;
+
+      if (b <= after)
+        continue;
+      auto &row = table[b];
+
+      if (row.empty())
+        row.resize(hosts.size(), { 0.0f, 0 });
+      row[i].first += r.second;
+      row[i].second++;
+    }
+  }
+  if (header) {
+    fputs("time", out);
+    for (auto &h : hosts)
+      fprintf(out, ",%s", h.name.c_str());
+    fputc('\n', out);
+  }
+  for (auto &row : table) {
+    fprintf(out, "%lld", row.first);
+    for (auto &cell : row.second) {
+      if (cell.second)
+        fprintf(out, ",%.1f", cell.first / cell.second);
+      else
+        fputc(',', out);
+    }
+    fputc('\n', out);
+    last = row.first;
+  }
+  fflush(out);
+  return last;
+}
+
+static void
+status(FILE *out, std::vector<struct host> &hosts)
+{
+  fprintf(out, "host,ok,relay,power,energy,ms\n");
+  for (auto &h : hosts)
+    fprintf(out, "%s,%d,%d,%.2f,%.6f,%.1f\n", h.name.c_str(), h.ok, h.relay,
+      h.ok ? h.power : 0.0, h.ok ? h.energy : 0.0, h.elapsed / 1e6);
+  fflush(out);
+}
+
+/*
+ * Mock plugs
+ */
+
+static void
+mockReply(int fd, int plug, const char *req)
+{
+  std::string  resp, body;
+  time_t       now = time(NULL) / 10 * 10;
+  long long    since = 0;
+  const char  *p;
+  char         line[64];
+
+  if (!strncmp(req, "GET /api/v1/status", 18)) {
+    snprintf(line, sizeof(line), "%.2f", 100.0 + plug % 50);
+    body = std::string("{\"hostname\":\"mock\",\"relay\":true,\"voltage\":230.00,\"current\":0.500,\"power\":") +
+      line + ",\"energy\":12.345678}\n";
+    resp = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + body;
+  }
+  else if (!strncmp(req, "GET /data.txt", 13)) {
+    if ((p = strstr(req, "since=")))
+      since = atoll(p + 6);
+    if (since >= now) {
+      resp = "HTTP/1.1 304 Not Modified\r\n\r\n";
+    }
+    else {
+      for (time_t t = now - (MOCK_ROWS - 1) * 10; t <= now; t += 10) {
+        if (t <= since)
+          continue;
+        snprintf(line, sizeof(line), "%lld,%.2f\n", (long long)t, 100.0 + plug % 50 + 10 * sin(t / 300.0));
+        body += line;
+      }
+      snprintf(line, sizeof(line), "X-Last: %lld\n", (long long)now);
+      resp = std::string("HTTP/1.1 200 OK\nContent-Type: text/plain\n") + line + "\nDate,Power\n" + body;
+    }
+  }
+  else
+    resp = "HTTP/1.1 404 Not Found\r\n\r\n";
+  send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+}
+
+/*
+ * One epoll loop for all the listeners, a request is answered once its
+ * header has arrived and the connection closed as the plug does.
+ */
+static int
+mock(int plugs, int port)
+{
+  struct epoll_event              ev;
+  std::vector<struct epoll_event> events(1024);
+  std::map<int, std::string>      pending;
+  std::map<int, int>              plugOf;
+  int                             ep = epoll_create1(0), one = 1;
+
+  raiseFiles();
+  for (int i = 0; i < plugs; i++) {
+    struct sockaddr_in  sin = {};
+    int                 fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port + i);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(fd, 64) < 0) {
+      perror("mock listen");
+      return 1;
+    }
+    plugOf[fd] = -1 - i;                          // Negative marks a listener.
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  for (;;) {
+    int n = epoll_wait(ep, events.data(), events.size(), -1);
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd, plug = plugOf[fd], c;
+
+      if (plug < 0) {
+        while ((c = accept4(fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+          setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          plugOf[c] = -1 - plug;
+          ev.events = EPOLLIN;
+          ev.data.fd = c;
+          epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+        }
+        continue;
+      }
+
+      char    buf[1024];
+      ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+      if (len > 0) {
+        pending[fd].append(buf, len);
+        if (pending[fd].find("\r\n\r\n") == std::string::npos)
+          continue;
+        mockReply(fd, plug, pending[fd].c_str());
+      }
+      else if (len < 0 && errno == EAGAIN)
+        continue;
+      epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+      close(fd);
+      pending.erase(fd);
+      plugOf.erase(fd);
+    }
+  }
+}
+
+static void
+report(const char *what, Scraper &s, std::vector<struct host> &hosts, uint64_t ns)
+{
+  std::vector<uint64_t> lat;
+  size_t                rows = 0;
+
+  for (auto &h : hosts) {
+    lat.push_back(h.elapsed);
+    rows += h.rows.size();
+  }
+  std::sort(lat.begin(), lat.end());
+  printf("%s: %zu plugs in %.1f ms, %.0f plugs/s, %u failed, %u unchanged, %zu rows, %.1f MB\n",
+    what, hosts.size(), ns / 1e6, hosts.size() / (ns / 1e9), s.failures, s.unchanged, rows, s.bytes / 1e6);
+  printf("  per plug ms: p50 %.2f p99 %.2f max %.2f\n", lat[lat.size() / 2] / 1e6,
+    lat[lat.size() * 99 / 100] / 1e6, lat.back() / 1e6);
+}
+
+static int
+bench(int plugs, int port, int conns)
+{
+  std::vector<struct host>  hosts(plugs);
+  pid_t                     child;
+  uint64_t                  start;
+  FILE                     *null = fopen("/dev/null", "w");
+
+  raiseFiles();
+  if ((child = fork()) == 0)
+    exit(mock(plugs, port));
+  for (int i = 0; i < plugs; i++) {
+    hosts[i].name = "127.0.0.1:" + std::to_string(port + i);
+    resolve(hosts[i].name, &hosts[i].addr);
+  }
+  usleep(200000 + plugs * 50);
+
+  Scraper s(hosts, conns, TIMEOUT_MS);
+
+  start = nowNs();
+  s.run();
+  merge(null, hosts, BUCKET, 0, true);
+  report("full", s, hosts, nowNs() - start);
+
+  start = nowNs();
+  s.run();
+  report("incremental", s, hosts, nowNs() - start);
+
+  kill(child, SIGTERM);
+  waitpid(child, NULL, 0);
+  fclose(null);
+  return 0;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,
+    "usage: s31scrape [-c conns] [-t ms] [-b seconds] [-i seconds] [-o file] [-s file] host[:port] ... | -f hostfile\n"
+    "       s31scrape mock -n plugs [-p port]\n"
+    "       s31scrape bench -n plugs [-p port] [-c conns]\n");
+  exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+  std::vector<struct host>  hosts;
+  std::vector<std::string>  names;
+  const char               *mode = NULL, *outPath = NULL, *statusPath = NULL, *hostFile = NULL;
+  int                       ch, conns = CONNS, timeout = TIMEOUT_MS, bucket = BUCKET, interval = 0;
+  int                       plugs = 100, port = MOCK_PORT;
+  FILE                     *out = stdout;
+
+  if (argc > 1 && (!strcmp(argv[1], "mock") || !strcmp(argv[1], "bench"))) {
+    mode = argv[1];
+    argc--;
+    argv++;
+  }
+  while ((ch = getopt(argc, argv, "b:c:f:i:n:o:p:s:t:")) != -1) {
+    switch (ch) {
+      case 'b': bucket = std::max(1, atoi(optarg)); break;
+      case 'c': conns = std::max(1, atoi(optarg)); break;
+      case 'f': hostFile = optarg; break;
+      case 'i': interval = atoi(optarg); break;
+      case 'n': plugs = atoi(optarg); break;
+      case 'o': outPath = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 's': statusPath = optarg; break;
+      case 't': timeout = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (mode && !strcmp(mode, "mock"))
+    return mock(plugs, port);
+  if (mode)
+    return bench(plugs, port, conns);
+
+  for (int i = optind; i < argc; i++)
+    names.push_back(argv[i]);
+  if (hostFile) {
+    FILE *f = fopen(hostFile, "r");
+    char  line[256];
+
+    if (!f) {
+      perror(hostFile);
+      return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+      line[strcspn(line, " \t\r\n#")] = '\0';
+      if (line[0])
+        names.push_back(line);
+    }
+    fclose(f);
+  }
+  if (names.empty())
+    usage();
+  raiseFiles();
+  for (auto &n : names) {
+    struct host h = {};
+
+    h.name = n;
+    if (!resolve(n, &h.addr)) {
+      fprintf(stderr, "%s: unknown host\n", n.c_str());
+      continue;
+    }
+    hosts.push_back(h);
+  }
+  if (outPath && !(out = fopen(outPath, interval ? "a" : "w"))) {
+    perror(outPath);
+    return 1;
+  }
+
+  Scraper   s(hosts, conns, timeout);
+  long long last = 0;
+  bool      header = !outPath || ftell(out) == 0;
+
+  for (;;) {
+    uint64_t start = nowNs();
+
+    s.run();
+    last = merge(out, hosts, bucket, last, header);
+    header = false;
+    if (statusPath) {
+      FILE *f = fopen(statusPath, "w");
+
+      if (f) {
+        status(f, hosts);
+        fclose(f);
+      }
+    }
+    fprintf(stderr, "%zu plugs in %.1f ms, %u failed\n", hosts.size(), (nowNs() - start) / 1e6, s.failures);
+    if (!interval)
+      break;
+    sleep(interval);
+  }
+  return 0;
+}
@@ -0,0 +1,347 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Host client for the UDP control protocol in include/udpproto.h.
+ *
+ *   c++ -O2 -Iinclude -o s31udp tools/s31udp.cpp
+ *
+ *   s31udp [-k phrase] [-p port] host status|on|off|toggle
+ *   s31udp [-k phrase] [-p port] host watch seconds
+ *   s31udp [-k phrase] [-p port] host bench count
+ *   s31udp [-k phrase] [-p port] serve
+ *
+ * The pass phrase may also be given in S31_KEY.  "serve" answers status,
+ * set and toggle requests like a plug so that "bench 127.0.0.1" measures the
+ * loopback round trip and the per-request CPU cost without a device.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "states.h"
+#include "udpproto.h"
+
+#define TIMEOUT_MS  500
+#define RETRIES     3
+#define SENDERS     8
+
+static uint64_t           key[2];
+static std::random_device rnd;
+
+static uint64_t
+nowNs(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,
+    "usage: s31udp [-k phrase] [-p port] host status|on|off|toggle\n"
+    "       s31udp [-k phrase] [-p port] host watch seconds\n"
+    "       s31udp [-k phrase] [-p port] host bench count\n"
+    "       s31udp [-k phrase] [-p port] serve\n");
+  exit(2);
+}
+
+static void
+print(const struct udpStatus *s)
+{
+  static const char *results[] = { "", " (held off)", " (no free slot)", " (bad op)" };
+  static const char *trips[] = { "", ", tripped on overcurrent", ", tripped on overpower" };
+
+  printf("%u relay %s%s, %.2fV %.3fA %.2fW %.6fkWh%s%s\n", s->time,
+    s->state & STATE_RELAY ? "on" : "off", s->state & STATE_SHED ? " (shed)" : "",
+    s->voltage, s->current, s->power, s->energy,
+    s->trip < 3 ? trips[s->trip] : "", s->result < 4 ? results[s->result] : "");
+}
+
+/*
+ * Stamp a request with the time and a nonce that rises within the second:
+ * the microseconds in the top 20 bits over random low bits, so that requests
+ * from this address stay in order even from several processes.
+ */
+static void
+stamp(struct udpRequest *r)
+{
+  static uint32_t   lastTime, lastNonce;
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  r->time = ts.tv_sec;
+  r->nonce = (uint32_t)(ts.tv_nsec / 1000) << 12 | (rnd() & 0x3ff);
+  if (!udpNewer(r->time, r->nonce, lastTime, lastNonce))
+    r->nonce = lastNonce + 1;
+  lastTime = r->time;
+  lastNonce = r->nonce;
+}
+
+static bool
+receive(int fd, struct udpStatus *s, int timeout)
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+
+  while (poll(&pfd, 1, timeout) > 0) {
+    if (recv(fd, s, sizeof(*s), 0) == sizeof(*s) && s->magic == UDP_MAGIC &&
+        s->version == UDP_VERSION && udpVerify(s, sizeof(*s), key))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * A resent datagram would be dropped as a replay, so a retry is a fresh
+ * request.  Toggles are never retried in case the first one got through.
+ */
+static bool
+request(int fd, uint8_t op, uint8_t arg, struct udpStatus *s)
+{
+  struct udpRequest r;
+
+  for (int i = 0; i < (op == UDP_OP_TOGGLE ? 1 : RETRIES); i++) {
+    r.magic = UDP_MAGIC;
+    r.version = UDP_VERSION;
+    r.op = op;
+    r.arg = arg;
+    stamp(&r);
+    udpSeal(&r, sizeof(r), key);
+    if (send(fd, &r, sizeof(r), 0) != sizeof(r))
+      return false;
+    while (receive(fd, s, TIMEOUT_MS))
+      if (s->nonce == r.nonce && s->op == op)
+        return true;
+  }
+  return false;
+}
+
+static int
+bench(int fd, int count)
+{
+  std::vector<uint64_t> rtt;
+  struct udpStatus      s;
+  struct udpRequest     r = {};
+  uint64_t              cpu = 0, start;
+  volatile uint64_t     sink = 0;
+  int                   lost = 0;
+  const int             macs = 1000000;
+
+  for (int i = 0; i < count; i++) {
+    start = nowNs();
+    if (!request(fd, UDP_OP_STATUS, 0, &s)) {
+      lost++;
+      continue;
+    }
+    rtt.push_back(nowNs() - start);
+    cpu += s.cpu;
+  }
+  if (rtt.empty()) {
+    fprintf(stderr, "no replies\n");
+    return 1;
+  }
+  std::sort(rtt.begin(), rtt.end());
+  printf("%zu replies, %d lost\n", rtt.size(), lost);
+  printf("rtt us: min %.1f p50 %.1f p99 %.1f max %.1f\n", rtt.front() / 1e3,
+    rtt[rtt.size() / 2] / 1e3, rtt[rtt.size() * 99 / 100] / 1e3, rtt.back() / 1e3);
+  printf("plug cpu us: mean %.1f\n", (double)cpu / rtt.size());
+
+  start = nowNs();
+  for (int i = 0; i < macs; i++) {
+    r.nonce = i;
+    sink = sink ^ udpSipHash(key, (const uint8_t *)&r, sizeof(r) - 8);
+  }
+  printf("host tag ns: %.1f\n", (double)(nowNs() - start) / macs);
+  return 0;
+}
+
+static int
+watch(int fd, int period)
+{
+  struct udpStatus  s;
+  time_t            renew = 0;
+
+  for (;;) {
+    if (time(NULL) >= renew) {
+      if (!request(fd, UDP_OP_SUBSCRIBE, period, &s) || s.result != UDP_OK) {
+        fprintf(stderr, "subscribe failed\n");
+        return 1;
+      }
+      renew = time(NULL) + UDP_SUB_TTL / 2;
+    }
+    if (receive(fd, &s, 1000) && s.op == UDP_OP_PUSH)
+      print(&s);
+  }
+}
+
+// Stand in for a plug on the loopback.
+static int
+serve(uint16_t port)
+{
+  struct sockaddr_in  sin = {}, from;
+  socklen_t           len;
+  struct udpRequest   r;
+  struct udpStatus    s = {};
+  struct { uint32_t addr, time, nonce; } senders[SENDERS] = {};
+  int                 fd, i, next = 0;
+
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    perror("bind");
+    return 1;
+  }
+  s.voltage = 230.0;
+  s.current = 1.0;
+  s.power = 230.0;
+  for (;;) {
+    len = sizeof(from);
+    if (recvfrom(fd, &r, sizeof(r), 0, (struct sockaddr *)&from, &len) != sizeof(r))
+      continue;
+    uint64_t start = nowNs();
+    int32_t skew = r.time - (uint32_t)time(NULL);
+
+    if (r.magic != UDP_MAGIC || r.version != UDP_VERSION || !udpVerify(&r, sizeof(r), key) ||
+        skew > UDP_SKEW || skew < -UDP_SKEW)
+      continue;
+    for (i = 0; i < SENDERS; i++)
+      if (senders[i].time && senders[i].addr == from.sin_addr.s_addr)
+        break;
+    if (i == SENDERS) {
+      i = next;
+      next = (next + 1) % SENDERS;
+      senders[i].addr = from.sin_addr.s_addr;
+    } else if (!udpNewer(r.time, r.nonce, senders[i].time, senders[i].nonce))
+      continue;
+    senders[i].time = r.time;
+    senders[i].nonce = r.nonce;
+
+    s.result = UDP_OK;
+    switch (r.op) {
+      case UDP_OP_STATUS:
+        break;
+      case UDP_OP_SET:
+        s.state = r.arg ? s.state | STATE_RELAY : s.state & ~STATE_RELAY;
+        break;
+      case UDP_OP_TOGGLE:
+        s.state ^= STATE_RELAY;
+        break;
+      default:
+        s.result = UDP_ERR_OP;
+    }
+    s.magic = UDP_MAGIC;
+    s.version = UDP_VERSION;
+    s.op = r.op;
+    s.nonce = r.nonce;
+    s.time = time(NULL);
+    s.energy += 230.0 / 3600000;
+    udpSeal(&s, sizeof(s), key);
+    sendto(fd, &s, sizeof(s), 0, (struct sockaddr *)&from, len);
+    s.cpu = (nowNs() - start + 500) / 1000;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  const char        *phrase = getenv("S31_KEY");
+  uint16_t           port = UDP_PORT;
+  struct addrinfo    hints = {}, *ai;
+  struct udpStatus   s;
+  char               service[8];
+  int                ch, fd;
+
+  while ((ch = getopt(argc, argv, "k:p:")) != -1) {
+    switch (ch) {
+      case 'k':
+        phrase = optarg;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (!phrase || !*phrase || argc < 1)
+    usage();
+  udpKey(phrase, key);
+
+  if (!strcmp(argv[0], "serve"))
+    return serve(port);
+  if (argc < 2)
+    usage();
+
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(argv[0], service, &hints, &ai) != 0) {
+    fprintf(stderr, "%s: unknown host\n", argv[0]);
+    return 1;
+  }
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 || connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+    perror(argv[0]);
+    return 1;
+  }
+  freeaddrinfo(ai);
+
+  if (!strcmp(argv[1], "bench"))
+    return bench(fd, argc > 2 ? atoi(argv[2]) : 1000);
+  if (!strcmp(argv[1], "watch"))
+    return watch(fd, argc > 2 ? atoi(argv[2]) : 10);
+
+  if (!strcmp(argv[1], "status"))
+    ch = request(fd, UDP_OP_STATUS, 0, &s);
+  else if (!strcmp(argv[1], "on"))
+    ch = request(fd, UDP_OP_SET, 1, &s);
+  else if (!strcmp(argv[1], "off"))
+    ch = request(fd, UDP_OP_SET, 0, &s);
+  else if (!strcmp(argv[1], "toggle"))
+    ch = request(fd, UDP_OP_TOGGLE, 0, &s);
+  else
+    usage();
+  if (!ch) {
+    fprintf(stderr, "%s: no reply\n", argv[0]);
+    return 1;
+  }
+  print(&s);
+  return s.result == UDP_OK ? 0 : 1;
+}
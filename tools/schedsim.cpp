@@ -0,0 +1,307 @@
+/* 
+ * Copyright (c) 2024-2025, Ian Freislich
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Runs the main loop's sleep against a simulated clock to check that it
+ * never sleeps through a timer deadline or a power meter frame.
+ *
+ *   c++ -O2 -Iinclude -Itools/host -o schedsim tools/schedsim.cpp src/scheduler.cpp src/cse7759b.cpp
+ *
+ *   schedsim [-t seconds] [-r requests/min] [-l stall ms] [-s seed]
+ *
+ * The real Scheduler and CSE7759B reader are driven as loop() drives them:
+ * read the meter, poll the network, run the timers, serve the web, then
+ * idle for min(timer.next(), cseNext()), or not at all while a client is
+ * connected.  The meter sends a 24 byte frame every 50 ms into the 256 byte
+ * UART buffer, counting frames in the CF pulse field.  The tasks are the
+ * firmware's own periods with made up costs.  Web requests arrive -r times
+ * a minute (default 6) and take up to 150 ms, and about once a minute the
+ * loop stalls for -l ms (default 250) as an MQTT connect can.  The clock
+ * starts 20 s short of the millis() wrap and runs for -t seconds (default
+ * 3600).
+ *
+ * A deadline is overslept if idle() returns after it, and a frame if idle()
+ * returns more than a byte time after its last byte.  The exit status is
+ * non-zero for either, for a task run early, for a frame lost to a buffer
+ * overrun, and for a frame whose trip latency, as protectCheck() would work
+ * it out, is less than the time since its last byte arrived.
+ */
+
+#include <random>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "cse7759b.h"
+#include "nvdata.h"
+#include "scheduler.h"
+
+#define FRAME_BYTES     24
+#define FRAME_US        (FRAME_BYTES * CSE_BYTE_US)
+#define WRAP_MS         20000
+
+struct task {
+  const char *name;
+  uint32_t    period;         // ms
+  uint32_t    costUs;
+  uint32_t    due;
+  uint32_t    runs;
+  uint32_t    worstMs;        // Latest run after its deadline.
+};
+
+static struct task tasks[] = {
+  { "button", 100, 80, 0, 0, 0 },
+  { "led", 1000, 50, 0, 0, 0 },
+  { "schedule", 1000, 300, 0, 0, 0 },
+  { "demand", 1000, 200, 0, 0, 0 },
+  { "advert", 1000, 900, 0, 0, 0 },
+  { "memstat", 1000, 150, 0, 0, 0 },
+  { "nvheader", 5000, 1200, 0, 0, 0 },
+  { "log", 10000, 2500, 0, 0, 0 },
+};
+
+#define TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+struct config     cfg;
+struct nvHeader   nvHeader;
+uint8_t           state;
+
+static Scheduler  timer;
+static std::mt19937 rng;
+static uint64_t   nextByteUs, bytesSent;
+static uint64_t   readyUs[65536];     // Last byte of each frame, by number.
+static uint8_t    frame[FRAME_BYTES];
+static uint32_t   frames, missed, early, oversleptTask, oversleptFrame;
+static int32_t    lastFrame = -1;
+static uint64_t   latencySum, latencyMax;
+static uint32_t   bound, boundMax, under;   // protectCheck()'s view of the latency.
+
+static uint32_t
+uniform(uint32_t lo, uint32_t hi)
+{
+  return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+}
+
+// When something that happens perMin times a minute next happens.
+static uint64_t
+arrival(double perMin)
+{
+  return perMin > 0 ? hostUs + std::exponential_distribution<double>(perMin / 60e6)(rng) : UINT64_MAX;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: schedsim [-t seconds] [-r requests/min] [-l stall ms] [-s seed]\n");
+  exit(2);
+}
+
+// A calibrated meter reading about 230 V, 0.5 A and 100 W.
+static void
+makeFrame(uint16_t n)
+{
+  static const uint8_t  fixed[] = {
+    0x55, 0x5a, 0x02, 0x1a, 0x6c, 0x00, 0x04, 0xa0, 0x00, 0x3e, 0x80, 0x00,
+    0x7d, 0x00, 0x50, 0x52, 0x80, 0x00, 0xcc, 0xcc, 0x71
+  };
+  uint8_t               sum = 0;
+
+  memcpy(frame, fixed, sizeof(fixed));
+  frame[21] = n >> 8;
+  frame[22] = n;
+  for (int i = 2; i < FRAME_BYTES - 1; i++)
+    sum += frame[i];
+  frame[FRAME_BYTES - 1] = sum;
+}
+
+// Deliver what the meter has sent by now.
+static void
+uart(void)
+{
+  while (nextByteUs <= hostUs) {
+    uint32_t i = bytesSent % FRAME_BYTES;
+
+    if (i == 0)
+      makeFrame(bytesSent / FRAME_BYTES);
+    if (i == FRAME_BYTES - 1)
+      readyUs[bytesSent / FRAME_BYTES % 65536] = nextByteUs;
+    Serial.receive(frame[i]);
+    bytesSent++;
+    nextByteUs += CSE_BYTE_US;
+  }
+}
+
+// Called by the reader for every good frame, which carries its number.
+void
+checkpointSag(double, uint32_t, uint16_t pulses)
+{
+  uint64_t latency = hostUs - readyUs[pulses];
+
+  if (lastFrame >= 0 && pulses != (uint16_t)(lastFrame + 1))
+    missed += (uint16_t)(pulses - lastFrame - 1);
+  lastFrame = pulses;
+  frames++;
+  if (bound < latency)
+    under++;
+  boundMax = max(boundMax, bound);
+  latencySum += latency;
+  latencyMax = max(latencyMax, latency);
+  hostUs += 150;
+}
+
+void
+protectCheck(double, double, uint32_t frame)
+{
+  bound = micros() - frame;
+}
+
+void
+tariffAddPulses(uint32_t)
+{
+}
+
+template <int N> static void
+run(void)
+{
+  struct task *t = &tasks[N];
+  uint32_t     now = millis();
+
+  if ((int32_t)(now - t->due) < 0) {
+    printf("%s ran %d ms early\n", t->name, (int)(t->due - now));
+    early++;
+  }
+  else
+    t->worstMs = max(t->worstMs, now - t->due);
+  t->runs++;
+  t->due += t->period;
+  if ((int32_t)(now - t->due) >= 0)
+    t->due = now + t->period;
+  hostUs += uniform(t->costUs / 2, t->costUs * 3 / 2);
+}
+
+template <int N> static void
+schedule(void)
+{
+  if constexpr (N < TASKS) {
+    tasks[N].due = millis() + tasks[N].period;
+    timer.setInterval(tasks[N].period, run<N>);
+    schedule<N + 1>();
+  }
+}
+
+// Check a sleep from start (us) against the deadlines and the frame on its way.
+static void
+checkSleep(uint64_t start)
+{
+  uint32_t  end = millis();
+  uint64_t  ready;
+
+  uart();
+  ready = readyUs[(lastFrame + 1) % 65536];
+
+  for (const struct task *t = tasks; t < tasks + TASKS; t++) {
+    if ((int32_t)(end - t->due) > 0) {
+      printf("slept %u ms past %s at %u ms\n", (unsigned)(end - t->due), t->name, (unsigned)t->due);
+      oversleptTask++;
+    }
+  }
+  if (ready > start && hostUs > ready + CSE_BYTE_US) {
+    printf("slept %u us past frame %u\n", (unsigned)(hostUs - ready), (unsigned)(lastFrame + 1));
+    oversleptFrame++;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  uint64_t  start, seconds = 3600, iterations = 0, slept = 0, request, stall;
+  uint32_t  perMin = 6, stallMs = 250, busy = 0;
+  int       ch;
+
+  while ((ch = getopt(argc, argv, "l:r:s:t:")) != -1) {
+    switch (ch) {
+      case 'l': stallMs = atoi(optarg); break;
+      case 'r': perMin = atoi(optarg); break;
+      case 's': rng.seed(atoi(optarg)); break;
+      case 't': seconds = atoll(optarg); break;
+      default: usage();
+    }
+  }
+  cfg.calibration.V = cfg.calibration.I = cfg.calibration.P = 1;
+  hostUart = uart;
+  hostUs = (UINT32_MAX - WRAP_MS) * 1000ULL;
+  nextByteUs = hostUs + uniform(1, CSE_BYTE_US);
+  start = hostUs;
+  request = arrival(perMin);
+  stall = arrival(1);
+  schedule<0>();
+
+  while (hostUs - start < seconds * 1000000) {
+    uint64_t  before;
+    uint32_t  ms;
+
+    iterations++;
+    readCse7759b();
+    hostUs += uniform(50, 300);             // UDP, WLAN, MQTT, OTA and mDNS.
+    timer.run();
+    // A request takes a few passes to arrive and is then handled at once.
+    if (!busy && hostUs >= request) {
+      busy = uniform(2, 6);
+      request = arrival(perMin);
+    }
+    if (busy && !--busy)
+      hostUs += uniform(5000, 150000);
+    if (hostUs >= stall) {
+      hostUs += stallMs * 1000ULL;
+      stall = arrival(1);
+    }
+
+    before = hostUs;
+    ms = busy ? 0 : min(timer.next(), cseNext());
+    timer.idle(ms);
+    slept += hostUs - before;
+    if (ms)
+      checkSleep(before);
+  }
+
+  for (const struct task *t = tasks; t < tasks + TASKS; t++)
+    printf("%-9s %6u ms: %7u runs of %7.0f, up to %u ms late\n", t->name, (unsigned)t->period,
+      (unsigned)t->runs, seconds * 1000.0 / t->period, (unsigned)t->worstMs);
+  printf("frames %u of %llu, %u missed, %u overruns, latency %.2f ms mean, %.2f ms worst, %.2f ms worst bound, "
+    "%u under\n", (unsigned)frames, (unsigned long long)(bytesSent / FRAME_BYTES), (unsigned)missed,
+    (unsigned)Serial.overruns, frames ? latencySum / 1000.0 / frames : 0, latencyMax / 1000.0, boundMax / 1000.0,
+    (unsigned)under);
+  printf("idle %.1f%% (last window %u%%), %llu loops/s, %u late, overslept %u deadlines and %u frames, %u early\n",
+    slept * 100.0 / (hostUs - start), timer.idlePercent(), (unsigned long long)(iterations / seconds), (unsigned)timer.late,
+    (unsigned)oversleptTask, (unsigned)oversleptFrame, (unsigned)early);
+  return early || oversleptTask || oversleptFrame || missed || Serial.overruns || under ? 1 : 0;
+}